@@ -1,6 +1,7 @@
 #ifndef CC_H
 #define CC_H
 
+#include <set>
 #include <string>
 #include <unordered_map>
 #include <common/common.h>
@@ -21,6 +22,9 @@ namespace cc
 
         explicit ASTPosition(const ASTPosition* position)
         : line(position->line), col(position->col), len(position->len) {}
+
+        ASTPosition(uint32_t line, uint16_t col, uint16_t len)
+        : line(line), col(col), len(len) {}
     };
 
 
@@ -31,7 +35,7 @@ namespace cc
 
         typedef void (*TraverseCB)(ASTValue*, Context* ctx, void*);
         virtual void traverse(TraverseCB cb, Context* ctx, void* data) { cb(this, ctx, data); };
-        virtual void resolution_pass(Context* context) {};
+        virtual void resolution_pass(Context*) {};
     };
 
     struct ASTException : Exception
@@ -101,6 +105,12 @@ namespace cc
 
         virtual Constant* get_constant(Context* ctx) const = 0;
         virtual const IR* get(Context* ctx, IRBuilder &IRB) const = 0;
+
+        /**
+         * Reference to the object the expression designates,
+         * nullptr if it is not an lvalue
+         */
+        virtual const Reference* get_address(Context*, IRBuilder&) const { return nullptr; }
     };
 
     struct Statement : public Buildable
@@ -366,7 +376,7 @@ namespace cc
                              numeric_type_t type,
                              T value_)
         : ASTConstant(position),
-        type(type), value({0})
+        value({0}), type(type)
         {
             switch(type)
             {
@@ -387,7 +397,7 @@ namespace cc
         }
 
         const Type* get_type(Context* ctx) const override;
-        Constant* get_constant(Context* ctx) const override { return new NumericExpr(this, type, value.integer); }
+        Constant* get_constant(Context*) const override { return new NumericExpr(this, type, value.integer); }
         Constant* copy() const override { return new NumericExpr(*this); }
         std::string as_string() const override
         {
@@ -413,7 +423,7 @@ namespace cc
         const Type* get_type(Context* ctx) const override;
 
         Constant* copy() const override { return new LiteralExpr(*this); }
-        Constant* get_constant(Context* ctx) const override { return new LiteralExpr(this, value); }
+        Constant* get_constant(Context*) const override { return new LiteralExpr(this, value); }
         std::string as_string() const override { return "\"" + value + "\""; }
 
         ALL_OPERATORS_DECL
@@ -431,7 +441,7 @@ namespace cc
         void write(void* buffer) const override { constant->write(buffer); }
         const Type* get_type(Context* ctx) const override { return constant->get_type(ctx); }
         Constant* copy() const override { return new ConstantExpr(*this); }
-        Constant* get_constant(Context* ctx) const override { return constant->copy(); }
+        Constant* get_constant(Context*) const override { return constant->copy(); }
         std::string as_string() const override { return constant->as_string(); }
 
         ALL_OPERATORS_DECL
@@ -455,6 +465,7 @@ namespace cc
         void resolution_pass(Context* context) override;
         Constant* get_constant(Context* ctx) const override;
         const IR* get(Context* ctx, IRBuilder &IRB) const override;
+        const Reference* get_address(Context* ctx, IRBuilder &IRB) const override;
     };
 
     struct CallArguments : ASTValue
@@ -489,6 +500,7 @@ namespace cc
             delete arguments;
         }
 
+        void resolution_pass(Context* context) override;
         Constant* get_constant(Context* ctx) const override;
         void traverse(TraverseCB cb, Context* ctx, void* data) override;
         const IR* get(Context* ctx, IRBuilder &IRB) const override;
@@ -534,8 +546,8 @@ namespace cc
         Global* symbol;
         ASTGlobal* next;
 
-        explicit ASTGlobal(const ASTValue* values) : Buildable(values), next(nullptr), symbol(nullptr) {}
-        explicit ASTGlobal(const ASTPosition* position) : Buildable(position), next(nullptr), symbol(nullptr) {}
+        explicit ASTGlobal(const ASTValue* values) : Buildable(values), symbol(nullptr), next(nullptr) {}
+        explicit ASTGlobal(const ASTPosition* position) : Buildable(position), symbol(nullptr), next(nullptr) {}
 
         ~ASTGlobal() override
         {
@@ -559,7 +571,7 @@ namespace cc
             TAKE_STRING(name, name_);
         }
 
-        void add(Context* ctx, IRBuilder &IRB) const override { /* forward declaration */ };
+        void add(Context*, IRBuilder&) const override { /* forward declaration */ };
 
         ~ASTFunction() override
         {
@@ -573,15 +585,26 @@ namespace cc
     {
         ASTPosition end_position;
         MultiStatement* body;
+
+        // Filled by the resolution pass
+        std::set<std::string> callees;
+        std::set<std::string> globals;  //!< Global (or undeclared) variables referenced
+
         ASTFunctionDefine(const ASTPosition* position,
                           ASTPosition end_position,
                           const Type* return_type, const char* name_,
                           Arguments* args, MultiStatement* body)
                 : ASTFunction(position, return_type, name_, args),
-                  body(body), end_position(end_position) {}
+                  end_position(end_position), body(body) {}
 
         void add(Context* ctx, IRBuilder &IRB) const override;
 
+        /**
+         * Lower the body into the function scope, which
+         * must be the current scope of the context
+         */
+        void lower(Context* ctx, IRBuilder &IRB) const;
+
         ~ASTFunctionDefine() override
         {
             delete body;
@@ -640,7 +663,7 @@ namespace cc
         }
 
         const Type* get_type() const { return type; }
-        void add(Context* ctx, IRBuilder &IRB) const override { };
+        void add(Context*, IRBuilder&) const override { };
 
         static std::string get_anonymous_name(const ASTPosition* position)
         {
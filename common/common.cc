@@ -1,9 +1,105 @@
 #include "common.h"
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
 #include <sstream>
+#include <sys/stat.h>
 #include <compilation/module.h>
 
 namespace cc
 {
+    Use::Use(Instruction* user, const IR* value) :
+    value(value), user(user), next(nullptr), prev(nullptr)
+    {
+        link();
+    }
+
+    Use::Use(Use&& other) noexcept :
+    value(other.value), user(other.user), next(nullptr), prev(nullptr)
+    {
+        other.unlink();
+        other.value = nullptr;
+        link();
+    }
+
+    void Use::link()
+    {
+        if (!value || value->shared)
+        {
+            return;
+        }
+
+        next = value->uses;
+        if (next)
+        {
+            next->prev = &next;
+        }
+        prev = &value->uses;
+        value->uses = this;
+    }
+
+    void Use::unlink()
+    {
+        if (!prev)
+        {
+            return;
+        }
+
+        *prev = next;
+        if (next)
+        {
+            next->prev = prev;
+        }
+        next = nullptr;
+        prev = nullptr;
+    }
+
+    void Use::set(const IR* value_)
+    {
+        if (value_ == value)
+        {
+            return;
+        }
+
+        unlink();
+        value = value_;
+        link();
+    }
+
+    IR::~IR()
+    {
+        while (uses)
+        {
+            Use* use = uses;
+            use->unlink();
+            use->value = nullptr;
+        }
+    }
+
+    size_t IR::use_count() const
+    {
+        size_t n = 0;
+        for (const Use* use = uses; use; use = use->next)
+        {
+            n++;
+        }
+
+        return n;
+    }
+
+    void IR::replace_all_uses_with(const IR* value) const
+    {
+        if (value == this)
+        {
+            return;
+        }
+
+        while (uses)
+        {
+            uses->set(value);
+        }
+    }
+
     std::vector<std::string> split_string(const std::string &str, char delim)
     {
         std::stringstream ss(str);
@@ -18,30 +114,45 @@ namespace cc
         return elems;
     }
 
-    static const Type* get_preferred_type_single(const Type* type_1, const Type* type_2)
+    void make_directories(const std::string& path)
     {
-        return nullptr;
+        for (size_t i = 1; i <= path.size(); i++)
+        {
+            if (i == path.size() || path[i] == '/')
+            {
+                std::string sub = path.substr(0, i);
+                if (mkdir(sub.c_str(), 0755) != 0 && errno != EEXIST)
+                {
+                    throw Exception("Failed to create directory " + sub
+                                    + ": " + strerror(errno));
+                }
+            }
+        }
     }
 
-    const Type* IR::get_preferred_type(std::initializer_list<const IR*> irs)
+    bool parse_size(const std::string& str, uint64_t& out)
     {
-        const Type* out = nullptr;
-        for (const IR* ir : irs)
+        char* end = nullptr;
+        unsigned long long v = strtoull(str.c_str(), &end, 10);
+        if (end == str.c_str())
         {
-            if (not out)
-            {
-                out = ir->get_type(nullptr);
-            }
-            else
-            {
-                out = get_preferred_type_single(out, ir->get_type(nullptr));
-            }
+            return false;
+        }
+
+        switch (*end)
+        {
+            case 0: break;
+            case 'k': case 'K': v <<= 10; end++; break;
+            case 'm': case 'M': v <<= 20; end++; break;
+            case 'g': case 'G': v <<= 30; end++; break;
+            default: return false;
         }
 
-        return out;
+        out = v;
+        return *end == 0;
     }
 
-    const Type* Reference::get_type(Context* ctx) const
+    const Type* Reference::get_type(Context*) const
     {
         return variable->get_decl()->type;
     }
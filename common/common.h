@@ -1,11 +1,16 @@
 #ifndef COMMON_H
 #define COMMON_H
 
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <stdexcept>
 #include <vector>
 
+#ifndef CC_VERSION
+#define CC_VERSION "unknown"
+#endif
+
 namespace cc
 {
 
@@ -92,27 +97,116 @@ namespace cc
 
     std::vector<std::string> split_string(const std::string &str, char delimiter);
 
+    /**
+     * mkdir -p
+     * @throws Exception when a directory cannot be created
+     */
+    void make_directories(const std::string& path);
+
+    /**
+     * Parse a decimal size with an optional K, M or G suffix
+     * @return false if str is not a valid size
+     */
+    bool parse_size(const std::string& str, uint64_t& out);
+
     struct Value
     {
         virtual ~Value() = default;
     };
 
     class Type;
-    class IR : public Value
+    class IR;
+    struct Instruction;
+
+    class Use
     {
-        int value_id;
+        /**
+         * Operand slot of an instruction. Every use is linked into the
+         * use-list of the value it holds so that the users of a value
+         * are known without scanning the function. Assigning another
+         * value moves the use to the list of that value, destroying it
+         * removes it from the list.
+         */
+
+        const IR* value;
+        Instruction* user;
+        Use* next;
+        Use** prev;         //!< Link pointing to this use
+
+        friend class IR;
+
+        void link();
+        void unlink();
+
     public:
-        IR()
-        {
-            static int value_id_c = 0;
-            value_id = value_id_c++;
-        }
+        Use(Instruction* user, const IR* value);
+
+        /**
+         * Take the place of another use (operand vectors may move)
+         */
+        Use(Use&& other) noexcept;
+        Use(const Use&) = delete;
+        Use& operator=(const Use& other) { set(other.value); return *this; }
+        Use& operator=(const IR* value_) { set(value_); return *this; }
+        ~Use() { unlink(); }
+
+        void set(const IR* value_);
+        const IR* get() const { return value; }
+        Instruction* get_user() const { return user; }
+        Use* get_next() const { return next; }
+
+        operator const IR*() const { return value; }
+        const IR* operator->() const { return value; }
+    };
+
+    class IR : public Value
+    {
+        int value_id;           //!< -1 until the value is numbered (see Block::push())
 
+        mutable Use* uses;
+        bool shared;
+
+        friend class Use;
+        friend class ConstantPool;
+
+    protected:
+        /**
+         * Values referenced from every function (globals) do not record
+         * their uses, functions may be lowered concurrently
+         */
+        void set_shared() { shared = true; }
+        void set_id(int id) { value_id = id; }
+
+    public:
+        IR() : value_id(-1), uses(nullptr), shared(false) {}
+        IR(const IR& other) : value_id(other.value_id), uses(nullptr), shared(other.shared) {}
+        IR& operator=(const IR&) = delete;
+
+        /**
+         * Uses still holding the value are left empty
+         */
+        ~IR() override;
+
+        /**
+         * Number of the value in its function, only used to print it
+         */
         int get_id() const { return value_id; }
         virtual std::string as_string() const { return variadic_string("%%%d", get_id()); }
         virtual const Type* get_type(Context* ctx) const = 0;
 
-        static const Type* get_preferred_type(std::initializer_list<const IR*> irs);
+        /**
+         * First use of the value, follow Use::get_next() for the others.
+         * Uses of shared values are never recorded.
+         */
+        Use* get_uses() const { return uses; }
+        bool use_empty() const { return !uses; }
+        bool has_one_use() const { return uses && !uses->next; }
+        size_t use_count() const;
+
+        /**
+         * Make every user of this value use another one instead
+         */
+        void replace_all_uses_with(const IR* value) const;
     };
 
     struct Constant : public IR
@@ -0,0 +1,127 @@
+#include "hash.h"
+#include <cstring>
+
+namespace cc
+{
+    static constexpr uint64_t PRIME64_1 = 0x9E3779B185EBCA87ULL;
+    static constexpr uint64_t PRIME64_2 = 0xC2B2AE3D27D4EB4FULL;
+    static constexpr uint64_t PRIME64_3 = 0x165667B19E3779F9ULL;
+    static constexpr uint64_t PRIME64_4 = 0x85EBCA77C2B2AE63ULL;
+    static constexpr uint64_t PRIME64_5 = 0x27D4EB2F165667C5ULL;
+
+    static inline uint64_t rotl(uint64_t x, int r)
+    {
+        return (x << r) | (x >> (64 - r));
+    }
+
+    static inline uint64_t read64(const uint8_t* p)
+    {
+        uint64_t v;
+        memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    static inline uint32_t read32(const uint8_t* p)
+    {
+        uint32_t v;
+        memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    static inline uint64_t round(uint64_t acc, uint64_t input)
+    {
+        acc += input * PRIME64_2;
+        acc = rotl(acc, 31);
+        return acc * PRIME64_1;
+    }
+
+    static inline uint64_t merge_round(uint64_t acc, uint64_t val)
+    {
+        acc ^= round(0, val);
+        return acc * PRIME64_1 + PRIME64_4;
+    }
+
+    uint64_t xxhash64(const void* input, size_t len, uint64_t seed)
+    {
+        const auto* p = static_cast<const uint8_t*>(input);
+        const uint8_t* end = p + len;
+        uint64_t h;
+
+        if (len >= 32)
+        {
+            const uint8_t* limit = end - 32;
+            uint64_t v1 = seed + PRIME64_1 + PRIME64_2;
+            uint64_t v2 = seed + PRIME64_2;
+            uint64_t v3 = seed;
+            uint64_t v4 = seed - PRIME64_1;
+
+            do
+            {
+                v1 = round(v1, read64(p));
+                v2 = round(v2, read64(p + 8));
+                v3 = round(v3, read64(p + 16));
+                v4 = round(v4, read64(p + 24));
+                p += 32;
+            } while (p <= limit);
+
+            h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+            h = merge_round(h, v1);
+            h = merge_round(h, v2);
+            h = merge_round(h, v3);
+            h = merge_round(h, v4);
+        }
+        else
+        {
+            h = seed + PRIME64_5;
+        }
+
+        h += static_cast<uint64_t>(len);
+
+        while (p + 8 <= end)
+        {
+            h ^= round(0, read64(p));
+            h = rotl(h, 27) * PRIME64_1 + PRIME64_4;
+            p += 8;
+        }
+
+        if (p + 4 <= end)
+        {
+            h ^= static_cast<uint64_t>(read32(p)) * PRIME64_1;
+            h = rotl(h, 23) * PRIME64_2 + PRIME64_3;
+            p += 4;
+        }
+
+        while (p < end)
+        {
+            h ^= (*p) * PRIME64_5;
+            h = rotl(h, 11) * PRIME64_1;
+            p++;
+        }
+
+        h ^= h >> 33;
+        h *= PRIME64_2;
+        h ^= h >> 29;
+        h *= PRIME64_3;
+        h ^= h >> 32;
+
+        return h;
+    }
+
+    std::string to_hex(uint64_t value)
+    {
+        static const char digits[] = "0123456789abcdef";
+        std::string out(16, '0');
+        for (int i = 15; i >= 0; i--)
+        {
+            out[i] = digits[value & 0xF];
+            value >>= 4;
+        }
+
+        return out;
+    }
+
+    std::string content_digest(const std::string& input)
+    {
+        return to_hex(xxhash64(input, 0)) + to_hex(xxhash64(input, PRIME64_3));
+    }
+}
@@ -0,0 +1,30 @@
+#ifndef CC_HASH_H
+#define CC_HASH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace cc
+{
+    /**
+     * XXH64 (https://github.com/Cyan4973/xxHash)
+     * Fast non-cryptographic hash used to fingerprint inputs
+     */
+    uint64_t xxhash64(const void* input, size_t len, uint64_t seed = 0);
+
+    inline uint64_t xxhash64(const std::string& input, uint64_t seed = 0)
+    {
+        return xxhash64(input.data(), input.size(), seed);
+    }
+
+    /**
+     * 128-bit content digest formed by two independently
+     * seeded XXH64 passes, rendered as 32 hex digits
+     */
+    std::string content_digest(const std::string& input);
+
+    std::string to_hex(uint64_t value);
+}
+
+#endif //CC_HASH_H
@@ -0,0 +1,599 @@
+#include "io.h"
+#include "common.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+namespace cc
+{
+    struct FileOp
+    {
+        size_t id;
+        bool is_read;
+        std::string path;
+        std::string data;
+        size_t done;
+        int fd;
+
+        FileOp(size_t id, bool is_read, std::string path, std::string data) :
+                id(id), is_read(is_read), path(std::move(path)),
+                data(std::move(data)), done(0), fd(-1) {}
+    };
+
+    class ThreadIO : public BatchIO
+    {
+        std::mutex lock;
+        std::condition_variable work_cv;
+        std::condition_variable done_cv;
+        std::deque<std::unique_ptr<FileOp>> queue;
+        std::deque<Completion> ready;
+        std::vector<std::thread> workers;
+        size_t next_id;
+        size_t pending;     //!< Queued or running
+        bool stopping;
+
+        static int execute(FileOp* op);
+        void work();
+
+    public:
+        explicit ThreadIO(unsigned threads);
+
+        size_t read(const std::string& path) override;
+        size_t write(const std::string& path, std::string data) override;
+        bool wait(Completion& out) override;
+        const char* backend() const override { return "threads"; }
+
+        ~ThreadIO() override;
+    };
+
+    ThreadIO::ThreadIO(unsigned threads) :
+            next_id(0), pending(0), stopping(false)
+    {
+        for (unsigned i = 0; i < threads; i++)
+        {
+            workers.emplace_back(&ThreadIO::work, this);
+        }
+    }
+
+    int ThreadIO::execute(FileOp* op)
+    {
+        if (op->is_read)
+        {
+            op->fd = open(op->path.c_str(), O_RDONLY | O_CLOEXEC);
+        }
+        else
+        {
+            op->fd = open(op->path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        }
+
+        if (op->fd < 0)
+        {
+            return errno;
+        }
+
+        if (op->is_read)
+        {
+            struct stat st{};
+            if (fstat(op->fd, &st) != 0)
+            {
+                return errno;
+            }
+            op->data.resize(st.st_size);
+        }
+
+        while (op->done < op->data.size())
+        {
+            ssize_t n = op->is_read
+                    ? pread(op->fd, &op->data[op->done], op->data.size() - op->done, op->done)
+                    : pwrite(op->fd, &op->data[op->done], op->data.size() - op->done, op->done);
+            if (n < 0 && errno == EINTR)
+            {
+                continue;
+            }
+
+            if (n < 0)
+            {
+                return errno;
+            }
+
+            if (n == 0)
+            {
+                if (!op->is_read)
+                {
+                    return EIO;
+                }
+
+                // The file shrunk since we looked at its size
+                op->data.resize(op->done);
+                break;
+            }
+
+            op->done += n;
+        }
+
+        return 0;
+    }
+
+    void ThreadIO::work()
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        while (true)
+        {
+            work_cv.wait(guard, [this] { return stopping || !queue.empty(); });
+            if (queue.empty())
+            {
+                return;
+            }
+
+            std::unique_ptr<FileOp> op = std::move(queue.front());
+            queue.pop_front();
+
+            guard.unlock();
+            int error = execute(op.get());
+            if (op->fd >= 0)
+            {
+                close(op->fd);
+            }
+            guard.lock();
+
+            ready.push_back({op->id, op->is_read, error,
+                             op->is_read ? std::move(op->data) : std::string()});
+            pending--;
+            done_cv.notify_one();
+        }
+    }
+
+    size_t ThreadIO::read(const std::string& path)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        queue.emplace_back(new FileOp(next_id, true, path, ""));
+        pending++;
+        work_cv.notify_one();
+        return next_id++;
+    }
+
+    size_t ThreadIO::write(const std::string& path, std::string data)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        queue.emplace_back(new FileOp(next_id, false, path, std::move(data)));
+        pending++;
+        work_cv.notify_one();
+        return next_id++;
+    }
+
+    bool ThreadIO::wait(Completion& out)
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        done_cv.wait(guard, [this] { return !ready.empty() || pending == 0; });
+        if (ready.empty())
+        {
+            return false;
+        }
+
+        out = std::move(ready.front());
+        ready.pop_front();
+        return true;
+    }
+
+    ThreadIO::~ThreadIO()
+    {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            stopping = true;
+            queue.clear();
+        }
+
+        work_cv.notify_all();
+        for (std::thread& worker : workers)
+        {
+            worker.join();
+        }
+    }
+
+#ifdef __linux__
+    class UringIO : public BatchIO
+    {
+        /**
+         * Every file goes through OPENAT then as many READ/WRITE
+         * as needed, at most one request per file is in flight.
+         * At most `depth` files are open at once, this bounds both
+         * rings and the number of file descriptors.
+         */
+
+        int ring_fd;
+        unsigned depth;
+
+        void* sq_ring;
+        size_t sq_ring_size;
+        void* cq_ring;
+        size_t cq_ring_size;
+        io_uring_sqe* sqes;
+        size_t sqes_size;
+
+        unsigned* sq_head;
+        unsigned* sq_tail;
+        unsigned sq_mask;
+        unsigned* sq_array;
+        unsigned* cq_head;
+        unsigned* cq_tail;
+        unsigned cq_mask;
+        io_uring_cqe* cqes;
+
+        unsigned to_submit;
+        unsigned active;
+
+        std::vector<std::unique_ptr<FileOp>> ops;
+        std::deque<size_t> backlog;
+        std::deque<Completion> ready;
+
+        io_uring_sqe* get_sqe(const FileOp* op);
+        void submit_open(FileOp* op);
+        void submit_io(FileOp* op);
+        void finish(FileOp* op, int error);
+        void complete(FileOp* op, int res);
+
+        explicit UringIO(unsigned depth);
+        bool setup();
+
+    public:
+        /**
+         * @return nullptr when io_uring is not usable
+         */
+        static UringIO* create(unsigned depth);
+
+        size_t read(const std::string& path) override;
+        size_t write(const std::string& path, std::string data) override;
+        bool wait(Completion& out) override;
+        const char* backend() const override { return "io_uring"; }
+
+        ~UringIO() override;
+    };
+
+    UringIO::UringIO(unsigned depth) :
+            ring_fd(-1), depth(depth),
+            sq_ring(MAP_FAILED), sq_ring_size(0),
+            cq_ring(MAP_FAILED), cq_ring_size(0),
+            sqes(static_cast<io_uring_sqe*>(MAP_FAILED)), sqes_size(0),
+            sq_head(nullptr), sq_tail(nullptr), sq_mask(0), sq_array(nullptr),
+            cq_head(nullptr), cq_tail(nullptr), cq_mask(0), cqes(nullptr),
+            to_submit(0), active(0)
+    {
+    }
+
+    bool UringIO::setup()
+    {
+        io_uring_params params{};
+        ring_fd = (int) syscall(__NR_io_uring_setup, depth, &params);
+        if (ring_fd < 0)
+        {
+            return false;
+        }
+
+        // Make sure every operation we use is supported (5.6+)
+        size_t probe_size = sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op);
+        std::vector<char> probe_buffer(probe_size, 0);
+        auto* probe = reinterpret_cast<io_uring_probe*>(probe_buffer.data());
+        if (syscall(__NR_io_uring_register, ring_fd, IORING_REGISTER_PROBE, probe, 256) < 0)
+        {
+            return false;
+        }
+
+        for (int op : {IORING_OP_OPENAT, IORING_OP_READ, IORING_OP_WRITE})
+        {
+            if (op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED))
+            {
+                return false;
+            }
+        }
+
+        // The rings may be smaller than requested
+        depth = std::min(depth, params.sq_entries);
+
+        sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        if (params.features & IORING_FEAT_SINGLE_MMAP)
+        {
+            sq_ring_size = cq_ring_size = std::max(sq_ring_size, cq_ring_size);
+        }
+
+        sq_ring = mmap(nullptr, sq_ring_size, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+        if (sq_ring == MAP_FAILED)
+        {
+            return false;
+        }
+
+        if (params.features & IORING_FEAT_SINGLE_MMAP)
+        {
+            cq_ring = sq_ring;
+        }
+        else
+        {
+            cq_ring = mmap(nullptr, cq_ring_size, PROT_READ | PROT_WRITE,
+                           MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+            if (cq_ring == MAP_FAILED)
+            {
+                return false;
+            }
+        }
+
+        sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+        sqes = static_cast<io_uring_sqe*>(mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE,
+                                               MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES));
+        if (sqes == MAP_FAILED)
+        {
+            return false;
+        }
+
+        auto* sq = static_cast<char*>(sq_ring);
+        sq_head = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+        sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sq_mask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+
+        auto* cq = static_cast<char*>(cq_ring);
+        cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cq_mask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+        return true;
+    }
+
+    UringIO* UringIO::create(unsigned depth)
+    {
+        auto* self = new UringIO(depth);
+        if (!self->setup())
+        {
+            delete self;
+            return nullptr;
+        }
+
+        return self;
+    }
+
+    io_uring_sqe* UringIO::get_sqe(const FileOp* op)
+    {
+        // Only touched by this thread, the kernel moves the head
+        unsigned tail = *sq_tail;
+        unsigned index = tail & sq_mask;
+
+        io_uring_sqe* sqe = &sqes[index];
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->user_data = op->id;
+        sq_array[index] = index;
+
+        __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+        to_submit++;
+        return sqe;
+    }
+
+    void UringIO::submit_open(FileOp* op)
+    {
+        io_uring_sqe* sqe = get_sqe(op);
+        sqe->opcode = IORING_OP_OPENAT;
+        sqe->fd = AT_FDCWD;
+        sqe->addr = reinterpret_cast<uintptr_t>(op->path.c_str());
+        if (op->is_read)
+        {
+            sqe->open_flags = O_RDONLY | O_CLOEXEC;
+        }
+        else
+        {
+            sqe->open_flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+            sqe->len = 0644;
+        }
+    }
+
+    void UringIO::submit_io(FileOp* op)
+    {
+        io_uring_sqe* sqe = get_sqe(op);
+        sqe->opcode = op->is_read ? IORING_OP_READ : IORING_OP_WRITE;
+        sqe->fd = op->fd;
+        sqe->addr = reinterpret_cast<uintptr_t>(&op->data[op->done]);
+        sqe->len = static_cast<uint32_t>(std::min<size_t>(op->data.size() - op->done, 1u << 30));
+        sqe->off = op->done;
+    }
+
+    void UringIO::finish(FileOp* op, int error)
+    {
+        if (op->fd >= 0)
+        {
+            close(op->fd);
+        }
+
+        ready.push_back({op->id, op->is_read, error,
+                         op->is_read ? std::move(op->data) : std::string()});
+        ops[op->id].reset();
+        active--;
+    }
+
+    void UringIO::complete(FileOp* op, int res)
+    {
+        if (res == -EINTR || res == -EAGAIN)
+        {
+            if (op->fd < 0)
+            {
+                submit_open(op);
+            }
+            else
+            {
+                submit_io(op);
+            }
+            return;
+        }
+
+        if (res < 0)
+        {
+            finish(op, -res);
+            return;
+        }
+
+        if (op->fd < 0)
+        {
+            op->fd = res;
+            if (op->is_read)
+            {
+                struct stat st{};
+                if (fstat(op->fd, &st) != 0)
+                {
+                    finish(op, errno);
+                    return;
+                }
+                op->data.resize(st.st_size);
+            }
+        }
+        else if (res == 0)
+        {
+            if (!op->is_read)
+            {
+                finish(op, EIO);
+                return;
+            }
+
+            // The file shrunk since we looked at its size
+            op->data.resize(op->done);
+        }
+        else
+        {
+            op->done += res;
+        }
+
+        if (op->done < op->data.size())
+        {
+            submit_io(op);
+        }
+        else
+        {
+            finish(op, 0);
+        }
+    }
+
+    size_t UringIO::read(const std::string& path)
+    {
+        size_t id = ops.size();
+        ops.emplace_back(new FileOp(id, true, path, ""));
+        backlog.push_back(id);
+        return id;
+    }
+
+    size_t UringIO::write(const std::string& path, std::string data)
+    {
+        size_t id = ops.size();
+        ops.emplace_back(new FileOp(id, false, path, std::move(data)));
+        backlog.push_back(id);
+        return id;
+    }
+
+    bool UringIO::wait(Completion& out)
+    {
+        while (ready.empty())
+        {
+            while (active < depth && !backlog.empty())
+            {
+                submit_open(ops[backlog.front()].get());
+                backlog.pop_front();
+                active++;
+            }
+
+            if (active == 0)
+            {
+                return false;
+            }
+
+            int n = (int) syscall(__NR_io_uring_enter, ring_fd, to_submit, 1,
+                                  IORING_ENTER_GETEVENTS, nullptr, 0);
+            if (n < 0)
+            {
+                if (errno == EINTR || errno == EAGAIN || errno == EBUSY)
+                {
+                    continue;
+                }
+
+                throw Exception(std::string("io_uring_enter: ") + strerror(errno));
+            }
+            to_submit -= n;
+
+            unsigned head = *cq_head;
+            unsigned tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+            for (; head != tail; head++)
+            {
+                const io_uring_cqe& cqe = cqes[head & cq_mask];
+                complete(ops[cqe.user_data].get(), cqe.res);
+            }
+            __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+        }
+
+        out = std::move(ready.front());
+        ready.pop_front();
+        return true;
+    }
+
+    UringIO::~UringIO()
+    {
+        for (auto& op : ops)
+        {
+            if (op && op->fd >= 0)
+            {
+                close(op->fd);
+            }
+        }
+
+        if (sqes != MAP_FAILED)
+        {
+            munmap(sqes, sqes_size);
+        }
+
+        if (cq_ring != MAP_FAILED && cq_ring != sq_ring)
+        {
+            munmap(cq_ring, cq_ring_size);
+        }
+
+        if (sq_ring != MAP_FAILED)
+        {
+            munmap(sq_ring, sq_ring_size);
+        }
+
+        // Pending requests are cancelled with the ring
+        if (ring_fd >= 0)
+        {
+            close(ring_fd);
+        }
+    }
+#endif
+
+    std::unique_ptr<BatchIO> BatchIO::create(unsigned depth, bool allow_uring)
+    {
+        depth = std::max(depth, 1u);
+
+#ifdef __linux__
+        if (allow_uring)
+        {
+            UringIO* uring = UringIO::create(depth);
+            if (uring)
+            {
+                return std::unique_ptr<BatchIO>(uring);
+            }
+        }
+#endif
+
+        unsigned threads = std::max(1u, std::min(depth, std::thread::hardware_concurrency() * 2));
+        return std::make_unique<ThreadIO>(threads);
+    }
+}
@@ -0,0 +1,63 @@
+#ifndef CC_IO_H
+#define CC_IO_H
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+namespace cc
+{
+    class BatchIO
+    {
+        /**
+         * Batched whole-file reads and writes.
+         *
+         * Requests are queued by read() and write() and submitted together
+         * on the next wait(), which hands back completions one at a time as
+         * they arrive while the remaining requests stay in flight.
+         *
+         * On Linux the requests go through io_uring, kernels without
+         * io_uring (or where it is disabled) use a pool of threads
+         * running open/pread/pwrite.
+         */
+
+    public:
+        struct Completion
+        {
+            size_t id;          //!< Returned by read() or write()
+            bool is_read;
+            int error;          //!< errno, 0 on success
+            std::string data;   //!< Content of the file for reads
+        };
+
+        /**
+         * @param depth maximum number of files open at once
+         * @param allow_uring false to always use the thread pool
+         */
+        static std::unique_ptr<BatchIO> create(unsigned depth = 64, bool allow_uring = true);
+
+        /**
+         * Queue a read of a whole file
+         * @return id of the request
+         */
+        virtual size_t read(const std::string& path) = 0;
+
+        /**
+         * Queue a write (create or truncate) of a whole file
+         * @return id of the request
+         */
+        virtual size_t write(const std::string& path, std::string data) = 0;
+
+        /**
+         * Submit the queued requests and wait for the next completion
+         * @return false once every request has completed
+         */
+        virtual bool wait(Completion& out) = 0;
+
+        virtual const char* backend() const = 0;
+
+        virtual ~BatchIO() = default;
+    };
+}
+
+#endif //CC_IO_H
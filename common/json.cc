@@ -0,0 +1,411 @@
+#include "json.h"
+#include <common/common.h>
+#include <cmath>
+#include <cstring>
+
+namespace cc
+{
+    const Json Json::null_value;
+
+    Json Json::make_array()
+    {
+        Json out;
+        out.type_ = ARRAY;
+        return out;
+    }
+
+    Json Json::make_object()
+    {
+        Json out;
+        out.type_ = OBJECT;
+        return out;
+    }
+
+    void Json::push(Json value)
+    {
+        if (type_ == NUL)
+        {
+            type_ = ARRAY;
+        }
+
+        array.push_back(std::move(value));
+    }
+
+    bool Json::has(const std::string& key) const
+    {
+        return type_ == OBJECT && object.find(key) != object.end();
+    }
+
+    const Json& Json::operator[](const std::string& key) const
+    {
+        if (type_ != OBJECT)
+        {
+            return null_value;
+        }
+
+        auto iter = object.find(key);
+        return iter == object.end() ? null_value : iter->second;
+    }
+
+    Json& Json::operator[](const std::string& key)
+    {
+        if (type_ == NUL)
+        {
+            type_ = OBJECT;
+        }
+
+        return object[key];
+    }
+
+    static void dump_string(const std::string& s, std::string& out)
+    {
+        out += '"';
+        for (char c : s)
+        {
+            switch (c)
+            {
+                case '"': out += "\\\""; break;
+                case '\\': out += "\\\\"; break;
+                case '\n': out += "\\n"; break;
+                case '\r': out += "\\r"; break;
+                case '\t': out += "\\t"; break;
+                case '\b': out += "\\b"; break;
+                case '\f': out += "\\f"; break;
+                default:
+                    if (static_cast<unsigned char>(c) < 0x20)
+                    {
+                        out += variadic_string("\\u%04x", static_cast<unsigned>(c));
+                    }
+                    else
+                    {
+                        out += c;
+                    }
+            }
+        }
+        out += '"';
+    }
+
+    void Json::dump(std::string& out) const
+    {
+        switch (type_)
+        {
+            case NUL:
+                out += "null";
+                break;
+            case BOOLEAN:
+                out += boolean ? "true" : "false";
+                break;
+            case NUMBER:
+                if (number == std::floor(number) && std::fabs(number) < 1e15)
+                {
+                    out += std::to_string(static_cast<int64_t>(number));
+                }
+                else
+                {
+                    out += variadic_string("%.17g", number);
+                }
+                break;
+            case STRING:
+                dump_string(string, out);
+                break;
+            case ARRAY:
+                out += '[';
+                for (size_t i = 0; i < array.size(); i++)
+                {
+                    if (i)
+                    {
+                        out += ',';
+                    }
+                    array[i].dump(out);
+                }
+                out += ']';
+                break;
+            case OBJECT:
+            {
+                out += '{';
+                bool first = true;
+                for (const auto& iter : object)
+                {
+                    if (!first)
+                    {
+                        out += ',';
+                    }
+                    first = false;
+                    dump_string(iter.first, out);
+                    out += ':';
+                    iter.second.dump(out);
+                }
+                out += '}';
+                break;
+            }
+        }
+    }
+
+    std::string Json::dump() const
+    {
+        std::string out;
+        dump(out);
+        return out;
+    }
+
+    class JsonParser
+    {
+        const std::string& text;
+        size_t i;
+
+        [[noreturn]] void fail(const std::string& what) const
+        {
+            throw Exception(variadic_string("JSON parse error at offset %zu: %s", i, what.c_str()));
+        }
+
+        void skip_space()
+        {
+            while (i < text.size() && (text[i] == ' ' || text[i] == '\n'
+                                       || text[i] == '\r' || text[i] == '\t'))
+            {
+                i++;
+            }
+        }
+
+        void expect(const char* word)
+        {
+            size_t n = strlen(word);
+            if (text.compare(i, n, word) != 0)
+            {
+                fail(std::string("expected ") + word);
+            }
+            i += n;
+        }
+
+        static void put_utf8(uint32_t c, std::string& out)
+        {
+            if (c < 0x80)
+            {
+                out += static_cast<char>(c);
+            }
+            else if (c < 0x800)
+            {
+                out += static_cast<char>(0xC0 | (c >> 6));
+                out += static_cast<char>(0x80 | (c & 0x3F));
+            }
+            else if (c < 0x10000)
+            {
+                out += static_cast<char>(0xE0 | (c >> 12));
+                out += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+                out += static_cast<char>(0x80 | (c & 0x3F));
+            }
+            else
+            {
+                out += static_cast<char>(0xF0 | (c >> 18));
+                out += static_cast<char>(0x80 | ((c >> 12) & 0x3F));
+                out += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+                out += static_cast<char>(0x80 | (c & 0x3F));
+            }
+        }
+
+        uint32_t parse_hex4()
+        {
+            if (i + 4 > text.size())
+            {
+                fail("truncated escape");
+            }
+
+            uint32_t c = 0;
+            for (int k = 0; k < 4; k++)
+            {
+                char h = text[i++];
+                c <<= 4;
+                if (h >= '0' && h <= '9') c |= h - '0';
+                else if (h >= 'a' && h <= 'f') c |= h - 'a' + 10;
+                else if (h >= 'A' && h <= 'F') c |= h - 'A' + 10;
+                else fail("invalid escape");
+            }
+
+            return c;
+        }
+
+        std::string parse_string()
+        {
+            std::string out;
+            i++;    // opening quote
+            while (true)
+            {
+                if (i >= text.size())
+                {
+                    fail("unterminated string");
+                }
+
+                char c = text[i++];
+                if (c == '"')
+                {
+                    return out;
+                }
+
+                if (c != '\\')
+                {
+                    out += c;
+                    continue;
+                }
+
+                if (i >= text.size())
+                {
+                    fail("unterminated string");
+                }
+
+                switch (text[i++])
+                {
+                    case '"': out += '"'; break;
+                    case '\\': out += '\\'; break;
+                    case '/': out += '/'; break;
+                    case 'b': out += '\b'; break;
+                    case 'f': out += '\f'; break;
+                    case 'n': out += '\n'; break;
+                    case 'r': out += '\r'; break;
+                    case 't': out += '\t'; break;
+                    case 'u':
+                    {
+                        uint32_t cp = parse_hex4();
+                        if (cp >= 0xD800 && cp < 0xDC00 && text.compare(i, 2, "\\u") == 0)
+                        {
+                            i += 2;
+                            uint32_t low = parse_hex4();
+                            cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                        }
+                        put_utf8(cp, out);
+                        break;
+                    }
+                    default:
+                        fail("invalid escape");
+                }
+            }
+        }
+
+        Json parse_number()
+        {
+            const char* start = text.c_str() + i;
+            char* end;
+            double n = strtod(start, &end);
+            if (end == start)
+            {
+                fail("invalid value");
+            }
+
+            i += end - start;
+            return Json(n);
+        }
+
+    public:
+        explicit JsonParser(const std::string& text) : text(text), i(0) {}
+
+        Json parse_value()
+        {
+            skip_space();
+            if (i >= text.size())
+            {
+                fail("unexpected end of input");
+            }
+
+            switch (text[i])
+            {
+                case 'n':
+                    expect("null");
+                    return Json();
+                case 't':
+                    expect("true");
+                    return Json(true);
+                case 'f':
+                    expect("false");
+                    return Json(false);
+                case '"':
+                    return Json(parse_string());
+                case '[':
+                {
+                    Json out = Json::make_array();
+                    i++;
+                    skip_space();
+                    if (i < text.size() && text[i] == ']')
+                    {
+                        i++;
+                        return out;
+                    }
+
+                    while (true)
+                    {
+                        out.push(parse_value());
+                        skip_space();
+                        if (i < text.size() && text[i] == ',')
+                        {
+                            i++;
+                            continue;
+                        }
+                        if (i < text.size() && text[i] == ']')
+                        {
+                            i++;
+                            return out;
+                        }
+                        fail("expected ',' or ']'");
+                    }
+                }
+                case '{':
+                {
+                    Json out = Json::make_object();
+                    i++;
+                    skip_space();
+                    if (i < text.size() && text[i] == '}')
+                    {
+                        i++;
+                        return out;
+                    }
+
+                    while (true)
+                    {
+                        skip_space();
+                        if (i >= text.size() || text[i] != '"')
+                        {
+                            fail("expected key");
+                        }
+                        std::string key = parse_string();
+                        skip_space();
+                        if (i >= text.size() || text[i] != ':')
+                        {
+                            fail("expected ':'");
+                        }
+                        i++;
+                        out[key] = parse_value();
+                        skip_space();
+                        if (i < text.size() && text[i] == ',')
+                        {
+                            i++;
+                            continue;
+                        }
+                        if (i < text.size() && text[i] == '}')
+                        {
+                            i++;
+                            return out;
+                        }
+                        fail("expected ',' or '}'");
+                    }
+                }
+                default:
+                    return parse_number();
+            }
+        }
+
+        void finish()
+        {
+            skip_space();
+            if (i != text.size())
+            {
+                fail("trailing characters");
+            }
+        }
+    };
+
+    Json Json::parse(const std::string& text)
+    {
+        JsonParser parser(text);
+        Json out = parser.parse_value();
+        parser.finish();
+        return out;
+    }
+}
@@ -0,0 +1,87 @@
+#ifndef CC_JSON_H
+#define CC_JSON_H
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace cc
+{
+    class Json
+    {
+        /**
+         * Minimal JSON document used by the language server and cc-perf.
+         * Numbers are stored as doubles, objects are kept sorted.
+         */
+
+    public:
+        enum type_t
+        {
+            NUL,
+            BOOLEAN,
+            NUMBER,
+            STRING,
+            ARRAY,
+            OBJECT
+        };
+
+    private:
+        type_t type_;
+        bool boolean;
+        double number;
+        std::string string;
+        std::vector<Json> array;
+        std::map<std::string, Json> object;
+
+        static const Json null_value;
+
+    public:
+        Json() : type_(NUL), boolean(false), number(0) {}
+        Json(std::nullptr_t) : Json() {}
+        Json(bool b) : type_(BOOLEAN), boolean(b), number(0) {}
+        Json(int n) : type_(NUMBER), boolean(false), number(n) {}
+        Json(int64_t n) : type_(NUMBER), boolean(false), number(static_cast<double>(n)) {}
+        Json(uint32_t n) : type_(NUMBER), boolean(false), number(n) {}
+        Json(double n) : type_(NUMBER), boolean(false), number(n) {}
+        Json(const char* s) : type_(STRING), boolean(false), number(0), string(s) {}
+        Json(std::string s) : type_(STRING), boolean(false), number(0), string(std::move(s)) {}
+
+        static Json make_array();
+        static Json make_object();
+
+        type_t type() const { return type_; }
+        bool is_null() const { return type_ == NUL; }
+
+        bool as_bool() const { return boolean; }
+        double as_number() const { return number; }
+        int64_t as_int() const { return static_cast<int64_t>(number); }
+        const std::string& as_string() const { return string; }
+
+        size_t size() const { return type_ == OBJECT ? object.size() : array.size(); }
+        const Json& operator[](size_t i) const { return array[i]; }
+        void push(Json value);
+
+        bool has(const std::string& key) const;
+
+        /**
+         * Missing keys read as null
+         */
+        const Json& operator[](const std::string& key) const;
+
+        /**
+         * Missing keys are inserted, null values become objects
+         */
+        Json& operator[](const std::string& key);
+
+        std::string dump() const;
+        void dump(std::string& out) const;
+
+        /**
+         * @throws Exception on malformed input
+         */
+        static Json parse(const std::string& text);
+    };
+}
+
+#endif //CC_JSON_H
@@ -0,0 +1,145 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+
+namespace cc
+{
+    ThreadPool::ThreadPool(unsigned size) :
+            batch(nullptr), generation(0), remaining(0), stopping(false)
+    {
+        if (size == 0)
+        {
+            size = std::max(1u, std::thread::hardware_concurrency());
+        }
+
+        for (unsigned i = 0; i < size; i++)
+        {
+            workers.emplace_back(new Worker());
+        }
+
+        for (unsigned i = 1; i < size; i++)
+        {
+            threads.emplace_back(&ThreadPool::loop, this, i);
+        }
+    }
+
+    bool ThreadPool::take(unsigned worker, size_t& task)
+    {
+        {
+            Worker& self = *workers[worker];
+            std::lock_guard<std::mutex> guard(self.lock);
+            if (!self.tasks.empty())
+            {
+                task = self.tasks.back();
+                self.tasks.pop_back();
+                return true;
+            }
+        }
+
+        // Steal the oldest task of the next worker that has one
+        for (unsigned i = 1; i < workers.size(); i++)
+        {
+            Worker& victim = *workers[(worker + i) % workers.size()];
+            std::lock_guard<std::mutex> guard(victim.lock);
+            if (!victim.tasks.empty())
+            {
+                task = victim.tasks.front();
+                victim.tasks.pop_front();
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    void ThreadPool::work(unsigned worker)
+    {
+        size_t task;
+        while (take(worker, task))
+        {
+            (*batch)(task, worker);
+
+            std::lock_guard<std::mutex> guard(lock);
+            if (--remaining == 0)
+            {
+                done.notify_all();
+            }
+        }
+    }
+
+    void ThreadPool::loop(unsigned worker)
+    {
+        uint64_t seen = 0;
+        for (;;)
+        {
+            {
+                std::unique_lock<std::mutex> guard(lock);
+                wake.wait(guard, [&] { return stopping || generation != seen; });
+                if (stopping)
+                {
+                    return;
+                }
+                seen = generation;
+            }
+
+            work(worker);
+        }
+    }
+
+    void ThreadPool::run(size_t n, const task_t& f)
+    {
+        if (n == 0)
+        {
+            return;
+        }
+
+        if (workers.size() == 1)
+        {
+            for (size_t i = 0; i < n; i++)
+            {
+                f(i, 0);
+            }
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            batch = &f;
+            remaining = n;
+
+            // Worker w starts with the tasks [n * w / size, n * (w + 1) / size)
+            size_t size = workers.size();
+            for (size_t w = 0; w < size; w++)
+            {
+                std::lock_guard<std::mutex> worker_guard(workers[w]->lock);
+                for (size_t i = n * w / size; i < n * (w + 1) / size; i++)
+                {
+                    workers[w]->tasks.push_back(i);
+                }
+            }
+
+            generation++;
+        }
+
+        wake.notify_all();
+        work(0);
+
+        std::unique_lock<std::mutex> guard(lock);
+        done.wait(guard, [this] { return remaining == 0; });
+        batch = nullptr;
+    }
+
+    ThreadPool::~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            stopping = true;
+        }
+
+        wake.notify_all();
+        for (std::thread& thread : threads)
+        {
+            thread.join();
+        }
+    }
+}
@@ -0,0 +1,76 @@
+#ifndef CC_THREAD_POOL_H
+#define CC_THREAD_POOL_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace cc
+{
+    class ThreadPool
+    {
+        /**
+         * Runs batches of independent tasks on a fixed set of threads
+         * with work stealing.
+         *
+         * Every worker owns a deque seeded with a contiguous slice of the
+         * batch. It takes its own tasks from the back and, once its deque
+         * is empty, steals from the front of the other deques. Uneven
+         * tasks (a few huge functions among many small ones) are spread
+         * over the workers without a shared queue.
+         *
+         * The thread calling run() is worker 0 and takes part in the batch.
+         */
+
+        typedef std::function<void(size_t task, unsigned worker)> task_t;
+
+        struct Worker
+        {
+            std::mutex lock;
+            std::deque<size_t> tasks;
+        };
+
+        std::vector<std::unique_ptr<Worker>> workers;
+        std::vector<std::thread> threads;
+
+        std::mutex lock;
+        std::condition_variable wake;
+        std::condition_variable done;
+        const task_t* batch;
+        uint64_t generation;
+        size_t remaining;
+        bool stopping;
+
+        bool take(unsigned worker, size_t& task);
+        void work(unsigned worker);
+        void loop(unsigned worker);
+
+    public:
+        /**
+         * @param size number of workers, the calling thread included.
+         *             0 for one worker per hardware thread.
+         */
+        explicit ThreadPool(unsigned size);
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        unsigned size() const { return static_cast<unsigned>(workers.size()); }
+
+        /**
+         * Run the tasks 0..n-1 and wait for all of them to complete.
+         * Tasks may run in any order and on any worker, they must not throw.
+         * @param f called with the task and the worker running it
+         */
+        void run(size_t n, const task_t& f);
+
+        ~ThreadPool();
+    };
+}
+
+#endif //CC_THREAD_POOL_H
@@ -0,0 +1,331 @@
+#include "cache.h"
+#include <common/common.h>
+#include <common/hash.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <fstream>
+#include <sstream>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+namespace cc
+{
+    static const char ENTRY_MAGIC[4] = {'C', 'C', 'E', '1'};
+
+    // Evict down to this fraction of the limit so that eviction
+    // does not run on every store once the cache is full
+    constexpr double EVICTION_TARGET = 0.8;
+
+    // Entries are split over shards by the first hex digit of their
+    // key, each one is locked, counted and evicted on its own
+    constexpr unsigned SHARDS = 16;
+    static const char HEX_DIGITS[] = "0123456789abcdef";
+
+    struct Cache::Stats
+    {
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t entries;
+        uint64_t size;
+    };
+
+    static void put_u32(std::ostream& os, uint32_t v)
+    {
+        os.write(reinterpret_cast<const char*>(&v), sizeof(v));
+    }
+
+    static bool get_u32(std::istream& is, uint32_t& v)
+    {
+        return static_cast<bool>(is.read(reinterpret_cast<char*>(&v), sizeof(v)));
+    }
+
+    static bool get_string(std::istream& is, std::string& s)
+    {
+        uint32_t n;
+        if (!get_u32(is, n))
+        {
+            return false;
+        }
+
+        s.resize(n);
+        return n == 0 || static_cast<bool>(is.read(&s[0], n));
+    }
+
+    Cache::Cache(std::string directory_, uint64_t max_size) :
+            directory(std::move(directory_)), max_size(max_size)
+    {
+        while (directory.size() > 1 && directory.back() == '/')
+        {
+            directory.pop_back();
+        }
+
+        make_directories(directory);
+    }
+
+    std::string Cache::get_key(const std::string& flags, const std::string& input)
+    {
+        std::string keyed;
+        keyed.reserve(input.size() + flags.size() + 64);
+
+        // Length prefix every field so that moving bytes from one
+        // field to the next changes the key
+        keyed += std::string(CC_VERSION) + '\0' + std::to_string(flags.size()) + '\0';
+        keyed += flags;
+        keyed += input;
+
+        return content_digest(keyed);
+    }
+
+    std::string Cache::entry_path(const std::string& key) const
+    {
+        return directory + "/" + key.substr(0, 2) + "/" + key.substr(2);
+    }
+
+    template<typename F>
+    void Cache::update_stats(const std::string& shard, F f) const
+    {
+        std::string path = directory + "/stats." + shard;
+        int fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+        if (fd < 0)
+        {
+            return;
+        }
+
+        flock(fd, LOCK_EX);
+
+        Stats stats{0, 0, 0, 0};
+        char buf[256];
+        ssize_t n = pread(fd, buf, sizeof(buf) - 1, 0);
+        if (n > 0)
+        {
+            buf[n] = 0;
+            unsigned long long h = 0, m = 0, e = 0, s = 0;
+            if (sscanf(buf, "hits %llu\nmisses %llu\nentries %llu\nsize %llu\n", &h, &m, &e, &s) == 4)
+            {
+                stats = {h, m, e, s};
+            }
+        }
+
+        Stats before = stats;
+        f(stats);
+
+        if (memcmp(&before, &stats, sizeof(Stats)) != 0)
+        {
+            std::string out = variadic_string("hits %llu\nmisses %llu\nentries %llu\nsize %llu\n",
+                                              (unsigned long long) stats.hits,
+                                              (unsigned long long) stats.misses,
+                                              (unsigned long long) stats.entries,
+                                              (unsigned long long) stats.size);
+            if (ftruncate(fd, 0) == 0)
+            {
+                ssize_t w = pwrite(fd, out.data(), out.size(), 0);
+                (void) w;
+            }
+        }
+
+        flock(fd, LOCK_UN);
+        close(fd);
+    }
+
+    bool Cache::lookup(const std::string& key, Entry& entry) const
+    {
+        std::string path = entry_path(key);
+        std::ifstream is(path, std::ios::binary);
+
+        char magic[sizeof(ENTRY_MAGIC)];
+        bool hit = is.is_open()
+                   && is.read(magic, sizeof(magic))
+                   && memcmp(magic, ENTRY_MAGIC, sizeof(magic)) == 0
+                   && get_u32(is, entry.exit_code)
+                   && get_string(is, entry.out)
+                   && get_string(is, entry.err);
+
+        if (hit)
+        {
+            // Mark as recently used
+            utimensat(AT_FDCWD, path.c_str(), nullptr, 0);
+        }
+
+        update_stats(key.substr(0, 1), [hit](Stats& stats) {
+            if (hit) stats.hits++;
+            else stats.misses++;
+        });
+
+        return hit;
+    }
+
+    void Cache::store(const std::string& key, const Entry& entry) const
+    {
+        std::string shard = key.substr(0, 1);
+        std::string path = entry_path(key);
+        make_directories(directory + "/" + key.substr(0, 2));
+
+        // Write to a temporary file first so that concurrent
+        // readers never see a partial entry
+        std::string tmp_path = variadic_string("%s.tmp.%d", path.c_str(), (int) getpid());
+        {
+            std::ofstream os(tmp_path, std::ios::binary | std::ios::trunc);
+            if (!os.is_open())
+            {
+                return;
+            }
+
+            os.write(ENTRY_MAGIC, sizeof(ENTRY_MAGIC));
+            put_u32(os, entry.exit_code);
+            put_u32(os, entry.out.size());
+            os.write(entry.out.data(), entry.out.size());
+            put_u32(os, entry.err.size());
+            os.write(entry.err.data(), entry.err.size());
+
+            if (!os.good())
+            {
+                os.close();
+                unlink(tmp_path.c_str());
+                return;
+            }
+        }
+
+        uint64_t entry_size = sizeof(ENTRY_MAGIC) + 3 * sizeof(uint32_t)
+                              + entry.out.size() + entry.err.size();
+
+        // The entry replaces the one stored for the same key by another
+        // process, if any, under the lock so that it is counted once
+        bool full = false;
+        update_stats(shard, [&](Stats& stats) {
+            struct stat old{};
+            bool replaced = stat(path.c_str(), &old) == 0;
+            if (rename(tmp_path.c_str(), path.c_str()) != 0)
+            {
+                unlink(tmp_path.c_str());
+                return;
+            }
+
+            if (replaced)
+            {
+                stats.size -= std::min<uint64_t>(stats.size, old.st_size);
+            }
+            else
+            {
+                stats.entries++;
+            }
+
+            stats.size += entry_size;
+            full = stats.size > shard_size();
+        });
+
+        if (full)
+        {
+            evict(shard, static_cast<uint64_t>(shard_size() * EVICTION_TARGET));
+        }
+    }
+
+    void Cache::evict(const std::string& shard, uint64_t target_size) const
+    {
+        struct EntryFile
+        {
+            std::string path;
+            timespec mtime;
+            uint64_t size;
+        };
+
+        std::vector<EntryFile> files;
+        uint64_t total = 0;
+
+        // Entries live in the two digit hex sub-directories
+        // starting with the digit of the shard
+        for (const char* digit = HEX_DIGITS; *digit; digit++)
+        {
+            std::string sub_path = directory + "/" + shard + *digit;
+            DIR* d = opendir(sub_path.c_str());
+            if (!d)
+            {
+                continue;
+            }
+
+            while (dirent* e = readdir(d))
+            {
+                // Temporary files are entries being written by store(),
+                // possibly in another process, they are not in the cache yet
+                if (e->d_name[0] == '.' || strstr(e->d_name, ".tmp.") != nullptr)
+                {
+                    continue;
+                }
+
+                std::string path = sub_path + "/" + e->d_name;
+                struct stat st{};
+                if (stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode))
+                {
+                    files.push_back({path, st.st_mtim, static_cast<uint64_t>(st.st_size)});
+                    total += st.st_size;
+                }
+            }
+
+            closedir(d);
+        }
+
+        std::sort(files.begin(), files.end(), [](const EntryFile& a, const EntryFile& b) {
+            if (a.mtime.tv_sec != b.mtime.tv_sec) return a.mtime.tv_sec < b.mtime.tv_sec;
+            return a.mtime.tv_nsec < b.mtime.tv_nsec;
+        });
+
+        uint64_t entries = files.size();
+        for (const auto& iter : files)
+        {
+            if (total <= target_size)
+            {
+                break;
+            }
+
+            if (unlink(iter.path.c_str()) == 0)
+            {
+                total -= iter.size;
+                entries--;
+            }
+        }
+
+        update_stats(shard, [&](Stats& stats) {
+            stats.entries = entries;
+            stats.size = total;
+        });
+    }
+
+    uint64_t Cache::shard_size() const
+    {
+        return max_size / SHARDS;
+    }
+
+    Cache::Statistics Cache::get_statistics() const
+    {
+        Statistics out{0, 0, 0, 0};
+        for (unsigned i = 0; i < SHARDS; i++)
+        {
+            update_stats(std::string(1, HEX_DIGITS[i]), [&](Stats& stats) {
+                out.hits += stats.hits;
+                out.misses += stats.misses;
+                out.entries += stats.entries;
+                out.size += stats.size;
+            });
+        }
+
+        return out;
+    }
+
+    void Cache::clear() const
+    {
+        for (unsigned i = 0; i < SHARDS; i++)
+        {
+            std::string shard(1, HEX_DIGITS[i]);
+            evict(shard, 0);
+            update_stats(shard, [](Stats& stats) {
+                stats.hits = 0;
+                stats.misses = 0;
+            });
+        }
+    }
+}
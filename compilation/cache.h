@@ -0,0 +1,67 @@
+#ifndef CC_CACHE_H
+#define CC_CACHE_H
+
+#include <cstdint>
+#include <string>
+
+namespace cc
+{
+    class Cache
+    {
+        /**
+         * Content addressed on-disk compilation cache.
+         *
+         * Entries are keyed by a digest of the compiler version, the
+         * output affecting flags and the input bytes. Each entry stores
+         * the exit code, output and diagnostics of the compilation.
+         * Hits refresh the entry's modification time which is used to
+         * evict the least recently used entries once the cache grows
+         * beyond its size limit.
+         *
+         * The entries are sharded by the first hex digit of their key.
+         * Each shard keeps the statistics of its entries in its own lock
+         * protected file shared between processes, and is evicted on its
+         * own once it takes more than its share of the size limit. Hits
+         * on different shards do not contend.
+         */
+
+        std::string directory;
+        uint64_t max_size;
+
+        struct Stats;
+        template<typename F>
+        void update_stats(const std::string& shard, F f) const;
+
+        void evict(const std::string& shard, uint64_t target_size) const;
+        uint64_t shard_size() const;
+        std::string entry_path(const std::string& key) const;
+
+    public:
+        struct Entry
+        {
+            uint32_t exit_code;
+            std::string out;
+            std::string err;
+        };
+
+        struct Statistics
+        {
+            uint64_t hits;
+            uint64_t misses;
+            uint64_t entries;
+            uint64_t size;
+        };
+
+        Cache(std::string directory, uint64_t max_size);
+
+        static std::string get_key(const std::string& flags, const std::string& input);
+
+        bool lookup(const std::string& key, Entry& entry) const;
+        void store(const std::string& key, const Entry& entry) const;
+
+        Statistics get_statistics() const;
+        void clear() const;
+    };
+}
+
+#endif //CC_CACHE_H
@@ -0,0 +1,62 @@
+#include "callgraph.h"
+
+namespace cc
+{
+    CallGraph::CallGraph(const ASTGlobal* ast)
+    {
+        for (const ASTGlobal* iter = ast; iter; iter = iter->next)
+        {
+            const auto* f = dynamic_cast<const ASTFunctionDefine*>(iter);
+            if (f)
+            {
+                definitions[f->name] = f;
+            }
+        }
+    }
+
+    std::set<std::string> CallGraph::reachable(const std::vector<std::string>& roots) const
+    {
+        std::set<std::string> out;
+        std::vector<const ASTFunctionDefine*> stack;
+        for (const std::string& root : roots)
+        {
+            auto iter = definitions.find(root);
+            if (iter != definitions.end() && out.insert(root).second)
+            {
+                stack.push_back(iter->second);
+            }
+        }
+
+        while (!stack.empty())
+        {
+            const ASTFunctionDefine* f = stack.back();
+            stack.pop_back();
+
+            for (const std::string& callee : f->callees)
+            {
+                auto iter = definitions.find(callee);
+                if (iter != definitions.end() && out.insert(callee).second)
+                {
+                    stack.push_back(iter->second);
+                }
+            }
+        }
+
+        return out;
+    }
+
+    std::vector<std::string> CallGraph::default_roots() const
+    {
+        if (is_defined("main"))
+        {
+            return {"main"};
+        }
+
+        std::vector<std::string> out;
+        for (const auto& iter : definitions)
+        {
+            out.push_back(iter.first);
+        }
+        return out;
+    }
+}
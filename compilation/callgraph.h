@@ -0,0 +1,47 @@
+#ifndef CC_CALLGRAPH_H
+#define CC_CALLGRAPH_H
+
+#include <cc.h>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace cc
+{
+    class CallGraph
+    {
+        /**
+         * Calls between the functions defined in a translation unit,
+         * built out of the callees the resolution pass records for
+         * every function definition (see CallExpr::resolution_pass).
+         * Calls to functions that are only declared are kept as edges
+         * but lead nowhere.
+         */
+
+        std::map<std::string, const ASTFunctionDefine*> definitions;
+
+    public:
+        /**
+         * @param ast resolved translation unit
+         */
+        explicit CallGraph(const ASTGlobal* ast);
+
+        bool is_defined(const std::string& name) const { return definitions.count(name); }
+
+        /**
+         * Every function defined in the translation unit that may be
+         * called starting from the roots, the roots included.
+         * Roots not defined in the translation unit are ignored.
+         */
+        std::set<std::string> reachable(const std::vector<std::string>& roots) const;
+
+        /**
+         * Default roots: main when it is defined, otherwise every
+         * definition since they may all be called from outside
+         */
+        std::vector<std::string> default_roots() const;
+    };
+}
+
+#endif //CC_CALLGRAPH_H
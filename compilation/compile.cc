@@ -2,53 +2,67 @@
 #include "cc.h"
 #include "module.h"
 #include "instruction.h"
-#include <fstream>
+#include "callgraph.h"
 #include <grammar/grammar.h>
 #include <iostream>
 #include <debug/print_debug.h>
+#include <opt/folder.h>
+#include <opt/ir_text.h>
+#include <opt/pass_manager.h>
+#include <common/thread_pool.h>
+#include <exception>
+#include <memory>
+#include <mutex>
 
 namespace cc
 {
-    static void read_file(std::ifstream &t,
-                          std::string &str)
+    // The parser tables are global, build them once for all parsers.
+    // Parsers may be created and destroyed on several threads.
+    static std::mutex parser_table_lock;
+    static int parser_table_users = 0;
+
+    Parser::Parser() : buffers(nullptr)
     {
-        t.seekg(0, std::ios::end);
-        str.reserve(t.tellg());
-        t.seekg(0, std::ios::beg);
+        {
+            std::lock_guard<std::mutex> guard(parser_table_lock);
+            if (parser_table_users++ == 0)
+            {
+                cc_init();
+            }
+        }
 
-        str.assign((std::istreambuf_iterator<char>(t)),
-                   std::istreambuf_iterator<char>());
+        buffers = cc_allocate_buffers();
     }
 
-    Compiler::Compiler(std::string filename) :
-            ast(nullptr), filename(std::move(filename)), ctx(new Context())
+    Parser::~Parser()
     {
-    }
+        cc_free_buffers(buffers);
 
-    void Compiler::read(std::string &file_content)
-    {
-        std::ifstream input_file(filename);
-        if (!input_file.is_open())
+        std::lock_guard<std::mutex> guard(parser_table_lock);
+        if (--parser_table_users == 0)
         {
-            throw Exception("Failed to open file: " + filename);
+            cc_free();
         }
-
-        read_file(input_file, file_content);
-        lines = split_string(file_content, '\n');
     }
 
-    bool Compiler::parse()
+    ASTGlobal* Parser::parse(Context* ctx, const char* input) const
     {
-        std::string file;
-        read(file);
-
-        cc_init();
-        CCBuffers* buf = cc_allocate_buffers();
+        return cc_parse(ctx, buffers, input);
+    }
 
-        ast = cc_parse(ctx, buf, file.c_str());
+    Compiler::Compiler(std::string filename, std::string source, Context* ctx,
+                       const Parser* parser, std::ostream& os) :
+            ast(nullptr), filename(std::move(filename)), source(std::move(source)),
+            ctx(ctx), parser(parser), os(os),
+            reported_errors(0), print_diagnostics(true),
+            incremental(nullptr), passes(nullptr), emit_ir(false), lazy(false), pool(nullptr)
+    {
+        lines = split_string(this->source, '\n');
+    }
 
-        cc_free_buffers(buf);
-        cc_free();
+    bool Compiler::parse()
+    {
+        ast = parser->parse(ctx, source.c_str());
 
         return not put_errors() && ast;
     }
@@ -64,27 +78,26 @@ namespace cc
         return count;
     }
 
+    /**
+     * @param lines source lines starting at the 0-based line first_line
+     */
     static void put_position(const ASTPosition& position,
                              const std::vector<std::string>& lines,
+                             uint32_t first_line,
                              std::ostream& os)
     {
-        if (position.line < 0)
-        {
-            return;
-        }
-
         // Get the number of digits in the line number:
         int dig_n = snprintf(nullptr, 0, "%+d", position.line);
 
         for (int i = (int) position.line - ERROR_CONTEXT_LINE_N; i < (int) position.line; i++)
         {
-            if (i < 0)
+            if (i < (int) first_line || i - first_line >= lines.size())
             {
                 continue;
             }
 
             os << variadic_string("% *d | %s\n", dig_n, i + 1,
-                                  lines[i].c_str());
+                                  lines[i - first_line].c_str());
         }
 
         if (position.line > 0)
@@ -97,44 +110,74 @@ namespace cc
     }
 
     static void put_warnings_or_errors(const std::vector<ASTException> &l,
+                                       size_t start,
                                        const std::vector<std::string> &lines,
+                                       uint32_t first_line,
                                        const std::string &filename,
                                        const std::string &message,
                                        std::ostream& os)
     {
-        for (const auto& e : l)
+        for (size_t i = start; i < l.size(); i++)
         {
+            const ASTException& e = l[i];
             os << "\033[1m" << filename << ":" << e.self.line << ":" << e.self.col + 1
                       << " " << message << ": " << e.what() << "\n";
-            put_position(e.self, lines, os);
+            put_position(e.self, lines, first_line, os);
             os << "\n";
         }
     }
 
-    bool Compiler::put_errors() const
+    static void collect_diagnostics(const std::vector<ASTException> &l,
+                                    size_t start,
+                                    Diagnostic::severity_t severity,
+                                    const std::string &filename,
+                                    std::vector<Diagnostic>& out)
+    {
+        for (size_t i = start; i < l.size(); i++)
+        {
+            const ASTException& e = l[i];
+            out.push_back({severity, filename,
+                           e.self.line, static_cast<uint32_t>(e.self.col + 1u),
+                           e.self.len, e.what()});
+        }
+    }
+
+    bool Compiler::put_errors()
     {
         const std::vector<ASTException>& errors = ctx->get_errors();
         const std::vector<ASTException>& warnings = ctx->get_warnings();
 
-        put_warnings_or_errors(errors, lines, filename, "\033[1;31merror:\033[1;0m ", std::cout);
-        put_warnings_or_errors(warnings, lines, filename, "\033[1;33mwarning:\033[1;0m ", std::cout);
+        if (print_diagnostics)
+        {
+            put_warnings_or_errors(errors, reported_errors, lines, 0, filename, "\033[1;31merror:\033[1;0m ", os);
+            put_warnings_or_errors(warnings, 0, lines, 0, filename, "\033[1;33mwarning:\033[1;0m ", os);
+        }
+
+        collect_diagnostics(errors, reported_errors, Diagnostic::ERROR, filename, diagnostics);
+        collect_diagnostics(warnings, 0, Diagnostic::WARNING, filename, diagnostics);
 
+        reported_errors = errors.size();
         ctx->clear_warnings();
 
         return !errors.empty();
     }
 
-    static void resolution_pass_cb(ASTValue* self, Context* ctx)
+    static void resolution_pass_cb(ASTValue* self, Context* ctx, void*)
     {
         self->resolution_pass(ctx);
     }
 
+    void resolve_global(Context* ctx, ASTGlobal* global)
+    {
+        global->traverse(resolution_pass_cb, ctx, nullptr);
+    }
+
     bool Compiler::resolve()
     {
         ctx->start_scope_build();
         for (ASTGlobal* iter = ast; iter; iter = iter->next)
         {
-            iter->traverse(reinterpret_cast<ASTValue::TraverseCB>(resolution_pass_cb), ctx, nullptr);
+            resolve_global(ctx, iter);
         }
         ctx->end_scope_build();
 
@@ -145,45 +188,444 @@ namespace cc
     {
         std::stringstream ss;
         p(ss, ast);
-        std::cout << ss.str();
+        os << ss.str();
     }
 
     void Compiler::dump_ir() const
     {
         std::stringstream ss;
-        p(ss, ctx->get_module()->scope());
-        std::cout << ss.str();
+        const Scope* top = ctx->get_module()->scope();
+
+        if (not incremental)
+        {
+            p(ss, top);
+            os << ss.str();
+            return;
+        }
+
+        // Print the module blocks followed by every function
+        // Function scopes are in the same order as their definitions
+        p(ss, top, false, false);
+        const Scope* f_scope = top->child();
+        for (const auto& f : function_irs)
+        {
+            assert(f_scope);
+            if (f.cached)
+            {
+                ss << *f.cached;
+                incremental->record(f.ast->name, f.fingerprint, *f.cached);
+            }
+            else
+            {
+                std::stringstream fs;
+                p(fs, f_scope, false);
+                ss << fs.str();
+                incremental->record(f.ast->name, f.fingerprint, fs.str());
+            }
+
+            f_scope = f_scope->next();
+        }
+
+        os << ss.str();
     }
 
     Compiler::~Compiler()
     {
-        delete ctx;
+        ctx->reset();
         delete ast;
     }
 
     bool Compiler::execute()
     {
         if (not parse()) return false;
-        dump_ast();
+        if (not emit_ir) dump_ast();
 
         if (not resolve()) return false;
         if (not ir()) return false;
 
-        dump_ir();
+        if (emit_ir)
+        {
+            std::stringstream ss;
+            write_ir(ss, ctx);
+            os << ss.str();
+        }
+        else
+        {
+            dump_ir();
+        }
         return true;
     }
 
     bool Compiler::ir()
     {
-        /* Build everything */
+        /* Build everything (reachable) */
         IRBuilder IRB;
 
+        std::set<std::string> reachable;
+        if (lazy)
+        {
+            CallGraph graph(ast);
+            reachable = graph.reachable(roots.empty() ? graph.default_roots() : roots);
+        }
+
+        // Functions only read the module and the types, each one is
+        // lowered in its own scope with a context borrowing ctx
+        struct Job
+        {
+            const ASTFunctionDefine* ast;
+            Scope* scope;
+            std::unique_ptr<Context> ctx;
+            std::exception_ptr error;
+        };
+        std::vector<Job> jobs;
+
         for (ASTGlobal* iter = ast; iter; iter = iter->next)
         {
             IRB.set_insertion_point(nullptr);
+
+            const auto* define = dynamic_cast<const ASTFunctionDefine*>(iter);
+            if (lazy && define && !reachable.count(define->name))
+            {
+                // Nothing calls it, it is only declared
+                ctx->enter_scope(Scope::FUNCTION, define->name);
+                ctx->exit_scope();
+                continue;
+            }
+
+            const auto* f = incremental ? dynamic_cast<const ASTFunctionDefine*>(iter) : nullptr;
+            if (f)
+            {
+                std::string fingerprint = incremental->fingerprint(f, ctx, lines);
+                const std::string* cached = incremental->lookup(f->name, fingerprint);
+                function_irs.push_back({f, fingerprint, cached});
+
+                if (cached)
+                {
+                    // Step over the function's scope without lowering it
+                    ctx->enter_scope(Scope::FUNCTION, f->name);
+                    ctx->exit_scope();
+                    continue;
+                }
+            }
+
+            if (define)
+            {
+                ctx->enter_scope(Scope::FUNCTION, define->name);
+                jobs.push_back({define, ctx->scope(), std::unique_ptr<Context>(new Context(ctx)), nullptr});
+                ctx->exit_scope();
+                continue;
+            }
+
             iter->add(ctx, IRB);
         }
 
-        return not put_errors();
+        // Optimization fuel is spent in the order of the module,
+        // the passes then wait for every function to be lowered
+        bool run_passes = passes && passes->get_options().fuel < 0;
+        unsigned workers = pool ? pool->size() : 1;
+
+        std::vector<std::unique_ptr<PassManager>> managers(workers);
+        for (unsigned i = 1; i < workers && run_passes; i++)
+        {
+            managers[i] = passes->clone();
+            run_passes = managers[i] != nullptr;
+        }
+
+        auto lower = [this, &jobs, &managers, run_passes](size_t i, unsigned worker)
+        {
+            Job& job = jobs[i];
+            try
+            {
+                job.ctx->resume_scope(job.scope);
+
+                IRBuilder builder;
+                Folder folder;
+                if (passes && passes->folds_on_build())
+                {
+                    builder.set_folder(&folder);
+                }
+
+                job.ast->lower(job.ctx.get(), builder);
+                if (run_passes && job.ctx->get_errors().empty())
+                {
+                    PassManager* manager = worker ? managers[worker].get() : passes;
+                    manager->run(job.ctx.get(), job.ctx->get_function());
+                }
+            }
+            catch (...)
+            {
+                job.error = std::current_exception();
+            }
+        };
+
+        if (pool)
+        {
+            pool->run(jobs.size(), lower);
+        }
+        else
+        {
+            for (size_t i = 0; i < jobs.size(); i++)
+            {
+                lower(i, 0);
+            }
+        }
+
+        // Diagnostics in the order of the definitions, as if lowered
+        // one after the other: nothing after the first exception
+        for (Job& job : jobs)
+        {
+            for (const ASTException& e : job.ctx->get_errors())
+            {
+                ctx->emit_error(e);
+            }
+            for (const ASTException& e : job.ctx->get_warnings())
+            {
+                ctx->emit_warning(e);
+            }
+
+            if (job.error)
+            {
+                std::rethrow_exception(job.error);
+            }
+        }
+
+        for (unsigned i = 1; i < workers; i++)
+        {
+            if (managers[i])
+            {
+                passes->merge_statistics(*managers[i]);
+            }
+        }
+
+        if (put_errors())
+        {
+            return false;
+        }
+
+        if (passes)
+        {
+            if (run_passes)
+            {
+                passes->run_module_passes(ctx, ctx->get_module());
+            }
+            else
+            {
+                passes->run(ctx, ctx->get_module());
+            }
+        }
+
+        return true;
+    }
+
+    StreamCompiler::StreamCompiler(std::string filename, std::istream& in, Context* ctx,
+                                   const Parser* parser, std::ostream& os) :
+            filename(std::move(filename)), in(in), ctx(ctx), parser(parser),
+            os(os), print_diagnostics(true), passes(nullptr)
+    {
+    }
+
+    static std::vector<ASTException> relocate(const std::vector<ASTException>& l,
+                                              const Declaration& decl)
+    {
+        // Positions are relative to the declaration's text
+        std::vector<ASTException> out;
+        for (const ASTException& e : l)
+        {
+            ASTPosition position(&e.self);
+            if (position.line > 0)
+            {
+                if (position.line == 1)
+                {
+                    position.col += decl.col;
+                }
+                position.line += decl.line;
+            }
+
+            out.emplace_back(&position, std::string(e.what()));
+        }
+
+        return out;
+    }
+
+    bool StreamCompiler::put_errors(const Declaration& decl)
+    {
+        if (ctx->get_errors().empty() && ctx->get_warnings().empty())
+        {
+            return false;
+        }
+
+        std::vector<ASTException> errors = relocate(ctx->get_errors(), decl);
+        std::vector<ASTException> warnings = relocate(ctx->get_warnings(), decl);
+        ctx->clear_errors();
+        ctx->clear_warnings();
+
+        if (print_diagnostics)
+        {
+            // Source lines around the declaration
+            std::vector<std::string> lines = previous_lines;
+            std::vector<std::string> current = split_string(partial_line + decl.text, '\n');
+            lines.insert(lines.end(), current.begin(), current.end());
+            uint32_t first_line = decl.line - previous_lines.size();
+
+            put_warnings_or_errors(errors, 0, lines, first_line, filename, "\033[1;31merror:\033[1;0m ", os);
+            put_warnings_or_errors(warnings, 0, lines, first_line, filename, "\033[1;33mwarning:\033[1;0m ", os);
+        }
+
+        collect_diagnostics(errors, 0, Diagnostic::ERROR, filename, diagnostics);
+        collect_diagnostics(warnings, 0, Diagnostic::WARNING, filename, diagnostics);
+
+        return !errors.empty();
+    }
+
+    void StreamCompiler::advance(const Declaration& decl)
+    {
+        // Only keep the lines needed to show the context of an error
+        size_t start = decl.text.size();
+        for (int n = 0; n <= ERROR_CONTEXT_LINE_N && start > 0; )
+        {
+            start--;
+            if (decl.text[start] == '\n' && ++n > ERROR_CONTEXT_LINE_N)
+            {
+                start++;
+                break;
+            }
+        }
+
+        std::string tail = (start == 0 ? partial_line : "") + decl.text.substr(start);
+        size_t newline;
+        while ((newline = tail.find('\n')) != std::string::npos)
+        {
+            previous_lines.push_back(tail.substr(0, newline));
+            tail.erase(0, newline + 1);
+        }
+        partial_line = std::move(tail);
+
+        if (previous_lines.size() > ERROR_CONTEXT_LINE_N)
+        {
+            previous_lines.erase(previous_lines.begin(),
+                                 previous_lines.end() - ERROR_CONTEXT_LINE_N);
+        }
+    }
+
+    bool StreamCompiler::execute()
+    {
+        DeclarationReader reader(in);
+        Declaration decl;
+        IRBuilder IRB;
+        Folder folder;
+        if (passes && passes->folds_on_build())
+        {
+            IRB.set_folder(&folder);
+        }
+        Scope* top = ctx->get_module()->scope();
+
+        bool ok = true;         // Nothing failed, keep printing
+        bool resolved = true;   // No parsing or resolution errors, keep lowering
+
+        while (reader.next(decl))
+        {
+            if (decl.is_blank())
+            {
+                advance(decl);
+                continue;
+            }
+
+            ASTGlobal* ast = parser->parse(ctx, decl.text.c_str());
+            if (put_errors(decl) || !ast)
+            {
+                ok = resolved = false;
+                delete ast;
+                advance(decl);
+                continue;
+            }
+
+            if (ok)
+            {
+                std::stringstream ss;
+                p(ss, ast);
+                os << ss.str();
+            }
+
+            for (ASTGlobal* iter = ast; iter; iter = iter->next)
+            {
+                Scope* last = top->last();
+                ctx->start_scope_build();
+                resolve_global(ctx, iter);
+                ctx->end_scope_build();
+
+                Scope* scope = top->last() != last ? top->last() : nullptr;
+                if (put_errors(decl))
+                {
+                    ok = resolved = false;
+                }
+
+                if (resolved)
+                {
+                    IRB.set_insertion_point(nullptr);
+                    iter->add(ctx, IRB);
+                    ok = !put_errors(decl) && ok;
+                }
+
+                auto* f = dynamic_cast<Function*>(iter->symbol);
+                if (ok && passes && f && dynamic_cast<ASTFunctionDefine*>(iter))
+                {
+                    passes->run(ctx, f);
+                }
+
+                if (scope)
+                {
+                    if (ok)
+                    {
+                        std::stringstream ss;
+                        p(ss, scope, false);
+                        os << ss.str();
+                    }
+
+                    top->remove_child(scope);
+                }
+
+                if (f && dynamic_cast<ASTFunctionDefine*>(iter))
+                {
+                    f->release_body();
+                }
+            }
+
+            // Function bodies are not referenced once lowered, the
+            // declarations of other globals are part of their symbols
+            if (dynamic_cast<ASTFunctionDefine*>(ast) && !ast->next)
+            {
+                delete ast;
+            }
+            else
+            {
+                resident.push_back(ast);
+            }
+
+            advance(decl);
+        }
+
+        if (ok)
+        {
+            // Function bodies are gone, only module passes run
+            if (passes)
+            {
+                passes->run(ctx, ctx->get_module());
+            }
+
+            std::stringstream ss;
+            p(ss, top, false, false);
+            os << ss.str();
+        }
+
+        return ok;
+    }
+
+    StreamCompiler::~StreamCompiler()
+    {
+        ctx->reset();
+        for (ASTGlobal* ast : resident)
+        {
+            delete ast;
+        }
     }
 }
@@ -3,36 +3,204 @@
 
 #include <cc.h>
 #include "context.h"
+#include "incremental.h"
+#include "declarations.h"
 
 namespace cc
 {
+    class PassManager;
+    class ThreadPool;
+
     constexpr int ERROR_CONTEXT_LINE_N = 3;
 
+    struct Diagnostic
+    {
+        enum severity_t
+        {
+            ERROR,
+            WARNING
+        };
+
+        severity_t severity;
+        std::string filename;
+        uint32_t line;
+        uint32_t column;    //!< 1-based
+        uint32_t length;
+        std::string message;
+    };
+
+    class Parser
+    {
+        /**
+         * Owns the parser tables and parsing buffers.
+         * These are expensive to build and may be shared
+         * by any number of sequential compilations.
+         */
+
+        void* buffers;
+
+    public:
+        Parser();
+        Parser(const Parser&) = delete;
+        Parser& operator=(const Parser&) = delete;
+
+        ASTGlobal* parse(Context* ctx, const char* input) const;
+
+        ~Parser();
+    };
+
+    /**
+     * Run the resolution pass on a single global
+     */
+    void resolve_global(Context* ctx, ASTGlobal* global);
+
     class Compiler
     {
         ASTGlobal* ast;
         std::string filename;
+        std::string source;
         std::vector<std::string> lines;
 
         Context* ctx;
+        const Parser* parser;
+        std::ostream& os;
+
+        std::vector<Diagnostic> diagnostics;
+        size_t reported_errors;
+        bool print_diagnostics;
 
-        void read(std::string& file_content);
+        struct FunctionIR
+        {
+            const ASTFunctionDefine* ast;
+            std::string fingerprint;
+            const std::string* cached;  //!< IR reused from the last compilation
+        };
+
+        IncrementalCache* incremental;
+        std::vector<FunctionIR> function_irs;
+        PassManager* passes;
+        bool emit_ir;
+
+        bool lazy;
+        std::vector<std::string> roots;
+        ThreadPool* pool;
 
         bool parse();
         bool resolve();
         bool ir();
-        bool put_errors() const;
+        bool put_errors();
 
     public:
-        explicit Compiler(std::string filename);
+        /**
+         * The context and parser are borrowed, the context will
+         * be reset when this compiler is destroyed so that it may be reused.
+         * All output and diagnostics are written to os.
+         * @param filename name of the input used in diagnostics
+         * @param source content of the input
+         */
+        Compiler(std::string filename, std::string source, Context* ctx,
+                 const Parser* parser, std::ostream& os);
 
         bool execute();
         void dump_ast() const;
 
+        /**
+         * Diagnostics are always collected, printing them
+         * to the output stream may be disabled
+         */
+        void set_print_diagnostics(bool print) { print_diagnostics = print; }
+
+        /**
+         * Only lower functions that changed since the last
+         * compilation recorded in the cache
+         */
+        void set_incremental(IncrementalCache* cache) { incremental = cache; }
+
+        /**
+         * Optimize the IR before it is printed
+         */
+        void set_passes(PassManager* manager) { passes = manager; }
+
+        /**
+         * Only lower the functions reachable from the roots through the
+         * call graph (see CallGraph), the others stay declarations
+         * @param roots_ function names, the default roots when empty
+         */
+        void set_lazy(bool lazy_, std::vector<std::string> roots_ = {})
+        {
+            lazy = lazy_;
+            roots = std::move(roots_);
+        }
+
+        /**
+         * Lower the function definitions and run their function passes
+         * on the threads of a pool, the output does not depend on the
+         * number of threads. Serial with nullptr (the default).
+         */
+        void set_pool(ThreadPool* pool_) { pool = pool_; }
+
+        /**
+         * Only print the IR, as textual IR (see write_ir())
+         */
+        void set_emit_ir(bool emit) { emit_ir = emit; }
+        const std::vector<Diagnostic>& get_diagnostics() const { return diagnostics; }
+
         ~Compiler();
 
         void dump_ir() const;
     };
+
+    class StreamCompiler
+    {
+        /**
+         * Compiles a translation unit one top-level declaration at a time.
+         *
+         * Every declaration is read, parsed, resolved, lowered and printed
+         * before the next one is read. Function definitions are freed
+         * (AST, scopes and blocks) once they are printed, only the module
+         * symbols, the types and the ASTs of other globals stay resident.
+         * Peak memory follows the largest function rather than the input.
+         *
+         * The output of each declaration (AST then IR) is printed as soon
+         * as it is lowered, the module constructor is printed last.
+         * Once an error is found nothing more is lowered or printed but the
+         * rest of the input is still parsed and resolved for diagnostics.
+         */
+
+        std::string filename;
+        std::istream& in;
+
+        Context* ctx;
+        const Parser* parser;
+        std::ostream& os;
+
+        std::vector<Diagnostic> diagnostics;
+        bool print_diagnostics;
+
+        std::vector<ASTGlobal*> resident;
+        PassManager* passes;
+
+        // Source lines preceding the current declaration
+        std::vector<std::string> previous_lines;
+        std::string partial_line;
+
+        bool put_errors(const Declaration& decl);
+        void advance(const Declaration& decl);
+
+    public:
+        StreamCompiler(std::string filename, std::istream& in, Context* ctx,
+                       const Parser* parser, std::ostream& os);
+        StreamCompiler(const StreamCompiler&) = delete;
+        StreamCompiler& operator=(const StreamCompiler&) = delete;
+
+        bool execute();
+
+        void set_print_diagnostics(bool print) { print_diagnostics = print; }
+        void set_passes(PassManager* manager) { passes = manager; }
+        const std::vector<Diagnostic>& get_diagnostics() const { return diagnostics; }
+
+        ~StreamCompiler();
+    };
 }
 
 #endif //CC_COMPILE_H
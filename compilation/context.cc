@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <sstream>
 #include "context.h"
 #include "instruction.h"
@@ -21,7 +22,7 @@ namespace cc
     Variable* Scope::get_variable(const std::string& name) const
     {
         // Keep travelling to outer scopes until we find the variable
-        for (const Scope* iter = this; iter; iter = iter->get_exit_scope())
+        for (const Scope* iter = this; iter; iter = iter->parent)
         {
             if (iter->variables.find(name) != iter->variables.end())
             {
@@ -32,6 +33,48 @@ namespace cc
         return nullptr;
     }
 
+    void Scope::remove_variable(const Variable* variable)
+    {
+        auto iter = variables.find(variable->get_decl()->name);
+        if (iter != variables.end() && iter->second == variable)
+        {
+            delete iter->second;
+            variables.erase(iter);
+        }
+    }
+
+    void Scope::remove_child(Scope* child)
+    {
+        assert(child->parent == this);
+
+        if (child->older_sibling)
+        {
+            child->older_sibling->younger_sibling = child->younger_sibling;
+        }
+        else
+        {
+            first_child = child->younger_sibling;
+        }
+
+        if (child->younger_sibling)
+        {
+            child->younger_sibling->older_sibling = child->older_sibling;
+        }
+        else
+        {
+            last_child = child->older_sibling;
+        }
+
+        if (last_entered == child)
+        {
+            last_entered = child->older_sibling;
+        }
+
+        // Siblings are owned by their older sibling
+        child->younger_sibling = nullptr;
+        delete child;
+    }
+
     Scope* Scope::add_child(const std::string& name_, Scope::scope_t type_)
     {
         auto* newborn = Scope::create(type_, ctx, name_, this, last_child);
@@ -63,20 +106,59 @@ namespace cc
     }
 
     Scope::Scope(Context* ctx, std::string name, Scope* parent, Scope* older_sibling) :
-        ctx(ctx), parent(parent), older_sibling(older_sibling),
-        first_child(nullptr), last_child(nullptr),
-        scope_name(std::move(name)), younger_sibling(nullptr),
-        exit(nullptr)
+        parent(parent), first_child(nullptr), last_child(nullptr),
+        younger_sibling(nullptr), older_sibling(older_sibling), last_entered(nullptr),
+        ctx(ctx), scope_name(std::move(name)), exit(nullptr), function(nullptr)
+    {
+    }
+
+    Scope* Scope::enter_next_child()
     {
+        last_entered = last_entered ? last_entered->younger_sibling : first_child;
+        return last_entered;
     }
 
     Block* Scope::new_block(const std::string& name)
     {
         auto* b = new Block(this, name);
         blocks.push_back(b);
+
+        Function* f = get_function();
+        if (f)
+        {
+            f->append_block(b);
+        }
         return b;
     }
 
+    void Scope::remove_block(Block* block)
+    {
+        auto iter = std::find(blocks.begin(), blocks.end(), block);
+        assert(iter != blocks.end());
+        assert(block->predecessors().empty() && "Removing a block that is still jumped to");
+
+        if (block->get_function())
+        {
+            block->get_function()->erase_block(block);
+        }
+
+        blocks.erase(iter);
+        delete block;
+    }
+
+    Function* Scope::get_function() const
+    {
+        for (const Scope* iter = this; iter; iter = iter->parent)
+        {
+            if (iter->function)
+            {
+                return iter->function;
+            }
+        }
+
+        return nullptr;
+    }
+
     Scope::~Scope()
     {
         delete first_child;
@@ -133,15 +215,14 @@ namespace cc
         return nullptr;
     }
 
-    static int loop_scope_counter = 0;
-    static int scope_count = 0;
     Scope::Scope(Context* ctx, Scope* parent, Scope* older_sibling) :
-    Scope(ctx, variadic_string("scope-%d", scope_count++), parent, older_sibling)
+    Scope(ctx, variadic_string("scope-%d", ctx->next_scope_id()), parent, older_sibling)
     {
     }
 
     LoopScope::LoopScope(Context* ctx, Scope* parent, Scope* older_sibling) :
-            Scope(ctx, variadic_string("loop-%d", loop_scope_counter++), parent, older_sibling)
+            Scope(ctx, variadic_string("loop-%d", ctx->next_loop_scope_id()), parent, older_sibling),
+            continue_target(nullptr)
     {
     }
 
@@ -177,11 +258,19 @@ namespace cc
 
         if (build_scope)
         {
+            // Scope names are numbered per function so that a
+            // function's IR does not depend on the functions before it
+            if (type == Scope::FUNCTION)
+            {
+                scope_count = 0;
+                loop_scope_count = 0;
+            }
+
             tail = tail->add_child(name, type);
         }
         else
         {
-            tail = tail->get_enter_scope();
+            tail = tail->enter_next_child();
             assert(tail && "Scope skeleton not built yet!");
         }
     }
@@ -192,9 +281,52 @@ namespace cc
         tail = tail->get_parent();
     }
 
-    Context::~Context()
+    void Context::clear()
     {
         delete module;
+        module = nullptr;
+
+        for (auto& iter : complex_types)
+        {
+            delete iter.second;
+        }
+        complex_types.clear();
+
+        for (size_t i = builtin_extra_types_n; i < extra_types.size(); i++)
+        {
+            delete extra_types[i];
+        }
+        extra_types.resize(builtin_extra_types_n);
+
+        errors.clear();
+        warnings.clear();
+    }
+
+    void Context::reset()
+    {
+        assert(!parent && "Borrowing contexts may not be reset");
+        clear();
+
+        scope_count = 0;
+        loop_scope_count = 0;
+
+        module = new Module(this);
+        head = module->scope();
+        tail = head;
+        function = nullptr;
+        ast_function = nullptr;
+        build_scope = false;
+    }
+
+    Context::~Context()
+    {
+        if (parent)
+        {
+            // Everything but the diagnostics is borrowed
+            return;
+        }
+
+        clear();
 
         /* Remove builtin AST types */
         delete primitives[Type::VOID];
@@ -207,14 +339,7 @@ namespace cc
         delete primitives[Type::F64];
         delete primitives[Type::PTR];
 
-        // Unsigned built-ins are cleared by extra types
-
-        for (auto& iter : complex_types)
-        {
-            delete iter.second;
-        }
-        complex_types.clear();
-
+        // Unsigned built-ins are owned by extra types
         for (auto* iter : extra_types)
         {
             delete iter;
@@ -222,9 +347,21 @@ namespace cc
         extra_types.clear();
     }
 
+    Context::Context(Context* parent) :
+    parent(parent), module(parent->module), function(nullptr), ast_function(nullptr),
+    head(parent->head), tail(parent->head), build_scope(false),
+    complex_types(parent->complex_types),
+    builtin_extra_types_n(0), scope_count(0), loop_scope_count(0)
+    {
+        std::copy(std::begin(parent->primitives), std::end(parent->primitives), std::begin(primitives));
+        std::copy(std::begin(parent->unsigned_primitives), std::end(parent->unsigned_primitives),
+                  std::begin(unsigned_primitives));
+    }
+
     Context::Context() :
-    module(new Module(this)), head(module->scope()),
-    tail(head), build_scope(false), function(nullptr)
+    parent(nullptr), module(nullptr), function(nullptr), ast_function(nullptr),
+    head(nullptr), tail(nullptr), build_scope(false),
+    builtin_extra_types_n(0), scope_count(0), loop_scope_count(0)
     {
         primitives[Type::CHAR] = new PrimitiveType<Type::CHAR>(this);
         primitives[Type::I8] = new PrimitiveType<Type::I8>(this);
@@ -240,6 +377,11 @@ namespace cc
         unsigned_primitives[Type::I16] = new QualType(this, QualType::UNSIGNED, primitives[Type::I16]);
         unsigned_primitives[Type::I32] = new QualType(this, QualType::UNSIGNED, primitives[Type::I32]);
         unsigned_primitives[Type::I64] = new QualType(this, QualType::UNSIGNED, primitives[Type::I64]);
+        builtin_extra_types_n = extra_types.size();
+
+        module = new Module(this);
+        head = module->scope();
+        tail = head;
     }
 
     const Type* Context::declare_structure(StructDecl* structure)
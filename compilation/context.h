@@ -77,10 +77,18 @@ namespace cc
         } scope_t;
 
         Scope* get_parent() const { return parent; }
+        Context* get_ctx() const { return ctx; }
 
         Variable* declare_variable(TypeDecl* decl);
         Variable* get_variable(const std::string& name) const;
 
+        /**
+         * Forget a variable declared directly in this scope
+         * @param variable variable to remove, nothing happens if it
+         *                 is not the variable declared under its name
+         */
+        void remove_variable(const Variable* variable);
+
         static Scope* create(scope_t type, Context* ctx,
                              const std::string& name = "",
                              Scope* parent = nullptr,
@@ -88,24 +96,45 @@ namespace cc
 
         Scope* add_child(const std::string& name, scope_t type_);
 
+        /**
+         * Unlink and delete a child scope and everything under it
+         */
+        void remove_child(Scope* child);
+
         virtual ~Scope();
 
-        Scope* get_enter_scope() const { return first_child ? first_child : younger_sibling; }
-        Scope* get_exit_scope() const { return older_sibling ? older_sibling : parent; }
+        /**
+         * Walk the skeleton in the order it was built:
+         * returns the child following the last one entered
+         */
+        Scope* enter_next_child();
 
         std::string get_lineage() const;
         Block* new_block(const std::string& name = "");
+
+        /**
+         * Delete a block of this scope, nothing may refer to it anymore
+         */
+        void remove_block(Block* block);
         Block* get_entry_block() const { return blocks.at(0); }
         uint32_t block_count() const { return blocks.size(); }
         const std::vector<Block*>& get_blocks() const { return blocks; }
         Scope* next() const { return younger_sibling; }
         Scope* child() const { return first_child; }
+        Scope* last() const { return last_child; }
 
         virtual LoopScope* get_loop();
 
         Block* get_exit();
         void set_exit(Block* block);
 
+        /**
+         * Function owning the blocks of this scope and its children,
+         * set on the function scope, nullptr for the module
+         */
+        Function* get_function() const;
+        void set_function(Function* f) { function = f; }
+
     protected:
         Scope(Context* ctx,
               std::string name,
@@ -122,24 +151,35 @@ namespace cc
         Scope* last_child;
         Scope* younger_sibling;
         Scope* older_sibling;
+        Scope* last_entered;
 
         Context* ctx;
         std::vector<Block*> blocks;
 
         std::string scope_name;
         Block* exit;
+        Function* function;
     };
 
     struct LoopScope : public Scope
     {
         LoopScope(Context* ctx, Scope* parent, Scope* older_sibling);
         LoopScope* get_loop() override { return this; }
+
+        // Target of continue, the increment of for loops
+        Block* get_continue() const { return continue_target; }
+        void set_continue(Block* block) { continue_target = block; }
+
+    private:
+        Block* continue_target;
     };
 
     class Context
     {
+        Context* parent;    //!< Owner of the module and types of a borrowing context
         Module* module;
         Function* function;
+        ASTFunctionDefine* ast_function;
         Scope* head;
         Scope* tail;
         bool build_scope;
@@ -152,9 +192,38 @@ namespace cc
         Type* primitives[Type::P_N]{nullptr};
         QualType* unsigned_primitives[Type::VOID]{nullptr};
         std::vector<Type*> extra_types;
+
+        // Number of extra types owned by the builtins (unsigned primitives)
+        // These survive reset()
+        size_t builtin_extra_types_n;
+
+        int scope_count;
+        int loop_scope_count;
+
+        void clear();
     public:
         Context();
 
+        /**
+         * Borrow the module, the types and the scopes of another context
+         * to lower a function on another thread. They are only read, the
+         * current scope and function and the diagnostics are its own.
+         * The parent must outlive this context.
+         */
+        explicit Context(Context* parent);
+        Context(const Context&) = delete;
+        Context& operator=(const Context&) = delete;
+
+        /**
+         * Drop everything built by the last compilation (module, symbols,
+         * scopes, user types and diagnostics) while keeping the builtin
+         * types alive so that the context may be reused.
+         */
+        void reset();
+
+        int next_scope_id() { return scope_count++; }
+        int next_loop_scope_id() { return loop_scope_count++; }
+
         void register_type(Type* type) { extra_types.push_back(type); }
         Variable* get_variable(const std::string& name) const;
         Variable* declare_variable(TypeDecl* decl);
@@ -166,9 +235,19 @@ namespace cc
         void set_function(Function* f) { function = f; }
         Function* get_function() { return function; }
 
+        // Function definition currently being resolved
+        void set_ast_function(ASTFunctionDefine* f) { ast_function = f; }
+        ASTFunctionDefine* get_ast_function() { return ast_function; }
+
         void enter_scope(Scope::scope_t type, const std::string &name = "");
         void exit_scope();
 
+        /**
+         * Enter a scope built earlier directly instead of walking to it,
+         * exit_scope() returns to its parent
+         */
+        void resume_scope(Scope* scope) { tail = scope; }
+
         template<Type::primitive_t T>
         const Type* type() const
         {
@@ -204,6 +283,7 @@ namespace cc
         const std::vector<ASTException>& get_errors() const { return errors; }
         const std::vector<ASTException>& get_warnings() const { return warnings; }
         void clear_warnings() { warnings.clear(); }
+        void clear_errors() { errors.clear(); }
 
         ~Context();
     };
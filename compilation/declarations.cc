@@ -0,0 +1,118 @@
+#include "declarations.h"
+#include <cctype>
+
+namespace cc
+{
+    bool Declaration::is_blank() const
+    {
+        for (size_t i = 0; i < text.size(); i++)
+        {
+            if (text[i] == '/' && i + 1 < text.size() && text[i + 1] == '/')
+            {
+                i = text.find('\n', i);
+                if (i == std::string::npos)
+                {
+                    return true;
+                }
+            }
+            else if (!isspace(static_cast<unsigned char>(text[i])))
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    bool DeclarationReader::next(Declaration& out)
+    {
+        enum
+        {
+            CODE,
+            COMMENT,
+            STRING,
+            ESCAPE
+        } state = CODE;
+
+        out.text.clear();
+        out.line = line;
+        out.col = col;
+
+        std::streambuf* buf = in.rdbuf();
+        int depth = 0;
+        bool function_body = false;
+        char quote = 0;
+        char last = 0;          // Last character outside of whitespace and comments
+
+        int c;
+        while ((c = buf->sbumpc()) != std::char_traits<char>::eof())
+        {
+            char ch = static_cast<char>(c);
+            out.text += ch;
+            if (ch == '\n')
+            {
+                line++;
+                col = 0;
+            }
+            else
+            {
+                col++;
+            }
+
+            switch (state)
+            {
+                case COMMENT:
+                    state = ch == '\n' ? CODE : COMMENT;
+                    continue;
+                case STRING:
+                    state = ch == '\\' ? ESCAPE : (ch == quote || ch == '\n') ? CODE : STRING;
+                    continue;
+                case ESCAPE:
+                    state = STRING;
+                    continue;
+                case CODE:
+                    break;
+            }
+
+            if (ch == '/' && buf->sgetc() == '/')
+            {
+                state = COMMENT;
+                continue;
+            }
+
+            if (isspace(static_cast<unsigned char>(ch)))
+            {
+                continue;
+            }
+
+            if (ch == '"' || ch == '\'')
+            {
+                state = STRING;
+                quote = ch;
+            }
+            else if (ch == '{')
+            {
+                // Structure bodies are followed by more of the declaration
+                if (depth++ == 0)
+                {
+                    function_body = last == ')';
+                }
+            }
+            else if (ch == '}')
+            {
+                if (depth > 0 && --depth == 0 && function_body)
+                {
+                    return true;
+                }
+            }
+            else if (ch == ';' && depth == 0)
+            {
+                return true;
+            }
+
+            last = ch;
+        }
+
+        return !out.text.empty();
+    }
+}
@@ -0,0 +1,51 @@
+#ifndef CC_DECLARATIONS_H
+#define CC_DECLARATIONS_H
+
+#include <cstdint>
+#include <istream>
+#include <string>
+
+namespace cc
+{
+    struct Declaration
+    {
+        std::string text;   //!< Leading whitespace and comments included
+        uint32_t line;      //!< 0-based line of the first character
+        uint32_t col;
+
+        Declaration() : line(0), col(0) {}
+
+        /**
+         * Only whitespace and comments, nothing to parse
+         */
+        bool is_blank() const;
+    };
+
+    class DeclarationReader
+    {
+        /**
+         * Splits a translation unit into its top-level declarations
+         * without parsing it. A declaration ends at a semicolon or at the
+         * closing brace of a function body outside of any braces.
+         *
+         * The input is consumed as the declarations are read so that
+         * only one declaration needs to be held in memory.
+         */
+
+        std::istream& in;
+        uint32_t line;
+        uint32_t col;
+
+    public:
+        explicit DeclarationReader(std::istream& in) : in(in), line(0), col(0) {}
+
+        /**
+         * @param out next declaration, the text after the last declaration
+         *            is returned as a final (usually blank) declaration
+         * @return false at the end of the input
+         */
+        bool next(Declaration& out);
+    };
+}
+
+#endif //CC_DECLARATIONS_H
@@ -0,0 +1,544 @@
+#include "driver.h"
+#include "cache.h"
+#include "incremental.h"
+#include <common/hash.h>
+#include <common/io.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <set>
+#include <sstream>
+
+namespace cc
+{
+    constexpr uint64_t DEFAULT_CACHE_SIZE = 1ULL << 30;
+
+    static void usage(const std::string& program, std::ostream& err)
+    {
+        err << "usage: " << program << " [OPTIONS] [INPUT].c...\n"
+            << "  --server [SOCKET]    serve compile requests on a unix socket\n"
+            << "  --cache-dir DIR      cache compilation results in DIR ($CC_CACHE_DIR)\n"
+            << "  --cache-size SIZE    cache size limit, K/M/G suffixes ($CC_CACHE_SIZE)\n"
+            << "  --no-cache           disable the compilation cache\n"
+            << "  --cache-stats        print cache statistics\n"
+            << "  --cache-clear        remove every cache entry\n"
+            << "  --incremental DIR    only lower functions that changed since the last build\n"
+            << "  --output-dir DIR     write the output of each input to DIR/INPUT.out\n"
+            << "  --no-io-uring        read and write files on a thread pool instead of io_uring\n"
+            << "  --stream             compile one declaration at a time with bounded memory\n"
+            << "  --emit-ir            print textual IR instead of the AST and IR dump\n"
+            << "  --lazy-ir            only lower functions reachable from main\n"
+            << "  --ir-roots F,G...    only lower functions reachable from F, G...\n"
+            << "  --threads N          lower and optimize functions on N threads, 0 for one per core\n"
+            << "  -O0 -O1 -O2 -Os      optimization level (-O0 by default)\n"
+            << "  -fPASS -fno-PASS     enable or disable a single optimization pass\n"
+            << "  --opt-fuel N         stop optimizing after N changes to the IR\n"
+            << "  --opt-budget N       skip expensive passes on functions after N units of work\n"
+            << "  --opt-stats          print the time spent in every pass\n"
+            << "With more than one input (or --output-dir) the output of each\n"
+            << "input is written to INPUT.out instead of stdout\n";
+    }
+
+    Options::Options() :
+            cache_size(DEFAULT_CACHE_SIZE),
+            cache_stats(false), cache_clear(false),
+            io_uring(true), stream(false), emit_ir(false), lazy_ir(false), threads(1)
+    {
+        const char* env_dir = getenv("CC_CACHE_DIR");
+        if (env_dir)
+        {
+            cache_dir = env_dir;
+        }
+
+        const char* env_size = getenv("CC_CACHE_SIZE");
+        if (env_size)
+        {
+            parse_size(env_size, cache_size);
+        }
+    }
+
+    bool Options::parse(const std::vector<std::string>& args, std::ostream& err)
+    {
+        for (size_t i = 0; i < args.size(); i++)
+        {
+            const std::string& arg = args[i];
+            bool has_value = i + 1 < args.size();
+
+            int used = optimization.parse_option(args, i, err);
+            if (used < 0)
+            {
+                return false;
+            }
+            else if (used)
+            {
+                i += used - 1;
+            }
+            else if (arg == "--cache-dir" && has_value)
+            {
+                cache_dir = args[++i];
+            }
+            else if (arg == "--cache-size" && has_value)
+            {
+                if (!parse_size(args[++i], cache_size))
+                {
+                    err << "Invalid cache size: " << args[i] << "\n";
+                    return false;
+                }
+            }
+            else if (arg == "--incremental" && has_value)
+            {
+                incremental_dir = args[++i];
+            }
+            else if (arg == "--output-dir" && has_value)
+            {
+                output_dir = args[++i];
+            }
+            else if (arg == "--no-io-uring")
+            {
+                io_uring = false;
+            }
+            else if (arg == "--stream")
+            {
+                stream = true;
+            }
+            else if (arg == "--emit-ir")
+            {
+                emit_ir = true;
+            }
+            else if (arg == "--lazy-ir")
+            {
+                lazy_ir = true;
+            }
+            else if (arg == "--ir-roots" && has_value)
+            {
+                lazy_ir = true;
+                ir_roots = split_string(args[++i], ',');
+            }
+            else if (arg == "--threads" && has_value)
+            {
+                uint64_t value;
+                if (!parse_size(args[++i], value) || value > 1024)
+                {
+                    err << "Invalid number of threads: " << args[i] << "\n";
+                    return false;
+                }
+                threads = static_cast<unsigned>(value);
+            }
+            else if (arg == "--no-cache")
+            {
+                cache_dir.clear();
+            }
+            else if (arg == "--cache-stats")
+            {
+                cache_stats = true;
+            }
+            else if (arg == "--cache-clear")
+            {
+                cache_clear = true;
+            }
+            else if (arg.size() > 1 && arg[0] == '-')
+            {
+                err << "Unknown option: " << arg << "\n";
+                return false;
+            }
+            else
+            {
+                inputs.push_back(arg);
+            }
+        }
+
+        return true;
+    }
+
+    std::string Options::output_flags() const
+    {
+        // Streaming changes the order of the output
+        std::string out = std::string(stream ? "stream;" : "") + (emit_ir ? "emit-ir;" : "");
+        if (lazy_ir)
+        {
+            out += "lazy-ir";
+            for (size_t i = 0; i < ir_roots.size(); i++)
+            {
+                out += (i ? "," : "=") + ir_roots[i];
+            }
+            out += ";";
+        }
+
+        return out + optimization.flags();
+    }
+
+    std::string Options::path(const std::string& name) const
+    {
+        if (cwd.empty() || name.empty() || name[0] == '/')
+        {
+            return name;
+        }
+
+        return cwd + "/" + name;
+    }
+
+    static bool read_file(const std::string& filename, std::string& str)
+    {
+        std::ifstream t(filename, std::ios::binary);
+        if (!t.is_open())
+        {
+            return false;
+        }
+
+        t.seekg(0, std::ios::end);
+        str.reserve(t.tellg());
+        t.seekg(0, std::ios::beg);
+
+        str.assign((std::istreambuf_iterator<char>(t)),
+                   std::istreambuf_iterator<char>());
+        return true;
+    }
+
+    static std::string incremental_path(const Options& options, const std::string& filename)
+    {
+        std::string path = options.path(filename);
+        char* real = realpath(path.c_str(), nullptr);
+        std::string key = real ? real : path;
+        free(real);
+
+        return options.path(options.incremental_dir) + "/" + to_hex(xxhash64(key)) + ".inc";
+    }
+
+    ThreadPool* Driver::get_pool(unsigned threads)
+    {
+        if (threads == 0)
+        {
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+
+        if (threads == 1)
+        {
+            return nullptr;
+        }
+
+        if (!pool || pool->size() != threads)
+        {
+            pool.reset();
+            pool = std::make_unique<ThreadPool>(threads);
+        }
+
+        return pool.get();
+    }
+
+    int Driver::compile(const Options& options, const std::string& filename,
+                        const std::string& source,
+                        std::ostream& out, std::ostream& err)
+    {
+        try
+        {
+            std::unique_ptr<IncrementalCache> incremental;
+            if (!options.incremental_dir.empty())
+            {
+                make_directories(options.path(options.incremental_dir));
+                incremental = std::make_unique<IncrementalCache>(
+                        incremental_path(options, filename),
+                        std::string(CC_VERSION) + '\0' + options.output_flags());
+            }
+
+            PassManager passes(options.optimization);
+            Compiler compiler(filename, source, &ctx, &parser, out);
+            compiler.set_incremental(incremental.get());
+            compiler.set_passes(passes.empty() ? nullptr : &passes);
+            compiler.set_emit_ir(options.emit_ir);
+            compiler.set_lazy(options.lazy_ir, options.ir_roots);
+            compiler.set_pool(get_pool(options.threads));
+            bool ok = compiler.execute();
+
+            if (options.optimization.stats)
+            {
+                passes.print_statistics(err);
+            }
+
+            if (not ok)
+            {
+                err << "Compiler execution failed\n";
+                return 2;
+            }
+
+            if (incremental && !incremental->save())
+            {
+                err << "warning: failed to save incremental state for " << filename << "\n";
+            }
+        }
+        catch (std::exception& e)
+        {
+            err << "error: " << e.what() << "\n";
+            err << "Compiler execution failed\n";
+            return 2;
+        }
+
+        return 0;
+    }
+
+    int Driver::compile_stream(const Options& options,
+                               const std::string& filename, std::istream& in,
+                               std::ostream& out, std::ostream& err)
+    {
+        try
+        {
+            PassManager passes(options.optimization);
+            StreamCompiler compiler(filename, in, &ctx, &parser, out);
+            compiler.set_passes(passes.empty() ? nullptr : &passes);
+            bool ok = compiler.execute();
+
+            if (options.optimization.stats)
+            {
+                passes.print_statistics(err);
+            }
+
+            if (not ok)
+            {
+                err << "Compiler execution failed\n";
+                return 2;
+            }
+        }
+        catch (std::exception& e)
+        {
+            err << "error: " << e.what() << "\n";
+            err << "Compiler execution failed\n";
+            return 2;
+        }
+
+        return 0;
+    }
+
+    int Driver::compile_cached(const Options& options, Cache* cache,
+                               const std::string& filename, const std::string& source,
+                               std::ostream& out, std::ostream& err)
+    {
+        // Pass timings change from one run to the next
+        if (!cache || options.optimization.stats)
+        {
+            return compile(options, filename, source, out, err);
+        }
+
+        // The filename is part of the diagnostics
+        std::string key = Cache::get_key(options.output_flags() + '\0' + filename, source);
+
+        Cache::Entry entry;
+        if (!cache->lookup(key, entry))
+        {
+            std::stringstream c_out;
+            std::stringstream c_err;
+            entry.exit_code = compile(options, filename, source, c_out, c_err);
+            entry.out = c_out.str();
+            entry.err = c_err.str();
+            cache->store(key, entry);
+        }
+
+        out << entry.out;
+        err << entry.err;
+        return (int) entry.exit_code;
+    }
+
+    static std::string output_path(const Options& options, const std::string& filename)
+    {
+        if (options.output_dir.empty())
+        {
+            return options.path(filename) + ".out";
+        }
+
+        size_t slash = filename.rfind('/');
+        return options.path(options.output_dir) + "/"
+               + (slash == std::string::npos ? filename : filename.substr(slash + 1))
+               + ".out";
+    }
+
+    int Driver::compile_all(const Options& options, Cache* cache, std::ostream& err)
+    {
+        std::vector<std::string> outputs;
+        std::set<std::string> unique_outputs;
+        for (const std::string& filename : options.inputs)
+        {
+            outputs.push_back(output_path(options, filename));
+            if (!unique_outputs.insert(outputs.back()).second)
+            {
+                err << "error: Multiple inputs write to " << outputs.back() << "\n";
+                return 1;
+            }
+        }
+
+        if (!options.output_dir.empty())
+        {
+            try
+            {
+                make_directories(options.path(options.output_dir));
+            }
+            catch (Exception& e)
+            {
+                err << "error: " << e.what() << "\n";
+                return 1;
+            }
+        }
+
+        std::unique_ptr<BatchIO> io = BatchIO::create(64, options.io_uring);
+
+        // Reads are queued first, their ids are the input indices
+        for (const std::string& filename : options.inputs)
+        {
+            io->read(options.path(filename));
+        }
+
+        std::vector<size_t> write_input;
+        int status = 0;
+
+        BatchIO::Completion completion;
+        while (io->wait(completion))
+        {
+            if (!completion.is_read)
+            {
+                size_t input = write_input[completion.id - options.inputs.size()];
+                if (completion.error)
+                {
+                    err << "error: Failed to write " << outputs[input]
+                        << ": " << strerror(completion.error) << "\n";
+                    status = std::max(status, 2);
+                }
+                continue;
+            }
+
+            const std::string& filename = options.inputs[completion.id];
+            if (completion.error)
+            {
+                err << "error: Failed to open file: " << filename << "\n";
+                err << "Compiler execution failed\n";
+                status = std::max(status, 2);
+                continue;
+            }
+
+            std::stringstream c_out;
+            std::stringstream c_err;
+            if (options.stream)
+            {
+                std::istringstream in(completion.data);
+                status = std::max(status, compile_stream(options, filename, in, c_out, c_err));
+            }
+            else
+            {
+                status = std::max(status, compile_cached(options, cache, filename, completion.data,
+                                                         c_out, c_err));
+            }
+            err << c_err.str();
+
+            io->write(outputs[completion.id], c_out.str());
+            write_input.push_back(completion.id);
+        }
+
+        return status;
+    }
+
+    int Driver::run(const std::string& program,
+                    const std::vector<std::string>& args,
+                    std::ostream& out, std::ostream& err,
+                    const std::string& cwd)
+    {
+        Options options;
+        options.cwd = cwd;
+        if (!options.parse(args, err))
+        {
+            usage(program, err);
+            return 1;
+        }
+
+        // Both print the IR one function at a time in their own format
+        if (options.emit_ir && (options.stream || !options.incremental_dir.empty()))
+        {
+            err << "--emit-ir may not be used with --stream or --incremental\n";
+            return 1;
+        }
+
+        // Whether a function is lowered depends on the rest of the input
+        if (options.lazy_ir && (options.stream || !options.incremental_dir.empty()))
+        {
+            err << "--lazy-ir may not be used with --stream or --incremental\n";
+            return 1;
+        }
+
+        std::unique_ptr<Cache> cache;
+        if (!options.cache_dir.empty())
+        {
+            try
+            {
+                cache = std::make_unique<Cache>(options.path(options.cache_dir), options.cache_size);
+            }
+            catch (Exception& e)
+            {
+                err << "warning: " << e.what() << ", caching disabled\n";
+            }
+        }
+
+        if (options.cache_stats || options.cache_clear)
+        {
+            if (!cache)
+            {
+                err << "No cache directory configured\n";
+                return 1;
+            }
+
+            if (options.cache_clear)
+            {
+                cache->clear();
+            }
+
+            if (options.cache_stats)
+            {
+                Cache::Statistics stats = cache->get_statistics();
+                uint64_t lookups = stats.hits + stats.misses;
+                out << "cache directory: " << options.cache_dir << "\n"
+                    << "hits:            " << stats.hits << "\n"
+                    << "misses:          " << stats.misses << "\n"
+                    << "hit rate:        "
+                    << (lookups ? variadic_string("%.2f%%", 100.0 * stats.hits / lookups) : "-") << "\n"
+                    << "entries:         " << stats.entries << "\n"
+                    << "size:            " << stats.size << " / " << options.cache_size << " bytes\n";
+            }
+
+            if (options.inputs.empty())
+            {
+                return 0;
+            }
+        }
+
+        if (options.inputs.empty())
+        {
+            usage(program, err);
+            return 1;
+        }
+
+        if (options.inputs.size() > 1 || !options.output_dir.empty())
+        {
+            return compile_all(options, cache.get(), err);
+        }
+
+        const std::string& filename = options.inputs[0];
+        if (options.stream)
+        {
+            std::ifstream in(options.path(filename), std::ios::binary);
+            if (!in.is_open())
+            {
+                err << "error: Failed to open file: " << filename << "\n";
+                err << "Compiler execution failed\n";
+                return 2;
+            }
+
+            return compile_stream(options, filename, in, out, err);
+        }
+
+        std::string source;
+        if (!read_file(options.path(filename), source))
+        {
+            err << "error: Failed to open file: " << filename << "\n";
+            err << "Compiler execution failed\n";
+            return 2;
+        }
+
+        return compile_cached(options, cache.get(), filename, source, out, err);
+    }
+}
@@ -0,0 +1,134 @@
+#ifndef CC_DRIVER_H
+#define CC_DRIVER_H
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "compile.h"
+#include <common/thread_pool.h>
+#include <opt/pass_manager.h>
+
+namespace cc
+{
+    class Cache;
+
+    struct Options
+    {
+        std::vector<std::string> inputs;
+
+        std::string cache_dir;
+        uint64_t cache_size;
+        bool cache_stats;
+        bool cache_clear;
+
+        std::string incremental_dir;
+
+        std::string output_dir;     //!< Outputs of multi-input builds
+        bool io_uring;
+
+        bool stream;                //!< See StreamCompiler
+        bool emit_ir;               //!< Textual IR only, see write_ir()
+
+        bool lazy_ir;               //!< Only lower reachable functions
+        std::vector<std::string> ir_roots;
+
+        unsigned threads;           //!< Lowering threads, 0 for one per core
+
+        PassOptions optimization;
+
+        std::string cwd;            //!< Relative paths start here, the process' directory when empty
+
+        Options();
+
+        /**
+         * Parse the command line arguments following argv[0]
+         * @param args arguments to parse
+         * @param err error messages for invalid arguments
+         * @return false if the arguments are invalid
+         */
+        bool parse(const std::vector<std::string>& args, std::ostream& err);
+
+        /**
+         * Canonical representation of every option that may change
+         * the output of a compilation. Used as part of the cache key.
+         */
+        std::string output_flags() const;
+
+        /**
+         * Path of a file named on the command line, resolved
+         * against cwd so that nothing depends on the directory
+         * of the process serving the invocation
+         */
+        std::string path(const std::string& name) const;
+    };
+
+    class Driver
+    {
+        /**
+         * Runs compiler invocations from the command line arguments.
+         * The parser tables and the builtin types are kept warm
+         * between invocations so a single driver may serve many
+         * compilations (see Server).
+         */
+
+        Parser parser;
+        Context ctx;
+        std::unique_ptr<ThreadPool> pool;
+
+        /**
+         * Pool of the lowering threads, kept between invocations
+         * @return nullptr for a single thread
+         */
+        ThreadPool* get_pool(unsigned threads);
+
+        int compile(const Options& options, const std::string& filename,
+                    const std::string& source,
+                    std::ostream& out, std::ostream& err);
+
+        /**
+         * Compile one declaration at a time, the input is never held
+         * in memory as a whole and neither the cache nor the incremental
+         * state are used
+         */
+        int compile_stream(const Options& options,
+                           const std::string& filename, std::istream& in,
+                           std::ostream& out, std::ostream& err);
+
+        /**
+         * Compile through the cache when there is one
+         */
+        int compile_cached(const Options& options, Cache* cache,
+                           const std::string& filename, const std::string& source,
+                           std::ostream& out, std::ostream& err);
+
+        /**
+         * Compile every input, each to its own output file.
+         * All inputs are read in one batch and each one is compiled
+         * as soon as its read completes, outputs are written back
+         * while the next inputs are compiled.
+         */
+        int compile_all(const Options& options, Cache* cache,
+                        std::ostream& err);
+
+    public:
+        Driver() = default;
+
+        /**
+         * Run a single invocation
+         * @param program argv[0] of the invocation
+         * @param args arguments following argv[0]
+         * @param out compiler output and diagnostics
+         * @param err driver messages
+         * @param cwd working directory of the invocation, the
+         *            directory of the process when empty
+         * @return process exit code
+         */
+        int run(const std::string& program,
+                const std::vector<std::string>& args,
+                std::ostream& out, std::ostream& err,
+                const std::string& cwd = "");
+    };
+}
+
+#endif //CC_DRIVER_H
@@ -0,0 +1,188 @@
+#include "incremental.h"
+#include "context.h"
+#include "module.h"
+#include <common/hash.h>
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <unistd.h>
+
+namespace cc
+{
+    static const char RECORD_MAGIC[4] = {'C', 'C', 'I', '1'};
+
+    static void put_string(std::ostream& os, const std::string& s)
+    {
+        auto n = static_cast<uint32_t>(s.size());
+        os.write(reinterpret_cast<const char*>(&n), sizeof(n));
+        os.write(s.data(), s.size());
+    }
+
+    static bool get_string(std::istream& is, std::string& s)
+    {
+        uint32_t n;
+        if (!is.read(reinterpret_cast<char*>(&n), sizeof(n)))
+        {
+            return false;
+        }
+
+        s.resize(n);
+        return n == 0 || static_cast<bool>(is.read(&s[0], n));
+    }
+
+    static std::string type_string(const Type* type)
+    {
+        if (!type)
+        {
+            return "?";
+        }
+
+        try
+        {
+            return type->as_string();
+        }
+        catch (Exception&)
+        {
+            // Not every qualified type is printable
+            return "?";
+        }
+    }
+
+    IncrementalCache::IncrementalCache(std::string path, std::string salt) :
+            path(std::move(path)), salt(std::move(salt)),
+            reused_n(0), rebuilt_n(0)
+    {
+        load();
+    }
+
+    void IncrementalCache::load()
+    {
+        std::ifstream is(path, std::ios::binary);
+        char magic[sizeof(RECORD_MAGIC)];
+        uint32_t n;
+
+        if (!is.is_open()
+            || !is.read(magic, sizeof(magic))
+            || memcmp(magic, RECORD_MAGIC, sizeof(magic)) != 0
+            || !is.read(reinterpret_cast<char*>(&n), sizeof(n)))
+        {
+            return;
+        }
+
+        for (uint32_t i = 0; i < n; i++)
+        {
+            std::string name;
+            Record record;
+            if (!get_string(is, name)
+                || !get_string(is, record.fingerprint)
+                || !get_string(is, record.ir))
+            {
+                // Corrupt store, rebuild everything
+                records.clear();
+                return;
+            }
+
+            records[name] = std::move(record);
+        }
+    }
+
+    std::string IncrementalCache::fingerprint(const ASTFunctionDefine* function, Context* ctx,
+                                              const std::vector<std::string>& lines) const
+    {
+        std::string content = salt;
+        content += '\0';
+
+        // Positions are 1-based
+        for (uint32_t i = function->line; i <= function->end_position.line; i++)
+        {
+            if (i >= 1 && i <= lines.size())
+            {
+                content += lines[i - 1];
+            }
+            content += '\n';
+        }
+
+        for (const auto& callee : function->callees)
+        {
+            content += '\0' + callee + ':';
+            const Function* f = ctx->get_module()->get_function(callee);
+            if (!f)
+            {
+                content += "undeclared";
+                continue;
+            }
+
+            content += type_string(f->get_return_type()) + "(";
+            for (const Type* arg : f->get_signature())
+            {
+                content += type_string(arg) + ",";
+            }
+            content += ")";
+        }
+
+        for (const auto& global : function->globals)
+        {
+            const Variable* v = ctx->get_module()->scope()->get_variable(global);
+            content += '\0' + global + ':' + type_string(v ? v->get_decl()->type : nullptr);
+        }
+
+        return content_digest(content);
+    }
+
+    const std::string* IncrementalCache::lookup(const std::string& name, const std::string& fingerprint)
+    {
+        auto iter = records.find(name);
+        if (iter == records.end() || iter->second.fingerprint != fingerprint)
+        {
+            rebuilt_n++;
+            return nullptr;
+        }
+
+        reused_n++;
+        return &iter->second.ir;
+    }
+
+    void IncrementalCache::record(const std::string& name, const std::string& fingerprint,
+                                  const std::string& ir)
+    {
+        updated[name] = {fingerprint, ir};
+    }
+
+    bool IncrementalCache::save() const
+    {
+        std::string tmp_path = variadic_string("%s.tmp.%d", path.c_str(), (int) getpid());
+        {
+            std::ofstream os(tmp_path, std::ios::binary | std::ios::trunc);
+            if (!os.is_open())
+            {
+                return false;
+            }
+
+            auto n = static_cast<uint32_t>(updated.size());
+            os.write(RECORD_MAGIC, sizeof(RECORD_MAGIC));
+            os.write(reinterpret_cast<const char*>(&n), sizeof(n));
+            for (const auto& iter : updated)
+            {
+                put_string(os, iter.first);
+                put_string(os, iter.second.fingerprint);
+                put_string(os, iter.second.ir);
+            }
+
+            if (!os.good())
+            {
+                os.close();
+                unlink(tmp_path.c_str());
+                return false;
+            }
+        }
+
+        if (rename(tmp_path.c_str(), path.c_str()) != 0)
+        {
+            unlink(tmp_path.c_str());
+            return false;
+        }
+
+        return true;
+    }
+}
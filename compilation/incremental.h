@@ -0,0 +1,70 @@
+#ifndef CC_INCREMENTAL_H
+#define CC_INCREMENTAL_H
+
+#include <cc.h>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace cc
+{
+    class IncrementalCache
+    {
+        /**
+         * Stores the IR of every function definition of a single input
+         * alongside a fingerprint of the function. The fingerprint covers
+         * the function's source text and the signatures of everything it
+         * references outside of its own body (callees and globals).
+         *
+         * Functions whose fingerprint did not change since the last
+         * successful compilation do not need to be lowered again,
+         * their stored IR is reused instead.
+         */
+
+        struct Record
+        {
+            std::string fingerprint;
+            std::string ir;
+        };
+
+        std::string path;
+        std::string salt;
+
+        std::map<std::string, Record> records;  //!< Loaded from the last compilation
+        std::map<std::string, Record> updated;  //!< Built by this compilation
+
+        uint32_t reused_n;
+        uint32_t rebuilt_n;
+
+        void load();
+
+    public:
+        /**
+         * @param path file holding the records of an input
+         * @param salt anything else that changes the generated IR
+         *             (compiler version, flags)
+         */
+        IncrementalCache(std::string path, std::string salt);
+
+        std::string fingerprint(const ASTFunctionDefine* function, Context* ctx,
+                                const std::vector<std::string>& lines) const;
+
+        /**
+         * Find the IR of a function built with the same fingerprint
+         * @return nullptr if the function needs to be rebuilt
+         */
+        const std::string* lookup(const std::string& name, const std::string& fingerprint);
+        void record(const std::string& name, const std::string& fingerprint, const std::string& ir);
+
+        /**
+         * Replace the stored records with the ones recorded
+         * during this compilation
+         */
+        bool save() const;
+
+        uint32_t reused() const { return reused_n; }
+        uint32_t rebuilt() const { return rebuilt_n; }
+    };
+}
+
+#endif //CC_INCREMENTAL_H
@@ -1,16 +1,28 @@
 
 #include <cc.h>
+#include <algorithm>
 #include <cstring>
 
 #include "instruction.h"
 #include "context.h"
 #include "module.h"
+#include <opt/folder.h>
 
 namespace cc
 {
+    static const IR* load(Context* ctx, IRBuilder &IRB, const Reference* address)
+    {
+        const Type* type = address->get_type(ctx);
+        return IRB.add<LoadInstr>(address, type, type->get_alignment());
+    }
+
+    static void store(Context* ctx, IRBuilder &IRB, const Reference* address, const IR* value)
+    {
+        IRB.add<StoreInstr>(address, value, address->get_type(ctx)->get_alignment());
+    }
+
     void ForLoop::add(Context* ctx, IRBuilder &IRB) const
     {
-        Block* parent_block = IRB.get_insertion_point();
         Scope* parent_scope = ctx->scope();
         ctx->enter_scope(Scope::LOOP);
         auto* loop_scope = dynamic_cast<LoopScope*>(ctx->scope());
@@ -18,28 +30,33 @@ namespace cc
 
         // Add the initial instructions to the parent block
         // we don't want to execute these multiple times
-        IRB.set_insertion_point(parent_block);
         initial->add(ctx, IRB);
 
+        // The condition, the body and the increment
+        // continue is a jump to the increment
+        Block* loop_block = loop_scope->new_block("loop");
+        Block* body_block = loop_scope->new_block("body");
+        Block* step_block = loop_scope->new_block("step");
+
         // Preemptively create a block that will be jumped
         // to on break or condition failure
         Block* post_block = parent_scope->new_block();
 
-        // Create the block to loop over
-        Block* loop_block = loop_scope->new_block("loop");
-
-        // Set up the for loop execution order
-        parent_block->chain(loop_block);
         loop_scope->set_exit(post_block);
+        loop_scope->set_continue(step_block);
+        IRB.fall_through(loop_block);
 
         // Add the conditional instructions
         IRB.set_insertion_point(loop_block);
-        IRB.add<BranchInstr>(post_block, IRB.add<L_NotInstr>(conditional->get(ctx, IRB)));
+        IRB.add<BranchInstr>(conditional->get(ctx, IRB), body_block, post_block);
 
         // Insert the looping instructions into the body block
+        IRB.set_insertion_point(body_block);
         body->add(ctx, IRB);
+        IRB.fall_through(step_block);
 
         // Add the iteration instructions
+        IRB.set_insertion_point(step_block);
         increment->get(ctx, IRB);
         IRB.add<JumpInstr>(loop_block);
 
@@ -50,29 +67,31 @@ namespace cc
 
     void WhileLoop::add(Context* ctx, IRBuilder &IRB) const
     {
-        Block* parent_block = IRB.get_insertion_point();
         Scope* parent_scope = ctx->scope();
         ctx->enter_scope(Scope::LOOP);
         auto* loop_scope = dynamic_cast<LoopScope*>(ctx->scope());
         assert(loop_scope);
 
+        // The condition followed by the body
+        Block* loop_block = loop_scope->new_block("loop");
+        Block* body_block = loop_scope->new_block("body");
+
         // Preemptively create a block that will be jumped
         // to on break or condition failure
         Block* post_block = parent_scope->new_block();
 
-        // Create the block to loop over
-        Block* loop_block = loop_scope->new_block("loop");
-
-        // Set up the for loop execution order
-        parent_block->chain(loop_block);
         loop_scope->set_exit(post_block);
+        loop_scope->set_continue(loop_block);
+        IRB.fall_through(loop_block);
 
         // Add the conditional instructions
         IRB.set_insertion_point(loop_block);
-        IRB.add<BranchInstr>(post_block, IRB.add<L_NotInstr>(conditional->get(ctx, IRB)));
+        IRB.add<BranchInstr>(conditional->get(ctx, IRB), body_block, post_block);
 
         // Loop
-        IRB.add<JumpInstr>(loop_block);
+        IRB.set_insertion_point(body_block);
+        body->add(ctx, IRB);
+        IRB.fall_through(loop_block);
 
         // Get the context read for the next instruction
         IRB.set_insertion_point(post_block);
@@ -89,7 +108,7 @@ namespace cc
         ctx->exit_scope();
     }
 
-    void Decl::add(Context* ctx, IRBuilder &IRB) const
+    void Decl::add(Context*, IRBuilder &IRB) const
     {
         assert(decl->variable);
         decl->variable->set(IRB.add<AllocaInstr>(decl->variable));
@@ -98,7 +117,7 @@ namespace cc
     void DeclInit::add(Context* ctx, IRBuilder &IRB) const
     {
         Decl::add(ctx, IRB);
-        IRB.add<MovInstr>(decl->variable->get(), initializer->get(ctx, IRB));
+        store(ctx, IRB, decl->variable->get(), initializer->get(ctx, IRB));
     }
 
     void Eval::add(Context* ctx, IRBuilder &IRB) const
@@ -109,42 +128,23 @@ namespace cc
 
     void If::add(Context* ctx, IRBuilder &IRB) const
     {
-        Block* parent_block = IRB.get_insertion_point();
         Block* then_block = ctx->scope()->new_block("then");
-        IRB.add<BranchInstr>(then_block, clause->get(ctx, IRB));
-        Block* curr_exit = ctx->scope()->get_exit();
+        Block* else_block = else_stmt ? ctx->scope()->new_block("else") : nullptr;
+        Block* post_block = ctx->scope()->new_block();
 
-        Block* post_block;
-        if (curr_exit)
-        {
-            post_block = curr_exit;
-        }
-        else
-        {
-            post_block = ctx->scope()->new_block();
-            ctx->scope()->set_exit(post_block);
-        }
+        IRB.add<BranchInstr>(clause->get(ctx, IRB), then_block, else_block ? else_block : post_block);
 
-        then_block->chain(post_block);
+        IRB.set_insertion_point(then_block);
+        then_stmt->add(ctx, IRB);
+        IRB.fall_through(post_block);
 
         if (else_stmt)
         {
-            Block* else_block = ctx->scope()->new_block("else");
-            else_block->chain(post_block);
-            parent_block->chain(else_block, true);
-
             IRB.set_insertion_point(else_block);
             else_stmt->add(ctx, IRB);
-        }
-        else
-        {
-            parent_block->chain(post_block, true);
+            IRB.fall_through(post_block);
         }
 
-        IRB.set_insertion_point(then_block);
-        then_stmt->add(ctx, IRB);
-
-        ctx->scope()->set_exit(curr_exit);
         IRB.set_insertion_point(post_block);
     }
 
@@ -157,7 +157,7 @@ namespace cc
             return;
         }
 
-        IRB.add<JumpInstr>(parent_loop->get_entry_block());
+        IRB.add<JumpInstr>(parent_loop->get_continue());
     }
 
     void Break::add(Context* ctx, IRBuilder &IRB) const
@@ -190,35 +190,37 @@ namespace cc
 
     const IR* BinaryExpr::get(Context* ctx, IRBuilder &IRB) const
     {
+        // Operands are read left to right
+        const IR* a_ir = a->get(ctx, IRB);
+        const IR* b_ir = b->get(ctx, IRB);
+
         switch (op)
         {
-            case A_ADD: return IRB.add<AddInstr>(a->get(ctx, IRB), b->get(ctx, IRB));
-            case A_SUB: return IRB.add<SubInstr>(a->get(ctx, IRB), b->get(ctx, IRB));
-            case A_DIV: return IRB.add<DivInstr>(a->get(ctx, IRB), b->get(ctx, IRB));
-            case A_MUL: return IRB.add<MulInstr>(a->get(ctx, IRB), b->get(ctx, IRB));
-            case B_AND: return IRB.add<B_AndInstr>(a->get(ctx, IRB), b->get(ctx, IRB));
-            case B_OR: return IRB.add<B_OrInstr>(a->get(ctx, IRB), b->get(ctx, IRB));
-            case B_XOR: return IRB.add<B_XorInstr>(a->get(ctx, IRB), b->get(ctx, IRB));
-            case L_LT: return IRB.add<LTInstr>(a->get(ctx, IRB), b->get(ctx, IRB));
-            case L_GT: return IRB.add<GTInstr>(a->get(ctx, IRB), b->get(ctx, IRB));
-            case L_LE: return IRB.add<LEInstr>(a->get(ctx, IRB), b->get(ctx, IRB));
-            case L_GE: return IRB.add<GEInstr>(a->get(ctx, IRB), b->get(ctx, IRB));
-            case L_EQ: return IRB.add<EQInstr>(a->get(ctx, IRB), b->get(ctx, IRB));
-            case L_AND: return IRB.add<L_AndInstr>(a->get(ctx, IRB), b->get(ctx, IRB));
-            case L_OR: return IRB.add<L_OrInstr>(a->get(ctx, IRB), b->get(ctx, IRB));
-            case S_LEFT: IRB.add<L_SLInstr>(a->get(ctx, IRB), b->get(ctx, IRB));
+            case A_ADD: return IRB.add_value<AddInstr>(a_ir, b_ir);
+            case A_SUB: return IRB.add_value<SubInstr>(a_ir, b_ir);
+            case A_DIV: return IRB.add_value<DivInstr>(a_ir, b_ir);
+            case A_MUL: return IRB.add_value<MulInstr>(a_ir, b_ir);
+            case B_AND: return IRB.add_value<B_AndInstr>(a_ir, b_ir);
+            case B_OR: return IRB.add_value<B_OrInstr>(a_ir, b_ir);
+            case B_XOR: return IRB.add_value<B_XorInstr>(a_ir, b_ir);
+            case L_LT: return IRB.add_value<LTInstr>(a_ir, b_ir);
+            case L_GT: return IRB.add_value<GTInstr>(a_ir, b_ir);
+            case L_LE: return IRB.add_value<LEInstr>(a_ir, b_ir);
+            case L_GE: return IRB.add_value<GEInstr>(a_ir, b_ir);
+            case L_EQ: return IRB.add_value<EQInstr>(a_ir, b_ir);
+            case L_AND: return IRB.add_value<L_AndInstr>(a_ir, b_ir);
+            case L_OR: return IRB.add_value<L_OrInstr>(a_ir, b_ir);
+            case S_LEFT: return IRB.add_value<L_SLInstr>(a_ir, b_ir);
             case S_RIGHT:
             {
-                const IR* a_ir = a->get(ctx, IRB);
-                const IR* b_ir = b->get(ctx, IRB);
                 const auto* qual_type = dynamic_cast<const QualType*>(a_ir->get_type(ctx));
                 if (qual_type && qual_type->is_unsigned())
                 {
-                    return IRB.add<L_SRInstr>(a_ir, b_ir);
+                    return IRB.add_value<L_SRInstr>(a_ir, b_ir);
                 }
                 else
                 {
-                    return IRB.add<A_SRInstr>(a_ir, b_ir);
+                    return IRB.add_value<A_SRInstr>(a_ir, b_ir);
                 }
             }
         }
@@ -231,21 +233,34 @@ namespace cc
     {
         switch (op)
         {
-            case B_NOT: return IRB.add<B_NotInstr>(operand->get(ctx, IRB));
-            case L_NOT: return IRB.add<L_NotInstr>(operand->get(ctx, IRB));
-            case INC_PRE: return IRB.add<IncInstr>(operand->get(ctx, IRB));
-            case DEC_PRE: return IRB.add<DecInstr>(operand->get(ctx, IRB));
+            case B_NOT: return IRB.add_value<B_NotInstr>(operand->get(ctx, IRB));
+            case L_NOT: return IRB.add_value<L_NotInstr>(operand->get(ctx, IRB));
+            case INC_PRE:
+            case DEC_PRE:
             case INC_POST:
-            {
-                const IR* out = operand->get(ctx, IRB);
-                IRB.add<IncInstr>(out);
-                return out;
-            }
             case DEC_POST:
             {
-                const IR* out = operand->get(ctx, IRB);
-                IRB.add<DecInstr>(out);
-                return out;
+                // Read, step and write back the variable, the
+                // postfix forms give the value it had before
+                const Reference* address = operand->get_address(ctx, IRB);
+                if (!address)
+                {
+                    throw ASTException(operand, "Expression does not return a reference");
+                }
+
+                const IR* before = load(ctx, IRB, address);
+                const IR* after;
+                if (op == INC_PRE || op == INC_POST)
+                {
+                    after = IRB.add_value<IncInstr>(before);
+                }
+                else
+                {
+                    after = IRB.add_value<DecInstr>(before);
+                }
+
+                store(ctx, IRB, address, after);
+                return op == INC_POST || op == DEC_POST ? before : after;
             }
         }
 
@@ -253,9 +268,9 @@ namespace cc
         return nullptr;
     }
 
-    const IR* ASTConstant::get(Context* ctx, IRBuilder &IRB) const
+    const IR* ASTConstant::get(Context* ctx, IRBuilder&) const
     {
-        return this;
+        return ctx->get_module()->constants().get(this);
     }
 
     std::string ConstantExpr::get_name() const
@@ -264,6 +279,11 @@ namespace cc
     }
 
     const IR* VariableExpr::get(Context* ctx, IRBuilder &IRB) const
+    {
+        return load(ctx, IRB, value->get());
+    }
+
+    const Reference* VariableExpr::get_address(Context*, IRBuilder&) const
     {
         return value->get();
     }
@@ -354,12 +374,12 @@ namespace cc
     }
 
 #define BINARY_OPERATOR_ILLEGAL(name, op) \
-    Constant* name::operator op(const Constant* c) const { \
+    Constant* name::operator op(const Constant*) const { \
         throw ASTException(this, "Illegal constant binary operator with " #name); \
     }
 
 #define BINARY_OPERATOR_CONST_RET(name, op, expr) \
-    Constant* name::operator op(const Constant* c) const { \
+    Constant* name::operator op([[maybe_unused]] const Constant* c) const { \
         expr; \
     }
 
@@ -466,18 +486,18 @@ namespace cc
         return new NumericExpr(this, INTEGER, !value.integer);
     }
 
-    Constant* VariableExpr::get_constant(Context* ctx) const
+    Constant* VariableExpr::get_constant(Context*) const
     {
         // TODO Support extrapolating from 'const'
         throw ASTException(this, "Constant expressions cannot have variables");
     }
 
-    Constant* AssignExpr::get_constant(Context* ctx) const
+    Constant* AssignExpr::get_constant(Context*) const
     {
         throw ASTException(this, "Assign expressions are not Constant");
     }
 
-    Constant* CallExpr::get_constant(Context* ctx) const
+    Constant* CallExpr::get_constant(Context*) const
     {
         throw ASTException(this, "Call expressions are not Constant");
     }
@@ -502,31 +522,37 @@ namespace cc
             args_ir.push_back(arg->value->get(ctx, IRB));
         }
 
-        F->check_arguments(this, args_ir);
+        F->check_arguments(ctx, this, args_ir);
         return IRB.add<CallInstr>(F, args_ir);
     }
 
     const IR* AssignExpr::get(Context* ctx, IRBuilder &IRB) const
     {
         const IR* out = value->get(ctx, IRB);
-        const IR* sink_val = sink->get(ctx, IRB);
-        auto* ref = dynamic_cast<const Reference*>(sink_val);
+        const Reference* ref = sink->get_address(ctx, IRB);
         if (!ref)
         {
             throw ASTException(sink, "Expression does not return a reference");
         }
 
-        IRB.add<MovInstr>(ref, out);
+        store(ctx, IRB, ref, out);
         return out;
     }
 
     void ASTFunctionDefine::add(Context* ctx, IRBuilder &IRB) const
     {
         ctx->enter_scope(Scope::FUNCTION, name);
+        lower(ctx, IRB);
+        ctx->exit_scope();
+    }
+
+    void ASTFunctionDefine::lower(Context* ctx, IRBuilder &IRB) const
+    {
         auto* f = dynamic_cast<Function*>(symbol);
         assert(f);
 
         ctx->set_function(f);
+        ctx->scope()->set_function(f);
         f->set_entry_block(ctx->scope()->new_block("entry"));
         IRB.set_insertion_point(f->get_entry_block());
 
@@ -541,10 +567,11 @@ namespace cc
 
         Block* final_block = IRB.get_insertion_point();
 
-        if (f->get_destructor_blocks().find(final_block)
-            == f->get_destructor_blocks().end())
+        if (!final_block->get_terminator())
         {
-            if (f->get_return_type() != ctx->type<Type::VOID>())
+            // Code following a return does not fall off the end
+            bool reachable = final_block == f->get_entry_block() || !final_block->predecessors().empty();
+            if (reachable && f->get_return_type() != ctx->type<Type::VOID>())
             {
                 // Normal C would just warn here
                 // C++ errors here, I think it should be an error
@@ -556,7 +583,6 @@ namespace cc
 
         /* Clean up */
         IRB.set_insertion_point(nullptr);
-        ctx->exit_scope();
     }
 
     void ASTGlobalVariable::add(Context* ctx, IRBuilder &IRB) const
@@ -568,27 +594,284 @@ namespace cc
         if (initializer)
         {
             IRB.set_insertion_point(ctx->get_module()->constructor());
-            IRB.add<MovInstr>(gv, initializer);
+            store(ctx, IRB, gv, ctx->get_module()->constants().get(initializer));
         }
     }
 
-    Block::~Block()
+    const IR* IRBuilder::insert(Instruction* instruction)
+    {
+        if (folder)
+        {
+            const IR* value = folder->simplify(block->get_scope()->get_ctx(), instruction);
+            if (value)
+            {
+                delete instruction;
+                return value;
+            }
+        }
+
+        block->push(instruction);
+        return instruction;
+    }
+
+    void IRBuilder::set_insertion_point(Block* block_)
+    {
+        // Instructions of other blocks are not available
+        if (folder && block_ != block)
+        {
+            folder->clear();
+        }
+
+        block = block_;
+    }
+
+    void IRBuilder::fall_through(Block* target)
+    {
+        assert(block && "Attempting to add instruction to nothing");
+        if (!block->get_terminator())
+        {
+            block->push(new JumpInstr(target));
+        }
+    }
+
+    InstructionIterator& InstructionIterator::operator--()
+    {
+        node = node ? node->prev : block->tail;
+        return *this;
+    }
+
+    const TerminatorInstr* Block::get_terminator() const
+    {
+        return tail && tail->get_opcode() >= Instruction::JUMP ? static_cast<const TerminatorInstr*>(tail) : nullptr;
+    }
+
+    void Block::link(const TerminatorInstr* terminator)
+    {
+        for (size_t i = 0; i < terminator->successor_count(); i++)
+        {
+            Block* target = terminator->successor(i);
+            assert(function && target->function == function && "Jumping out of the function");
+
+            successors_.push_back(target);
+            target->predecessors_.push_back(this);
+        }
+    }
+
+    void Block::unlink()
+    {
+        for (Block* target : successors_)
+        {
+            auto iter = std::find(target->predecessors_.begin(), target->predecessors_.end(), this);
+            assert(iter != target->predecessors_.end());
+            target->predecessors_.erase(iter);
+        }
+
+        successors_.clear();
+    }
+
+    void Block::number(Instruction* instruction)
+    {
+        if (instruction->get_id() < 0)
+        {
+            instruction->set_id(function ? function->next_value_id()
+                                         : scope->get_ctx()->get_module()->next_value_id());
+        }
+    }
+
+    void Block::push(Instruction* instruction)
+    {
+        assert(!get_terminator() && "Block is already terminated");
+        assert(!instruction->block && "Instruction is already in a block");
+        number(instruction);
+        instruction->update_type(scope->get_ctx());
+        instruction->block = this;
+        instruction->prev = tail;
+        (tail ? tail->next : head) = instruction;
+        tail = instruction;
+        count++;
+
+        auto* terminator = dynamic_cast<const TerminatorInstr*>(instruction);
+        if (terminator)
+        {
+            link(terminator);
+        }
+    }
+
+    Block::iterator Block::insert(iterator before, Instruction* instruction)
+    {
+        assert(*before && (*before)->block == this && "Inserting after the end of the block");
+        assert(!instruction->block && "Instruction is already in a block");
+        assert(!dynamic_cast<const TerminatorInstr*>(instruction) && "Terminators are pushed");
+
+        Instruction* next = *before;
+        number(instruction);
+        instruction->update_type(scope->get_ctx());
+        instruction->block = this;
+        instruction->prev = next->prev;
+        instruction->next = next;
+        (next->prev ? next->prev->next : head) = instruction;
+        next->prev = instruction;
+        count++;
+
+        return {this, instruction};
+    }
+
+    Block::iterator Block::erase(iterator it)
     {
-        for (Instruction* instr : instructions)
+        const auto* alloca = dynamic_cast<const AllocaInstr*>(*it);
+        assert((*it)->use_empty() && (!alloca || static_cast<const Reference*>(alloca)->use_empty())
+               && "Erasing an instruction that is still used");
+
+        if (dynamic_cast<const TerminatorInstr*>(*it))
         {
-            delete instr;
+            unlink();
         }
-        instructions.clear();
 
-        for (IR* ir : dangling)
+        Instruction* instruction = *it;
+        Instruction* next = instruction->next;
+        (instruction->prev ? instruction->prev->next : head) = next;
+        (next ? next->prev : tail) = instruction->prev;
+        count--;
+
+        delete instruction;
+        return {this, next};
+    }
+
+    void Block::replace(iterator it, Instruction* instruction)
+    {
+        auto* terminator = dynamic_cast<const TerminatorInstr*>(instruction);
+        assert(!terminator == !dynamic_cast<const TerminatorInstr*>(*it)
+               && "Terminators may only replace terminators");
+
+        if (terminator)
         {
-            delete ir;
+            unlink();
+            link(terminator);
         }
-        dangling.clear();
+
+        Instruction* old = *it;
+        number(instruction);
+        instruction->update_type(scope->get_ctx());
+        instruction->block = this;
+        instruction->prev = old->prev;
+        instruction->next = old->next;
+        (old->prev ? old->prev->next : head) = instruction;
+        (old->next ? old->next->prev : tail) = instruction;
+
+        old->replace_all_uses_with(instruction);
+        delete old;
     }
 
-    const Type* CallInstr::get_type(Context* ctx) const
+    void Block::absorb(Block* successor)
+    {
+        assert(dynamic_cast<const JumpInstr*>(get_terminator())
+               && dynamic_cast<const JumpInstr*>(get_terminator())->target == successor);
+        assert(successor->predecessors_.size() == 1 && successor != this);
+
+        erase(std::prev(end()));
+
+        const TerminatorInstr* terminator = successor->get_terminator();
+        successor->unlink();
+        for (Instruction* instruction = successor->head; instruction; instruction = instruction->next)
+        {
+            instruction->block = this;
+        }
+
+        if (successor->head)
+        {
+            successor->head->prev = tail;
+            (tail ? tail->next : head) = successor->head;
+            tail = successor->tail;
+            count += successor->count;
+        }
+
+        successor->head = nullptr;
+        successor->tail = nullptr;
+        successor->count = 0;
+
+        if (terminator)
+        {
+            link(terminator);
+        }
+    }
+
+    Block::~Block()
+    {
+        // Users go before the values they use
+        while (tail)
+        {
+            Instruction* prev = tail->prev;
+            delete tail;
+            tail = prev;
+        }
+        head = nullptr;
+    }
+
+    const Type* CallInstr::result_type(Context*) const
     {
         return f->get_return_type();
     }
+
+    bool Instruction::update_type(Context* ctx)
+    {
+        const Type* t = result_type(ctx);
+        bool changed = t != type;
+        type = t;
+        return changed;
+    }
+
+    static const Type* operand_type(Context* ctx, const IR* operand)
+    {
+        return operand ? operand->get_type(ctx) : nullptr;
+    }
+
+    const Type* BinaryInstr::result_type(Context* ctx) const
+    {
+        if (dynamic_cast<const LTInstr*>(this) || dynamic_cast<const GTInstr*>(this)
+            || dynamic_cast<const LEInstr*>(this) || dynamic_cast<const GEInstr*>(this)
+            || dynamic_cast<const EQInstr*>(this)
+            || dynamic_cast<const L_AndInstr*>(this) || dynamic_cast<const L_OrInstr*>(this))
+        {
+            return ctx->type<Type::I32>();
+        }
+
+        const Type* a_type = operand_type(ctx, a);
+        const Type* b_type = operand_type(ctx, b);
+        if (dynamic_cast<const L_SLInstr*>(this) || dynamic_cast<const L_SRInstr*>(this)
+            || dynamic_cast<const A_SRInstr*>(this))
+        {
+            return Type::promote(a_type);
+        }
+
+        bool a_ptr = a_type && a_type->get_primitive() == Type::PTR;
+        bool b_ptr = b_type && b_type->get_primitive() == Type::PTR;
+        if (dynamic_cast<const AddInstr*>(this) && a_ptr != b_ptr)
+        {
+            return a_ptr ? a_type : b_type;
+        }
+        else if (dynamic_cast<const SubInstr*>(this) && a_ptr)
+        {
+            return b_ptr ? ctx->type<Type::I64>() : a_type;
+        }
+
+        return Type::usual_arithmetic_conversion(a_type, b_type);
+    }
+
+    const Type* UnaryInstr::result_type(Context* ctx) const
+    {
+        if (dynamic_cast<const L_NotInstr*>(this))
+        {
+            return ctx->type<Type::I32>();
+        }
+
+        // Increments and decrements keep the type of their
+        // operand, their result is stored back to it
+        const Type* v_type = operand_type(ctx, v);
+        if (dynamic_cast<const B_NotInstr*>(this))
+        {
+            return Type::promote(v_type);
+        }
+
+        return v_type;
+    }
 }
@@ -2,30 +2,140 @@
 #define CC_INSTRUCTION_H
 
 #include <cc.h>
+#include <iterator>
 #include <list>
 #include <map>
 #include <utility>
+#include <vector>
 
 #include "context.h"
 
 namespace cc
 {
+    class Block;
+
     struct Instruction : public IR
     {
+        /**
+         * Kind of an instruction, one byte so that passes switch over
+         * it instead of probing the instruction classes one by one.
+         * Pure operations come first and terminators last.
+         */
+        enum opcode_t : uint8_t
+        {
+            ADD, SUB, DIV, MUL, INC, DEC,
+            L_NOT, L_AND, L_OR, LT, GT, LE, GE, EQ,
+            B_NOT, B_AND, B_OR, B_XOR, L_SL, L_SR, A_SR,
+            ALLOCA, LOAD, STORE, CALL,
+            JUMP, BRANCH, RETURN,
+        };
+
         virtual std::string get_name() const = 0;
+        opcode_t get_opcode() const { return opcode; }
+
+        /**
+         * Block the instruction was pushed to, nullptr before
+         */
+        Block* get_block() const { return block; }
+
+        /**
+         * Type of the result, computed once as the instruction
+         * is put in a block (see update_type())
+         */
+        const Type* get_type(Context*) const override { return type; }
+
+        /**
+         * Compute the type of the result out of the operands
+         * @return true if it changed
+         */
+        bool update_type(Context* ctx);
+
+    protected:
+        explicit Instruction(opcode_t opcode) :
+        opcode(opcode), type(nullptr), block(nullptr), prev(nullptr), next(nullptr) {}
+        virtual const Type* result_type(Context* ctx) const = 0;
+
+    private:
+        opcode_t opcode;        //!< First to fit in the padding of IR
+        const Type* type;
+        Block* block;
+        Instruction* prev;      //!< Neighbours in the block
+        Instruction* next;
+
+        friend class Block;
+        friend class InstructionIterator;
+    };
+
+    class InstructionIterator
+    {
+        /**
+         * Walks the instructions of a block, the end of the block is
+         * past its last instruction. Erasing an instruction only
+         * invalidates the iterators pointing to it.
+         */
+
+        const Block* block;
+        Instruction* node;      //!< nullptr at the end
+
+    public:
+        typedef std::bidirectional_iterator_tag iterator_category;
+        typedef Instruction* value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef Instruction** pointer;
+        typedef Instruction* reference;
+
+        InstructionIterator(const Block* block, Instruction* node) : block(block), node(node) {}
+
+        Instruction* operator*() const { return node; }
+        InstructionIterator& operator++() { node = node->next; return *this; }
+        InstructionIterator& operator--();
+        InstructionIterator operator++(int) { InstructionIterator out = *this; ++*this; return out; }
+        InstructionIterator operator--(int) { InstructionIterator out = *this; --*this; return out; }
+        bool operator==(const InstructionIterator& other) const { return node == other.node; }
+        bool operator!=(const InstructionIterator& other) const { return node != other.node; }
     };
 
+    struct TerminatorInstr;
+
     class Block : public Value
     {
+        /**
+         * Straight-line sequence of instructions. Blocks of a function
+         * end with exactly one terminator (jump, branch or return), the
+         * edges it creates are recorded on both of their ends as the
+         * terminator is pushed, replaced or erased. Blocks of the module
+         * (constructor and destructor) are never terminated.
+         *
+         * Instructions are still allocated one by one and only linked
+         * into the block, operands are Uses pointing at their values.
+         */
+
         Scope* scope;
-        Block* next_;
-        std::list<Instruction*> instructions;
-        std::list<IR*> dangling;
+        Function* function;
+        std::list<Block*>::iterator position;   //!< In the blocks of the function
+        uint32_t index;                         //!< Number in the function
+        Instruction* head;                      //!< Instructions are linked through their neighbours
+        Instruction* tail;
+        size_t count;
+        std::vector<Block*> successors_;
+        std::vector<Block*> predecessors_;      //!< One entry per edge, in the order they were added
         std::string name;
 
+        void link(const TerminatorInstr* terminator);
+        void unlink();
+
+        /**
+         * Give an instruction the next number of the function,
+         * instructions moved between blocks keep theirs
+         */
+        void number(Instruction* instruction);
+
+        friend class Function;
+        friend class InstructionIterator;
+
     public:
         explicit Block(Scope* scope, const std::string& name_ = "")
-        : scope(scope), next_(nullptr)
+        : scope(scope), function(nullptr), index(0), head(nullptr), tail(nullptr), count(0)
         {
             uint32_t b_c = scope->block_count();
             if (name_.empty())
@@ -45,66 +155,128 @@ namespace cc
             }
         }
 
-        void push(Instruction* instruction)
-        {
-            instructions.push_back(instruction);
-        }
+        /**
+         * Append an instruction, nothing may follow the terminator
+         */
+        void push(Instruction* instruction);
 
-        void push_dangling(IR* dangle)
-        {
-            dangling.push_back(dangle);
-        }
+        typedef InstructionIterator iterator;
 
-        void chain(Block* block, bool force=false)
-        {
-            if (not force)
-            {
-                assert(!next_ && "Block already has a next!");
-            }
+        /**
+         * Put an instruction before another one of the block,
+         * terminators are pushed instead
+         * @return iterator to the inserted instruction
+         */
+        iterator insert(iterator before, Instruction* instruction);
 
-            next_ = block;
-        }
+        /**
+         * Delete an instruction, its value must not be used anymore
+         * @return iterator following the erased instruction
+         */
+        iterator erase(iterator it);
 
-        Block* next() const { return next_; }
-        std::string get_name() const { return name; }
-        std::list<Instruction*>::const_iterator begin() const { return instructions.begin(); }
-        std::list<Instruction*>::const_iterator end() const { return instructions.end(); }
+        /**
+         * Delete an instruction and put another one in its place, its
+         * users use the new one. A terminator may only be replaced by
+         * another terminator.
+         */
+        void replace(iterator it, Instruction* instruction);
+
+        /**
+         * Move the instructions of the only successor of this block to
+         * its end, in place of the jump to it. This block must be the
+         * only predecessor of the successor, which is left empty.
+         */
+        void absorb(Block* successor);
+
+        /**
+         * Last instruction of the block if it is a terminator
+         */
+        const TerminatorInstr* get_terminator() const;
 
+        const std::vector<Block*>& successors() const { return successors_; }
+        const std::vector<Block*>& predecessors() const { return predecessors_; }
+        Function* get_function() const { return function; }
+
+        /**
+         * Dense number of the block in its function, below
+         * Function::get_block_bound()
+         */
+        uint32_t get_index() const { return index; }
+        Scope* get_scope() const { return scope; }
+        std::string get_name() const { return name; }
+        size_t size() const { return count; }
+        iterator begin() const { return {this, head}; }
+        iterator end() const { return {this, nullptr}; }
 
         ~Block() override;
     };
 
+    class Folder;
+
     class IRBuilder : public Value
     {
         Block* block;
+        Folder* folder;
+
+        const IR* insert(Instruction* instruction);
 
     public:
-        explicit IRBuilder() : block(nullptr) {}
+        explicit IRBuilder() : block(nullptr), folder(nullptr) {}
 
+        /**
+         * Instructions following a terminator (code after a return or
+         * a break) start a new block, nothing flows into it
+         */
         template<typename T,
                 typename... Args,
                 typename = typename std::enable_if<std::is_base_of<Instruction, T>::value >::type >
         const T* add(Args... args)
         {
             assert(block && "Attempting to add instruction to nothing");
+            if (block->get_terminator())
+            {
+                set_insertion_point(block->get_scope()->new_block());
+            }
+
             T* instr = new T(args...);
             block->push(instr);
             return instr;
         };
 
+        /**
+         * Add an instruction computing a value. With a folder the value
+         * may be a constant or a value computed earlier in the block
+         * instead, the instruction is not added then.
+         */
         template<typename T,
                 typename... Args,
-                typename = typename std::enable_if<std::is_base_of<IR, T>::value >::type >
-        const T* add_dangling(Args... args)
+                typename = typename std::enable_if<std::is_base_of<Instruction, T>::value >::type >
+        const IR* add_value(Args... args)
         {
             assert(block && "Attempting to add instruction to nothing");
-            T* ir = new T(args...);
-            block->push_dangling(ir);
-            return ir;
+            if (block->get_terminator())
+            {
+                set_insertion_point(block->get_scope()->new_block());
+            }
+
+            return insert(new T(args...));
         }
 
-        void set_insertion_point(Block* block_) { block = block_; }
+        /**
+         * Continue to a block at the end of a statement, unless
+         * control already left (return, break or continue)
+         */
+        void fall_through(Block* target);
+
+        void set_insertion_point(Block* block_);
         Block* get_insertion_point() { return block; }
+
+        /**
+         * Simplify the values added with add_value(), nullptr to
+         * add them as they are. The builder does not own it.
+         */
+        void set_folder(Folder* folder_) { folder = folder_; }
     };
 
     /****************************************************************************
@@ -115,64 +287,89 @@ namespace cc
 
     struct BinaryInstr : public Instruction
     {
-        const IR* a;
-        const IR* b;
+        Use a;
+        Use b;
+
+        BinaryInstr(opcode_t opcode, const IR* a, const IR* b) : Instruction(opcode), a(this, a), b(this, b) {}
 
-        const Type* get_type(Context* ctx) const override { return get_preferred_type({a, b}); }
-        BinaryInstr(const IR* a, const IR* b) : a(a), b(b) {}
+    protected:
+        /**
+         * Comparisons and logical operators give an int, shifts the
+         * promoted type of their left operand. The other operators
+         * apply the usual arithmetic conversions, pointers may be
+         * offset by integers or subtracted from each other.
+         */
+        const Type* result_type(Context* ctx) const override;
     };
 
     struct UnaryInstr : public Instruction
     {
-        const IR* v;
-        const Type* get_type(Context* ctx) const override { return v->get_type(ctx); }
-        explicit UnaryInstr(const IR* v) : v(v) {}
+        Use v;
+        UnaryInstr(opcode_t opcode, const IR* v) : Instruction(opcode), v(this, v) {}
+
+    protected:
+        const Type* result_type(Context* ctx) const override;
     };
 
-#define BINARY_INSTR(name) struct name##Instr : public BinaryInstr \
+#define BINARY_INSTR(name, op) struct name##Instr : public BinaryInstr \
     {                                                              \
-        name##Instr(const IR* a, const IR* b) : BinaryInstr(a, b)  {}          \
+        name##Instr(const IR* a, const IR* b) : BinaryInstr(op, a, b)  {}      \
         std::string get_name() const override { return #name "Instr"; } \
     }
 
-#define UNARY_INSTR(name)   \
+#define UNARY_INSTR(name, op)   \
     struct name##Instr : public UnaryInstr                  \
     {                                                       \
-        explicit name##Instr(const IR* v) : UnaryInstr(v)  {}     \
+        explicit name##Instr(const IR* v) : UnaryInstr(op, v)  {} \
         std::string get_name() const override { return #name "Instr"; } \
     }
 
     /** Arithmetic instructions **/
-    BINARY_INSTR(Add);
-    BINARY_INSTR(Sub);
-    BINARY_INSTR(Div);
-    BINARY_INSTR(Mul);
-    UNARY_INSTR(Inc);
-    UNARY_INSTR(Dec);
+    BINARY_INSTR(Add, ADD);
+    BINARY_INSTR(Sub, SUB);
+    BINARY_INSTR(Div, DIV);
+    BINARY_INSTR(Mul, MUL);
+    UNARY_INSTR(Inc, INC);
+    UNARY_INSTR(Dec, DEC);
 
     /** ====================== **/
 
     /** Logical instructions **/
-    UNARY_INSTR(L_Not);
-    BINARY_INSTR(L_And);
-    BINARY_INSTR(L_Or);
-    BINARY_INSTR(LT);
-    BINARY_INSTR(GT);
-    BINARY_INSTR(LE);
-    BINARY_INSTR(GE);
-    BINARY_INSTR(EQ);
+    UNARY_INSTR(L_Not, L_NOT);
+    BINARY_INSTR(L_And, L_AND);
+    BINARY_INSTR(L_Or, L_OR);
+    BINARY_INSTR(LT, LT);
+    BINARY_INSTR(GT, GT);
+    BINARY_INSTR(LE, LE);
+    BINARY_INSTR(GE, GE);
+    BINARY_INSTR(EQ, EQ);
 
     /** Bitwise instructions **/
-    UNARY_INSTR(B_Not);
-    BINARY_INSTR(B_And);
-    BINARY_INSTR(B_Or);
-    BINARY_INSTR(B_Xor);
-    BINARY_INSTR(L_SL);
-    BINARY_INSTR(L_SR);
-    BINARY_INSTR(A_SR);
+    UNARY_INSTR(B_Not, B_NOT);
+    BINARY_INSTR(B_And, B_AND);
+    BINARY_INSTR(B_Or, B_OR);
+    BINARY_INSTR(B_Xor, B_XOR);
+    BINARY_INSTR(L_SL, L_SL);
+    BINARY_INSTR(L_SR, L_SR);
+    BINARY_INSTR(A_SR, A_SR);
 
     /** Jumping and Branching **/
-    struct JumpInstr : public Instruction
+    struct TerminatorInstr : public Instruction
+    {
+        /**
+         * Last instruction of a block, control continues
+         * in one of its successors or leaves the function
+         */
+
+        virtual size_t successor_count() const = 0;
+        virtual Block* successor(size_t i) const = 0;
+
+    protected:
+        explicit TerminatorInstr(opcode_t opcode) : Instruction(opcode) {}
+        const Type* result_type(Context* ctx) const override { return ctx->type<Type::VOID>(); }
+    };
+
+    struct JumpInstr : public TerminatorInstr
     {
         /**
          * Unconditional jump
@@ -180,59 +377,107 @@ namespace cc
 
         Block* target;
 
-        explicit JumpInstr(Block* target) : target(target) {}
+        explicit JumpInstr(Block* target) : TerminatorInstr(JUMP), target(target) {}
         std::string get_name() const override { return "JumpInstr"; }
-        const Type* get_type(Context* ctx) const override { return ctx->type<Type::VOID>(); }
+        size_t successor_count() const override { return 1; }
+        Block* successor(size_t) const override { return target; }
     };
 
-    struct BranchInstr : public JumpInstr
+    struct BranchInstr : public TerminatorInstr
     {
         /**
-         * Conditional jump
+         * Conditional jump to target when the
+         * condition is non-zero, otherwise to otherwise
          */
 
-        const IR* condition;
+        Use condition;
+        Block* target;
+        Block* otherwise;
 
-        explicit BranchInstr(Block* target, const IR* condition) :
-            JumpInstr(target), condition(condition) {}
+        BranchInstr(const IR* condition, Block* target, Block* otherwise) :
+            TerminatorInstr(BRANCH), condition(this, condition), target(target), otherwise(otherwise) {}
         std::string get_name() const override { return "BranchInstr"; }
+        size_t successor_count() const override { return 2; }
+        Block* successor(size_t i) const override { return i ? otherwise : target; }
+    };
+
+    struct ReturnInstr : public TerminatorInstr
+    {
+        Use return_value;     //!< Empty in functions returning nothing
+        explicit ReturnInstr(const IR* return_value) :
+            TerminatorInstr(RETURN), return_value(this, return_value) {}
+
+        std::string get_name() const override { return "ReturnInstr"; }
+        size_t successor_count() const override { return 0; }
+        Block* successor(size_t) const override { return nullptr; }
     };
 
     /** Misc **/
 
     struct AllocaInstr : public Reference, public Instruction
     {
-        explicit AllocaInstr(Variable* variable) : Reference(variable) {}
+        explicit AllocaInstr(Variable* variable) : Reference(variable), Instruction(ALLOCA) {}
         std::string get_name() const override { return "AllocaInstr"; }
+        std::string as_string() const override { return Instruction::as_string(); }     //!< Numbered as an instruction
         const Type* get_type(Context* ctx) const override { return Reference::get_type(ctx); }
+
+    protected:
+        const Type* result_type(Context* ctx) const override { return Reference::get_type(ctx); }
     };
 
-    struct MovInstr : public Instruction
+    struct LoadInstr : public Instruction
     {
-        const Reference* dest;
-        const IR* src;
+        /**
+         * Read the variable behind a reference, the only
+         * way the value of a variable is used
+         */
+
+        Use address;            //!< Always a Reference
+        const Type* loaded;
+        uint32_t alignment;
+
+        LoadInstr(const Reference* address, const Type* loaded, uint32_t alignment) :
+            Instruction(LOAD), address(this, address), loaded(loaded), alignment(alignment) {}
+        std::string get_name() const override { return "LoadInstr"; }
 
-        MovInstr(const Reference* dest, const IR* src) : dest(dest), src(src) {}
-        std::string get_name() const override { return "MovInstr"; }
-        const Type* get_type(Context* ctx) const override { return dest->get_type(ctx); };
+    protected:
+        const Type* result_type(Context*) const override { return loaded; }
     };
 
-    struct ReturnInstr : public Instruction
+    struct StoreInstr : public Instruction
     {
-        const IR* return_value;
-        ReturnInstr(const IR* return_value) : return_value(return_value) {}
+        /**
+         * Write a value to the variable behind a reference
+         */
 
-        std::string get_name() const override { return "ReturnInstr"; }
-        const Type* get_type(Context* ctx) const override { return ctx->type<Type::VOID>(); }
+        Use address;            //!< Always a Reference
+        Use value;
+        uint32_t alignment;
+
+        StoreInstr(const Reference* address, const IR* value, uint32_t alignment) :
+            Instruction(STORE), address(this, address), value(this, value), alignment(alignment) {}
+        std::string get_name() const override { return "StoreInstr"; }
+
+    protected:
+        const Type* result_type(Context* ctx) const override { return ctx->type<Type::VOID>(); }
     };
 
     struct CallInstr : public Instruction
     {
         const Function* f;
-        std::vector<const IR*> arguments;
-        CallInstr(const Function* F, std::vector<const IR*> arguments) : f(F), arguments(std::move(arguments)) {}
+        std::vector<Use> arguments;
+        CallInstr(const Function* F, const std::vector<const IR*>& arguments_) : Instruction(CALL), f(F)
+        {
+            arguments.reserve(arguments_.size());
+            for (const IR* arg : arguments_)
+            {
+                arguments.emplace_back(this, arg);
+            }
+        }
         std::string get_name() const override { return "CallInstr"; }
-        const Type* get_type(Context* ctx) const override;
+
+    protected:
+        const Type* result_type(Context* ctx) const override;
     };
 }
 
@@ -1,20 +1,19 @@
 #include <iostream>
-#include "compilation/compile.h"
+#include <cstring>
+#include "compilation/driver.h"
+#include "server/protocol.h"
+#include "server/server.h"
 
 int main(int argc, const char* argv[])
 {
-    if (argc < 2)
+    if (argc >= 2 && strcmp(argv[1], "--server") == 0)
     {
-        std::cerr << "usage: " << argv[0] << " [INPUT].c\n";
-        return 1;
+        cc::Server server(argc >= 3 ? argv[2] : cc::default_socket_path());
+        return server.serve();
     }
 
-    cc::Compiler compiler(argv[1]);
-    if (not compiler.execute())
-    {
-        std::cerr << "Compiler execution failed\n";
-        return 2;
-    }
-
-    return 0;
+    cc::Driver driver;
+    return driver.run(argv[0],
+                      std::vector<std::string>(argv + 1, argv + argc),
+                      std::cout, std::cerr);
 }
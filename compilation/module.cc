@@ -1,5 +1,8 @@
 #include "module.h"
 #include "context.h"
+#include "instruction.h"
+
+#include <cstring>
 
 namespace cc
 {
@@ -9,6 +12,7 @@ namespace cc
         if (!declare_symbol(gv))
         {
             ctx->emit_error(variable, "Duplicate global symbol " + gv->get_name());
+            delete gv;
             return nullptr;
         }
 
@@ -21,6 +25,7 @@ namespace cc
         if (!declare_symbol(f))
         {
             ctx->emit_error(variable, "Duplicate global symbol " + f->get_name());
+            delete f;
             return nullptr;
         }
 
@@ -38,6 +43,16 @@ namespace cc
         return true;
     }
 
+    void Module::remove_symbol(const Global* symbol)
+    {
+        auto iter = symbols.find(symbol->get_name());
+        if (iter != symbols.end() && iter->second == symbol)
+        {
+            delete iter->second;
+            symbols.erase(iter);
+        }
+    }
+
     Module::~Module()
     {
         delete global_scope;
@@ -49,8 +64,8 @@ namespace cc
     }
 
     Module::Module(Context* context) :
+            constructor_block(nullptr), destructor_block(nullptr), value_count(0),
             global_scope(Scope::create(Scope::GLOBAL, context)),
-            constructor_block(nullptr), destructor_block(nullptr),
             ctx(context)
     {
         constructor_block = global_scope->new_block("constructor");
@@ -70,7 +85,105 @@ namespace cc
         return nullptr;
     }
 
-    bool Function::check_arguments(const CallExpr* call, const std::vector<const IR*>& args) const
+    NumericExpr* ConstantPool::number(NumericExpr::numeric_type_t type, int64_t bits)
+    {
+        NumericExpr*& slot = numbers[type][bits];
+        if (!slot)
+        {
+            ASTPosition position(0, 0, 0);
+            slot = new NumericExpr(&position, type, 0);
+            slot->value.integer = bits;     // Floating point numbers by their bits
+            slot->set_shared();
+        }
+
+        return slot;
+    }
+
+    const NumericExpr* ConstantPool::integer(int64_t value, NumericExpr::numeric_type_t type)
+    {
+        assert(type != NumericExpr::FLOATING);
+        std::lock_guard<std::mutex> lock(mutex);
+        return number(type, value);
+    }
+
+    const NumericExpr* ConstantPool::floating(double value)
+    {
+        int64_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+
+        std::lock_guard<std::mutex> lock(mutex);
+        return number(NumericExpr::FLOATING, bits);
+    }
+
+    const LiteralExpr* ConstantPool::string(const std::string& value)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        LiteralExpr*& slot = strings[value];
+        if (!slot)
+        {
+            ASTPosition position(0, 0, 0);
+            slot = new LiteralExpr(&position, value);
+            slot->set_shared();
+        }
+
+        return slot;
+    }
+
+    const Constant* ConstantPool::get(const Constant* c)
+    {
+        const auto* expr = dynamic_cast<const ConstantExpr*>(c);
+        if (expr)
+        {
+            return get(expr->constant);
+        }
+
+        const auto* n = dynamic_cast<const NumericExpr*>(c);
+        if (n)
+        {
+            return n->type == NumericExpr::FLOATING ? floating(n->value.floating) : integer(n->value.integer, n->type);
+        }
+
+        const auto* literal = dynamic_cast<const LiteralExpr*>(c);
+        if (literal)
+        {
+            return string(literal->value);
+        }
+
+        throw Exception("Cannot pool constant " + c->as_string());
+    }
+
+    ConstantPool::~ConstantPool()
+    {
+        for (auto& table : numbers)
+        {
+            for (auto& iter : table)
+            {
+                delete iter.second;
+            }
+        }
+
+        for (auto& iter : strings)
+        {
+            delete iter.second;
+        }
+    }
+
+    void Function::append_block(Block* block)
+    {
+        assert(!block->function);
+        block->function = this;
+        block->index = block_bound++;
+        block->position = blocks.insert(blocks.end(), block);
+    }
+
+    void Function::erase_block(Block* block)
+    {
+        assert(block->function == this);
+        blocks.erase(block->position);
+        block->function = nullptr;
+    }
+
+    bool Function::check_arguments(Context* ctx, const CallExpr* call, const std::vector<const IR*>& args) const
     {
         /* TODO implement IR type checking */
 
@@ -2,8 +2,11 @@
 #define CC_MODULE_H
 
 #include <cc.h>
+#include <list>
 #include <map>
+#include <mutex>
 #include <set>
+#include <unordered_map>
 #include "context.h"
 
 namespace cc
@@ -18,22 +21,32 @@ namespace cc
         std::string name;
 
         explicit Global(std::string name, const Type* type, Context* ctx) :
-        name(std::move(name)), type(type), ctx(ctx) {}
+        ctx(ctx), type(type), name(std::move(name)) {}
 
     public:
         std::string get_name() const { return name; }
+        const Type* get_declared_type() const { return type; }
     };
 
     class GlobalVariable : public Global, public Reference
     {
     public:
         explicit GlobalVariable(Variable* variable, ASTGlobalVariable* ast) :
-                Reference(variable), Global(ast->decl->name, ast->decl->type, ast->decl->type->get_ctx())
-        {}
+                Global(ast->decl->name, ast->decl->type, ast->decl->type->get_ctx()), Reference(variable)
+        {
+            set_shared();
+        }
 
         GlobalVariable(Variable* variable, const std::string &name, const Type* type)
-        : Reference(variable), Global(name, type, type->get_ctx())
-        {}
+        : Global(name, type, type->get_ctx()), Reference(variable)
+        {
+            set_shared();
+        }
+
+        std::string as_string() const override { return "@" + name; }
+
+        // Globals are created before their variable is declared
+        const Type* get_type(Context*) const override { return type; }
     };
 
     class ConstantGlobal : public GlobalVariable
@@ -53,13 +66,17 @@ namespace cc
         const Type* return_type;
         std::vector<const Type*> signature;
         std::set<Block*> destructor_blocks;
+        std::list<Block*> blocks;
+        uint32_t block_bound;
+        int value_count;
         Block* entry;
         const ASTFunction* ast;
 
     public:
         explicit Function(ASTFunction* ast) :
-                 Global(ast->name, nullptr, ast->return_type->get_ctx()), ast(ast),
-                 return_type(ast->return_type), signature(), entry(nullptr)
+                 Global(ast->name, nullptr, ast->return_type->get_ctx()),
+                 return_type(ast->return_type), signature(), block_bound(0), value_count(0), entry(nullptr),
+                 ast(ast)
         {
             for (Arguments* iter = ast->args; iter; iter = iter->next)
             {
@@ -67,26 +84,101 @@ namespace cc
             }
         }
 
-        bool check_arguments(const CallExpr* call, const std::vector<const IR*>& args) const;
+        /**
+         * @param ctx context receiving the errors
+         */
+        bool check_arguments(Context* ctx, const CallExpr* call, const std::vector<const IR*>& args) const;
 
         Block* get_entry_block() const { return entry; }
         void add_destructor_block(Block* block) { destructor_blocks.insert(block); }
+        void remove_destructor_block(Block* block) { destructor_blocks.erase(block); }
         const std::set<Block*>& get_destructor_blocks() const { return destructor_blocks; }
         void set_entry_block(Block* block) { entry = block; }
+
+        /**
+         * Blocks of the function in the order they were created, the
+         * entry block first. Scopes own the blocks, they add and
+         * remove themselves here (see Scope::new_block()).
+         */
+        const std::list<Block*>& get_blocks() const { return blocks; }
+
+        /**
+         * Blocks are numbered as they are appended (see Block::get_index()),
+         * numbers of erased blocks are not reused. Analyses index
+         * vectors of this size instead of hashing blocks.
+         */
+        uint32_t get_block_bound() const { return block_bound; }
+        void append_block(Block* block);
+        void erase_block(Block* block);
+
+        /**
+         * Instructions are numbered in the order they are put in the
+         * blocks of their function (see IR::get_id())
+         */
+        int next_value_id() { return value_count++; }
         const std::vector<const Type*>& get_signature() const { return signature; };
         const Type* get_return_type() const { return return_type; }
         const ASTFunction* get_ast() const { return ast; }
+
+        /**
+         * Forget the body once its AST and blocks are freed
+         */
+        void release_body()
+        {
+            ast = nullptr;
+            entry = nullptr;
+            destructor_blocks.clear();
+            blocks.clear();
+            block_bound = 0;
+        }
+    };
+
+    class ConstantPool
+    {
+        /**
+         * Constants used by the IR of a module, uniqued so that equal
+         * constants are the same value: integers and characters by type
+         * and value, floating point numbers by their bits and strings by
+         * their contents. Pooled constants are shared by every function,
+         * their uses are not recorded. Functions lowered on several
+         * threads look them up concurrently.
+         */
+
+        std::mutex mutex;
+        std::unordered_map<int64_t, NumericExpr*> numbers[NumericExpr::FLOATING + 1];
+        std::unordered_map<std::string, LiteralExpr*> strings;
+
+        NumericExpr* number(NumericExpr::numeric_type_t type, int64_t bits);
+
+    public:
+        ConstantPool() = default;
+        ConstantPool(const ConstantPool&) = delete;
+        ConstantPool& operator=(const ConstantPool&) = delete;
+
+        const NumericExpr* integer(int64_t value, NumericExpr::numeric_type_t type = NumericExpr::INTEGER);
+        const NumericExpr* floating(double value);
+        const LiteralExpr* string(const std::string& value);
+
+        /**
+         * Pooled constant equal to another one,
+         * constant expressions are unwrapped
+         */
+        const Constant* get(const Constant* c);
+
+        ~ConstantPool();
     };
 
     class Module : public Value
     {
         Block* constructor_block;
         Block* destructor_block;
+        int value_count;    //!< Instructions of the constructor and destructor
 
         Scope* global_scope;
 
         // Global variables and functions
         std::map<std::string, Global*> symbols;
+        ConstantPool constants_;
 
         bool declare_symbol(Global* self);
         Context* ctx;
@@ -97,12 +189,24 @@ namespace cc
         GlobalVariable* declare_variable(ASTGlobalVariable* variable);
         Function* declare_function(ASTFunction* variable);
         const Global* get_symbol(const std::string& name) const;
+
+        /**
+         * Delete a symbol declared in this module
+         * @param symbol nothing happens if symbol is not the one
+         *               declared under its name
+         */
+        void remove_symbol(const Global* symbol);
+
         const Function* get_function(const std::string& name) const
         { return dynamic_cast<const Function*>(get_symbol(name)); }
 
+        const std::map<std::string, Global*>& get_symbols() const { return symbols; }
+
         Scope* scope() const { return global_scope; }
         Block* constructor() const { return constructor_block; }
         Block* destructor() const { return destructor_block; }
+        int next_value_id() { return value_count++; }
+        ConstantPool& constants() { return constants_; }
 
         ~Module() override;
     };
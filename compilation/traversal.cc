@@ -132,12 +132,14 @@ namespace cc
     void ASTFunctionDefine::traverse(TraverseCB cb, Context* ctx, void* data)
     {
         ctx->enter_scope(Scope::FUNCTION, name);
+        ctx->set_ast_function(this);
         if (args)
         {
             args->traverse(cb, ctx, data);
         }
 
         body->traverse(cb, ctx, data);
+        ctx->set_ast_function(nullptr);
         cc::ASTFunction::traverse(cb, ctx, data);
         ctx->exit_scope();
     }
@@ -208,6 +210,22 @@ namespace cc
         {
             context->emit_error(this, "Undeclared variable " + variable);
         }
+
+        // Undeclared variables are recorded as well, declaring
+        // them as globals changes the meaning of the function
+        if (context->get_ast_function()
+            && (!value || context->get_module()->scope()->get_variable(variable) == value))
+        {
+            context->get_ast_function()->globals.insert(variable);
+        }
+    }
+
+    void CallExpr::resolution_pass(Context* context)
+    {
+        if (context->get_ast_function())
+        {
+            context->get_ast_function()->callees.insert(function);
+        }
     }
 
     void TypeDecl::resolution_pass(Context* context)
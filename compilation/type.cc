@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <map>
 #include <cc.h>
 
@@ -25,6 +26,87 @@ namespace cc
         }
     }
 
+    // Operand types after the integer promotions, and their common
+    // type, the ranks of the usual arithmetic conversions
+    enum arithmetic_t
+    {
+        A_I32,
+        A_U32,
+        A_I64,
+        A_U64,
+        A_F32,
+        A_F64,
+        A_N,
+        A_NONE = A_N
+    };
+
+    // Indexed by primitive and unsignedness
+    static constexpr arithmetic_t promotions[Type::P_N][2] = {
+            {A_I32, A_I32},     // I8
+            {A_I32, A_I32},     // I16
+            {A_I32, A_U32},     // I32
+            {A_I64, A_U64},     // I64
+            {A_NONE, A_NONE},   // VOID
+            {A_F32, A_F32},     // F32
+            {A_F64, A_F64},     // F64
+            {A_I32, A_I32},     // CHAR
+            {A_NONE, A_NONE},   // PTR
+            {A_I32, A_U32},     // ENUM
+            {A_NONE, A_NONE},   // STRUCT
+            {A_NONE, A_NONE},   // FUNCTION
+    };
+
+    // A signed type only wins over an unsigned one
+    // if it holds all of its values
+    static constexpr arithmetic_t conversions[A_N][A_N] = {
+            //  I32    U32    I64    U64    F32    F64
+            {A_I32, A_U32, A_I64, A_U64, A_F32, A_F64},     // I32
+            {A_U32, A_U32, A_I64, A_U64, A_F32, A_F64},     // U32
+            {A_I64, A_I64, A_I64, A_U64, A_F32, A_F64},     // I64
+            {A_U64, A_U64, A_U64, A_U64, A_F32, A_F64},     // U64
+            {A_F32, A_F32, A_F32, A_F32, A_F32, A_F64},     // F32
+            {A_F64, A_F64, A_F64, A_F64, A_F64, A_F64},     // F64
+    };
+
+    static arithmetic_t arithmetic(const Type* type)
+    {
+        return type ? promotions[type->get_primitive()][type->is_unsigned()] : A_NONE;
+    }
+
+    static const Type* arithmetic_type(Context* ctx, arithmetic_t a)
+    {
+        switch (a)
+        {
+            case A_I32: return ctx->type<Type::I32>();
+            case A_U32: return ctx->unsigned_type<Type::I32>();
+            case A_I64: return ctx->type<Type::I64>();
+            case A_U64: return ctx->unsigned_type<Type::I64>();
+            case A_F32: return ctx->type<Type::F32>();
+            case A_F64: return ctx->type<Type::F64>();
+            case A_NONE: break;
+        }
+
+        return nullptr;
+    }
+
+    const Type* Type::promote(const Type* type)
+    {
+        arithmetic_t a = arithmetic(type);
+        return a == A_NONE ? nullptr : arithmetic_type(type->get_ctx(), a);
+    }
+
+    const Type* Type::usual_arithmetic_conversion(const Type* a, const Type* b)
+    {
+        arithmetic_t x = arithmetic(a);
+        arithmetic_t y = arithmetic(b);
+        if (x == A_NONE || y == A_NONE)
+        {
+            return nullptr;
+        }
+
+        return arithmetic_type(a->get_ctx(), conversions[x][y]);
+    }
+
     const Type* Type::get(Context* ctx, const std::string &name)
     {
         // Builtin types
@@ -113,6 +195,7 @@ namespace cc
     Type(ctx, STRUCT), name(ast->name)
     {
         size = 0;
+        alignment = 1;
         for (FieldDecl* iter = ast->fields; iter; iter = iter->next)
         {
             int current_size = iter->decl->type->get_size();
@@ -123,6 +206,7 @@ namespace cc
             {
                 size += current_size - (size % current_size);
             }
+            alignment = std::max(alignment, current_size);
 
             fields.emplace_back(iter->decl, size);
             size += current_size;
@@ -191,6 +275,7 @@ namespace cc
 
     const Type* LiteralExpr::get_type(Context* ctx) const
     {
-        return nullptr;
+        // String literals decay to pointers
+        return ctx->type<Type::PTR>();
     }
 }
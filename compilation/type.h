@@ -30,7 +30,27 @@ namespace cc
 
         virtual std::string as_string() const;
         virtual int get_size() const;
+
+        /**
+         * Alignment of an object of this type in bytes, scalars
+         * are aligned to their size
+         */
+        virtual int get_alignment() const { return get_size(); }
         Context* get_ctx() const { return ctx; }
+        primitive_t get_primitive() const { return basic_type; }
+
+        /**
+         * Type of an operand after the integer promotions, integers
+         * narrower than int become int. nullptr if it is not arithmetic.
+         */
+        static const Type* promote(const Type* type);
+
+        /**
+         * Common type of the operands of an arithmetic operator after
+         * the usual arithmetic conversions of C, nullptr if one of
+         * them is not arithmetic
+         */
+        static const Type* usual_arithmetic_conversion(const Type* a, const Type* b);
 
         static const Type* get(Context* ctx, const std::string &name);
 
@@ -46,7 +66,7 @@ namespace cc
         Context* ctx;
         primitive_t basic_type;
         explicit Type(Context* ctx, primitive_t basic_type) :
-        basic_type(basic_type), ctx(ctx), pointer_to(nullptr) {}
+        pointer_to(nullptr), ctx(ctx), basic_type(basic_type) {}
     };
 
     struct QualType : public Type
@@ -86,6 +106,7 @@ namespace cc
         std::string name;
         explicit StructType(Context* ctx, StructDecl* ast);
         int get_size() const override { return size; };
+        int get_alignment() const override { return alignment; }
         int get_offset(const std::string& field_name) const;
 
         std::string as_string() const override;
@@ -93,6 +114,7 @@ namespace cc
 
     private:
         int size;
+        int alignment;      //!< Of the most aligned field
         std::vector<std::pair<TypeDecl*, int>> fields;
     };
 
@@ -19,7 +19,8 @@ namespace cc
     std::ostream& p(std::ostream &ss, const Instruction* self);
     std::ostream& p(std::ostream &ss, const Constant* self);
     std::ostream& p(std::ostream& ss, const Block* self);
-    std::ostream& p(std::ostream& ss, const Scope* self);
+    std::ostream& p(std::ostream& ss, const Scope* self,
+                    bool siblings = true, bool children = true);
 }
 
 #endif //PRINT_DEBUG_H
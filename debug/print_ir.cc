@@ -38,24 +38,32 @@ namespace cc
         {
             const auto* self_ = dynamic_cast<const BranchInstr*>(self);
             ss << "cond=" << self_->condition->as_string() << ", "
-               << "target=" << self_->target->get_name();
+               << "target=" << self_->target->get_name() << ", "
+               << "else=" << self_->otherwise->get_name();
         }
         else if (dynamic_cast<const JumpInstr*>(self))
         {
             const auto* self_ = dynamic_cast<const JumpInstr*>(self);
             ss << "target=" << self_->target->get_name();
         }
-        else if (dynamic_cast<const MovInstr*>(self))
+        else if (dynamic_cast<const LoadInstr*>(self))
         {
-            const auto* self_ = dynamic_cast<const MovInstr*>(self);
-            ss << self_->dest->as_string() << ", "
-               << self_->src->as_string();
+            const auto* self_ = dynamic_cast<const LoadInstr*>(self);
+            ss << self_->address->as_string() << ", "
+               << "align=" << self_->alignment;
+        }
+        else if (dynamic_cast<const StoreInstr*>(self))
+        {
+            const auto* self_ = dynamic_cast<const StoreInstr*>(self);
+            ss << self_->address->as_string() << ", "
+               << self_->value->as_string() << ", "
+               << "align=" << self_->alignment;
         }
         else if (dynamic_cast<const CallInstr*>(self))
         {
             const auto* self_ = dynamic_cast<const CallInstr*>(self);
             ss << self_->f->get_name() << " ";
-            for (int i = 0; i < self_->arguments.size(); i++)
+            for (size_t i = 0; i < self_->arguments.size(); i++)
             {
                 ss << "[" << self_->f->get_signature()[i]->as_string() << "] "
                    << self_->arguments[i]->as_string();
@@ -87,26 +95,23 @@ namespace cc
         return ss;
     }
 
-    std::ostream& p(std::ostream& ss, const Scope* self)
+    static void print_blocks(std::ostream& ss, const Scope* self)
     {
-        for (const Scope* s_iter = self; s_iter; s_iter = s_iter->next())
+        for (const auto& iter : self->get_blocks())
         {
-            for (const auto& iter : s_iter->get_blocks())
-            {
-                p(ss, iter);
-                if (iter->next())
-                {
-                    ss << "goto " << iter->next()->get_name() << "\n\n";
-                }
-                else
-                {
-                    ss << "end\n\n";
-                }
-            }
+            p(ss, iter) << "\n";
+        }
+    }
+
+    std::ostream& p(std::ostream& ss, const Scope* self, bool siblings, bool children)
+    {
+        for (const Scope* s_iter = self; s_iter; s_iter = siblings ? s_iter->next() : nullptr)
+        {
+            print_blocks(ss, s_iter);
 
-            if (self->child())
+            if (children && s_iter->child())
             {
-                p(ss, self->child());
+                p(ss, s_iter->child(), true, true);
             }
         }
 
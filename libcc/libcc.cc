@@ -0,0 +1,49 @@
+#include "libcc.h"
+#include <sstream>
+
+namespace cc
+{
+    size_t Result::error_count() const
+    {
+        size_t n = 0;
+        for (const auto& d : diagnostics)
+        {
+            if (d.severity == Diagnostic::ERROR)
+            {
+                n++;
+            }
+        }
+
+        return n;
+    }
+
+    Result Session::compile(std::string_view source, const std::string& filename)
+    {
+        Result result{false, "", {}};
+        std::stringstream out;
+
+        Compiler compiler(filename, std::string(source), &ctx, &parser, out);
+        compiler.set_print_diagnostics(false);
+
+        try
+        {
+            result.success = compiler.execute();
+        }
+        catch (ASTException& e)
+        {
+            result.diagnostics.push_back({Diagnostic::ERROR, filename,
+                                          e.self.line, static_cast<uint32_t>(e.self.col + 1u),
+                                          e.self.len, e.what()});
+        }
+        catch (Exception& e)
+        {
+            result.diagnostics.push_back({Diagnostic::ERROR, filename, 0, 0, 0, e.what()});
+        }
+
+        const auto& diagnostics = compiler.get_diagnostics();
+        result.diagnostics.insert(result.diagnostics.begin(), diagnostics.begin(), diagnostics.end());
+        result.output = out.str();
+
+        return result;
+    }
+}
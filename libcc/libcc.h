@@ -0,0 +1,59 @@
+#ifndef LIBCC_H
+#define LIBCC_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <compilation/compile.h>
+
+namespace cc
+{
+    struct Result
+    {
+        bool success;
+        std::string output;                     //!< AST and IR dumps
+        std::vector<Diagnostic> diagnostics;    //!< Errors and warnings in emission order
+
+        size_t error_count() const;
+    };
+
+    class Session
+    {
+        /**
+         * In-process compiler entry point.
+         *
+         * A session owns the parser buffers and a Context whose builtin
+         * types survive between compilations. Each compile() resets the
+         * context when it is done so the same session can be reused for
+         * any number of compilations without reallocating either.
+         *
+         * A session is used by one thread at a time, separate sessions
+         * compile concurrently and share nothing.
+         */
+
+        Parser parser;
+        Context ctx;
+
+    public:
+        Session() = default;
+        Session(const Session&) = delete;
+        Session& operator=(const Session&) = delete;
+
+        /**
+         * Compile a translation unit held in memory
+         * @param source content of the translation unit
+         * @param filename name reported in the diagnostics
+         * @return output and structured diagnostics
+         */
+        Result compile(std::string_view source,
+                       const std::string& filename = "<memory>");
+
+        /**
+         * Drop any state left in the context by a compilation
+         * that was interrupted by an exception escaping the caller
+         */
+        void reset() { ctx.reset(); }
+    };
+}
+
+#endif //LIBCC_H
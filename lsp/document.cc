@@ -0,0 +1,513 @@
+#include "document.h"
+#include <common/hash.h>
+#include <compilation/module.h>
+#include <algorithm>
+#include <cctype>
+#include <sstream>
+
+namespace cc
+{
+    bool Document::Chunk::has_struct() const
+    {
+        // Only definitions change how the rest of the file parses, look
+        // for `struct name {` and `struct {` outside of comments and literals
+        if (text.find("struct") == std::string::npos)
+        {
+            return false;
+        }
+
+        std::string before;     // Two tokens back
+        std::string previous;
+        size_t i = 0;
+        while (i < text.size())
+        {
+            char c = text[i];
+            if (isspace(static_cast<unsigned char>(c)))
+            {
+                i++;
+                continue;
+            }
+
+            if (text.compare(i, 2, "//") == 0)
+            {
+                i = std::min(text.find('\n', i), text.size());
+                continue;
+            }
+
+            if (text.compare(i, 2, "/*") == 0)
+            {
+                size_t end = text.find("*/", i + 2);
+                i = end == std::string::npos ? text.size() : end + 2;
+                continue;
+            }
+
+            std::string token;
+            if (c == '"' || c == '\'')
+            {
+                for (i++; i < text.size() && text[i] != c; i++)
+                {
+                    i += text[i] == '\\';
+                }
+                i++;
+                token = std::string(1, c);
+            }
+            else if (isalnum(static_cast<unsigned char>(c)) || c == '_')
+            {
+                size_t start = i;
+                while (i < text.size() && (isalnum(static_cast<unsigned char>(text[i])) || text[i] == '_'))
+                {
+                    i++;
+                }
+                token = text.substr(start, i - start);
+            }
+            else
+            {
+                token = std::string(1, c);
+                i++;
+            }
+
+            bool name = !previous.empty()
+                        && (isalpha(static_cast<unsigned char>(previous[0])) || previous[0] == '_');
+            if (token == "{" && (previous == "struct" || (before == "struct" && name)))
+            {
+                return true;
+            }
+
+            before = std::move(previous);
+            previous = std::move(token);
+        }
+
+        return false;
+    }
+
+    static const std::string* declared_name(const ASTGlobal* global)
+    {
+        if (dynamic_cast<const ASTFunction*>(global))
+        {
+            return &dynamic_cast<const ASTFunction*>(global)->name;
+        }
+        else if (dynamic_cast<const ASTGlobalVariable*>(global))
+        {
+            return &dynamic_cast<const ASTGlobalVariable*>(global)->decl->name;
+        }
+
+        return nullptr;
+    }
+
+    std::set<std::string> Document::Chunk::declared() const
+    {
+        std::set<std::string> out;
+        for (const ASTGlobal* iter = ast; iter; iter = iter->next)
+        {
+            const std::string* name = declared_name(iter);
+            if (name)
+            {
+                out.insert(*name);
+            }
+        }
+
+        return out;
+    }
+
+    bool Document::Chunk::depends_on(const std::set<std::string>& names) const
+    {
+        for (const ASTGlobal* iter = ast; iter; iter = iter->next)
+        {
+            const auto* f = dynamic_cast<const ASTFunctionDefine*>(iter);
+            if (!f)
+            {
+                continue;
+            }
+
+            for (const std::string& name : f->globals)
+            {
+                if (names.find(name) != names.end())
+                {
+                    return true;
+                }
+            }
+        }
+
+        // Duplicate declarations of the same name
+        for (const ASTGlobal* iter = ast; iter; iter = iter->next)
+        {
+            const std::string* name = declared_name(iter);
+            if (name && names.find(*name) != names.end())
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    // LSP counts characters in UTF-16 code units, the text is UTF-8
+    static uint32_t utf16_length(const std::string& text, size_t begin, size_t end)
+    {
+        uint32_t units = 0;
+        for (size_t i = begin; i < end; i++)
+        {
+            auto c = static_cast<unsigned char>(text[i]);
+            if ((c & 0xC0) != 0x80)
+            {
+                units += c >= 0xF0 ? 2 : 1;     // Outside of the BMP, a surrogate pair
+            }
+        }
+
+        return units;
+    }
+
+    // Offset of the character `column` UTF-16 code units into the line [begin, end)
+    static size_t utf16_offset(const std::string& text, size_t begin, size_t end, uint32_t column)
+    {
+        size_t i = begin;
+        for (uint32_t units = 0; i < end && units < column; )
+        {
+            units += static_cast<unsigned char>(text[i]) >= 0xF0 ? 2 : 1;
+            i++;
+            while (i < end && (static_cast<unsigned char>(text[i]) & 0xC0) == 0x80)
+            {
+                i++;
+            }
+        }
+
+        return i;
+    }
+
+    Document::Document(const Parser* parser, std::string uri, std::string text) :
+            parser(parser), uri(std::move(uri)), text(std::move(text)),
+            reparsed(0), reresolved(0)
+    {
+    }
+
+    std::vector<std::unique_ptr<Document::Chunk>> Document::split() const
+    {
+        std::vector<std::unique_ptr<Chunk>> out;
+        std::istringstream in(text);
+        DeclarationReader reader(in);
+
+        auto* chunk = new Chunk();
+        while (reader.next(*chunk))
+        {
+            chunk->hash = xxhash64(chunk->text);
+            out.emplace_back(chunk);
+            chunk = new Chunk();
+        }
+        delete chunk;
+
+        return out;
+    }
+
+    void Document::collect(std::vector<Diagnostic>& out)
+    {
+        for (const ASTException& e : ctx.get_errors())
+        {
+            out.push_back({Diagnostic::ERROR, uri, e.self.line,
+                           static_cast<uint32_t>(e.self.col + 1u), e.self.len, e.what()});
+        }
+
+        for (const ASTException& e : ctx.get_warnings())
+        {
+            out.push_back({Diagnostic::WARNING, uri, e.self.line,
+                           static_cast<uint32_t>(e.self.col + 1u), e.self.len, e.what()});
+        }
+
+        ctx.clear_errors();
+        ctx.clear_warnings();
+    }
+
+    void Document::parse(Chunk* chunk)
+    {
+        chunk->parse_diagnostics.clear();
+        if (chunk->is_blank())
+        {
+            return;
+        }
+
+        // Positions are relative to the chunk, see get_diagnostics()
+        try
+        {
+            chunk->ast = parser->parse(&ctx, chunk->text.c_str());
+        }
+        catch (ASTException& e)
+        {
+            chunk->parse_diagnostics.push_back({Diagnostic::ERROR, uri, e.self.line,
+                                                static_cast<uint32_t>(e.self.col + 1u),
+                                                e.self.len, e.what()});
+        }
+        catch (Exception& e)
+        {
+            // Errors without a position point at the start of the chunk
+            chunk->parse_diagnostics.push_back({Diagnostic::ERROR, uri, 1, 1, 0, e.what()});
+        }
+
+        collect(chunk->parse_diagnostics);
+        reparsed++;
+    }
+
+    void Document::resolve(Chunk* chunk)
+    {
+        chunk->resolve_diagnostics.clear();
+        chunk->scopes.clear();
+
+        Scope* global_scope = ctx.get_module()->scope();
+        ctx.start_scope_build();
+        for (ASTGlobal* iter = chunk->ast; iter; iter = iter->next)
+        {
+            if (dynamic_cast<ASTFunctionDefine*>(iter))
+            {
+                dynamic_cast<ASTFunctionDefine*>(iter)->callees.clear();
+                dynamic_cast<ASTFunctionDefine*>(iter)->globals.clear();
+            }
+
+            Scope* last = global_scope->last();
+            try
+            {
+                resolve_global(&ctx, iter);
+            }
+            catch (ASTException& e)
+            {
+                chunk->resolve_diagnostics.push_back({Diagnostic::ERROR, uri, e.self.line,
+                                                      static_cast<uint32_t>(e.self.col + 1u),
+                                                      e.self.len, e.what()});
+            }
+            catch (Exception& e)
+            {
+                chunk->resolve_diagnostics.push_back({Diagnostic::ERROR, uri, 1, 1, 0, e.what()});
+            }
+
+            if (global_scope->last() != last)
+            {
+                chunk->scopes.push_back(global_scope->last());
+            }
+        }
+        ctx.end_scope_build();
+
+        collect(chunk->resolve_diagnostics);
+        reresolved++;
+    }
+
+    void Document::unresolve(Chunk* chunk)
+    {
+        Module* module = ctx.get_module();
+        for (ASTGlobal* iter = chunk->ast; iter; iter = iter->next)
+        {
+            auto* gv = dynamic_cast<ASTGlobalVariable*>(iter);
+            if (gv && gv->decl->variable)
+            {
+                module->scope()->remove_variable(gv->decl->variable);
+                gv->decl->variable = nullptr;
+            }
+
+            if (iter->symbol)
+            {
+                module->remove_symbol(iter->symbol);
+                iter->symbol = nullptr;
+            }
+        }
+
+        for (Scope* scope : chunk->scopes)
+        {
+            module->scope()->remove_child(scope);
+        }
+        chunk->scopes.clear();
+    }
+
+    void Document::analyze_all()
+    {
+        ctx.reset();
+        for (auto& chunk : chunks)
+        {
+            delete chunk->ast;
+            chunk->ast = nullptr;
+        }
+
+        for (auto& chunk : chunks)
+        {
+            parse(chunk.get());
+        }
+
+        for (auto& chunk : chunks)
+        {
+            resolve(chunk.get());
+        }
+    }
+
+    void Document::update()
+    {
+        reparsed = 0;
+        reresolved = 0;
+
+        std::vector<std::unique_ptr<Chunk>> next = split();
+
+        // Chunks sharing a prefix and a suffix with the last analysis
+        // are kept, a chunk that moved across lines keeps its AST
+        auto same = [](const Chunk* a, const Chunk* b)
+        {
+            return a->hash == b->hash && a->col == b->col && a->text == b->text;
+        };
+
+        size_t prefix = 0;
+        while (prefix < chunks.size() && prefix < next.size()
+               && same(chunks[prefix].get(), next[prefix].get()))
+        {
+            prefix++;
+        }
+
+        size_t suffix = 0;
+        while (suffix < chunks.size() - prefix && suffix < next.size() - prefix
+               && same(chunks[chunks.size() - suffix - 1].get(), next[next.size() - suffix - 1].get()))
+        {
+            suffix++;
+        }
+
+        size_t old_end = chunks.size() - suffix;
+        size_t new_end = next.size() - suffix;
+
+        bool full = chunks.empty();
+        for (size_t i = prefix; i < old_end && !full; i++)
+        {
+            full = chunks[i]->has_struct();
+        }
+        for (size_t i = prefix; i < new_end && !full; i++)
+        {
+            full = next[i]->has_struct();
+        }
+
+        if (full)
+        {
+            chunks = std::move(next);
+            analyze_all();
+            return;
+        }
+
+        // Names whose meaning may have changed
+        std::set<std::string> changed;
+        for (size_t i = prefix; i < old_end; i++)
+        {
+            std::set<std::string> declared = chunks[i]->declared();
+            changed.insert(declared.begin(), declared.end());
+            unresolve(chunks[i].get());
+        }
+
+        // Unchanged chunks move to the new chunk list
+        for (size_t i = 0; i < prefix; i++)
+        {
+            next[i] = std::move(chunks[i]);
+        }
+        for (size_t i = 0; i < suffix; i++)
+        {
+            uint32_t line = next[new_end + i]->line;
+            next[new_end + i] = std::move(chunks[old_end + i]);
+            next[new_end + i]->line = line;
+        }
+        chunks = std::move(next);
+
+        for (size_t i = prefix; i < new_end; i++)
+        {
+            parse(chunks[i].get());
+            std::set<std::string> declared = chunks[i]->declared();
+            changed.insert(declared.begin(), declared.end());
+        }
+
+        std::vector<Chunk*> affected;
+        for (size_t i = 0; i < chunks.size(); i++)
+        {
+            if (i >= prefix && i < new_end)
+            {
+                affected.push_back(chunks[i].get());
+            }
+            else if (!changed.empty() && chunks[i]->depends_on(changed))
+            {
+                unresolve(chunks[i].get());
+                affected.push_back(chunks[i].get());
+            }
+        }
+
+        for (Chunk* chunk : affected)
+        {
+            resolve(chunk);
+        }
+    }
+
+    void Document::edit(uint32_t start_line, uint32_t start_char,
+                        uint32_t end_line, uint32_t end_char,
+                        const std::string& new_text)
+    {
+        auto offset = [this](uint32_t line, uint32_t character)
+        {
+            size_t i = 0;
+            for (uint32_t l = 0; l < line; l++)
+            {
+                i = text.find('\n', i);
+                if (i == std::string::npos)
+                {
+                    return text.size();
+                }
+                i++;
+            }
+
+            size_t eol = std::min(text.find('\n', i), text.size());
+            return utf16_offset(text, i, eol, character);
+        };
+
+        size_t start = offset(start_line, start_char);
+        size_t end = std::max(start, offset(end_line, end_char));
+        text.replace(start, end - start, new_text);
+    }
+
+    std::vector<Diagnostic> Document::get_diagnostics() const
+    {
+        std::vector<Diagnostic> out;
+        std::vector<size_t> lines;      // Offset of every line, built on the first diagnostic
+        for (const auto& chunk : chunks)
+        {
+            for (const auto* list : {&chunk->parse_diagnostics, &chunk->resolve_diagnostics})
+            {
+                for (Diagnostic d : *list)
+                {
+                    // Positions are relative to the text of the chunk
+                    if (d.line == 0)
+                    {
+                        out.push_back(std::move(d));
+                        continue;
+                    }
+
+                    if (d.line == 1)
+                    {
+                        d.column += chunk->col;
+                    }
+                    d.line += chunk->line;
+
+                    if (lines.empty())
+                    {
+                        lines.push_back(0);
+                        for (size_t i = text.find('\n'); i != std::string::npos; i = text.find('\n', i + 1))
+                        {
+                            lines.push_back(i + 1);
+                        }
+                    }
+
+                    if (d.line <= lines.size())
+                    {
+                        size_t start = lines[d.line - 1];
+                        size_t eol = d.line < lines.size() ? lines[d.line] - 1 : text.size();
+                        size_t begin = std::min(start + d.column - 1, eol);
+                        d.column = utf16_length(text, start, begin) + 1;
+                        d.length = utf16_length(text, begin, std::min(begin + d.length, eol));
+                    }
+                    out.push_back(std::move(d));
+                }
+            }
+        }
+
+        return out;
+    }
+
+    Document::~Document()
+    {
+        // Symbols refer to the AST, tear the context down first
+        ctx.reset();
+        chunks.clear();
+    }
+}
@@ -0,0 +1,105 @@
+#ifndef CC_DOCUMENT_H
+#define CC_DOCUMENT_H
+
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+#include <compilation/compile.h>
+#include <compilation/declarations.h>
+
+namespace cc
+{
+    class Document
+    {
+        /**
+         * Source file kept open by the language server.
+         *
+         * The text is split into top-level declarations (chunks). Every
+         * chunk is parsed on its own into a resident Context so that the
+         * AST, the scope tree and the module symbols survive between edits.
+         * After an edit only the chunks whose text changed are parsed again,
+         * and only the chunks depending on the global names they declare(d)
+         * go through the resolution pass again.
+         *
+         * Chunks are parsed on their own text, the positions in their AST
+         * and diagnostics are relative to the chunk so that a chunk moving
+         * across lines keeps them.
+         *
+         * Definitions of structures change how the rest of the file is
+         * parsed, edits touching them fall back to a full reanalysis.
+         */
+
+        struct Chunk : public Declaration
+        {
+            uint64_t hash;
+
+            ASTGlobal* ast;
+            std::vector<Scope*> scopes;             //!< Children of the global scope
+            std::vector<Diagnostic> parse_diagnostics;
+            std::vector<Diagnostic> resolve_diagnostics;
+
+            Chunk() : hash(0), ast(nullptr) {}
+            ~Chunk() { delete ast; }
+
+            bool has_struct() const;
+            std::set<std::string> declared() const;
+            bool depends_on(const std::set<std::string>& names) const;
+        };
+
+        const Parser* parser;
+        Context ctx;
+        std::string uri;
+        std::string text;
+        std::vector<std::unique_ptr<Chunk>> chunks;
+
+        size_t reparsed;
+        size_t reresolved;
+
+        std::vector<std::unique_ptr<Chunk>> split() const;
+        void collect(std::vector<Diagnostic>& out);
+        void parse(Chunk* chunk);
+        void resolve(Chunk* chunk);
+        void unresolve(Chunk* chunk);
+        void analyze_all();
+
+    public:
+        Document(const Parser* parser, std::string uri, std::string text);
+        Document(const Document&) = delete;
+        Document& operator=(const Document&) = delete;
+
+        const std::string& get_uri() const { return uri; }
+        const std::string& get_text() const { return text; }
+
+        /**
+         * Replace the range [start, end) of the text, positions are 0-based
+         * (line, character) pairs, characters are UTF-16 code units like in
+         * LSP. Call update() once all edits are applied.
+         */
+        void edit(uint32_t start_line, uint32_t start_char,
+                  uint32_t end_line, uint32_t end_char,
+                  const std::string& new_text);
+        void set_text(std::string new_text) { text = std::move(new_text); }
+
+        /**
+         * Bring the analysis up to date with the text
+         */
+        void update();
+
+        /**
+         * Diagnostics in file order, lines are 1-based like the compiler's,
+         * columns and lengths count UTF-16 code units
+         */
+        std::vector<Diagnostic> get_diagnostics() const;
+
+        /**
+         * Chunks parsed and resolved by the last update()
+         */
+        size_t get_reparsed() const { return reparsed; }
+        size_t get_reresolved() const { return reresolved; }
+
+        ~Document();
+    };
+}
+
+#endif //CC_DOCUMENT_H
@@ -0,0 +1,31 @@
+#include "server.h"
+#include <fstream>
+#include <cstring>
+
+using namespace cc;
+
+int main(int argc, const char* argv[])
+{
+    if (argc == 3 && strcmp(argv[1], "--replay") == 0)
+    {
+        std::ifstream session(argv[2]);
+        if (!session)
+        {
+            std::cerr << "Failed to open " << argv[2] << "\n";
+            return 1;
+        }
+
+        LanguageServer server(session, std::cout, false);
+        return server.replay(std::cerr);
+    }
+
+    if (argc != 1)
+    {
+        std::cerr << "usage: " << argv[0] << " [--replay SESSION]\n";
+        return 1;
+    }
+
+    std::ios::sync_with_stdio(false);
+    LanguageServer server(std::cin, std::cout);
+    return server.run();
+}
@@ -0,0 +1,360 @@
+#include "server.h"
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+
+namespace cc
+{
+    // JSON-RPC error codes
+    static constexpr int PARSE_ERROR = -32700;
+    static constexpr int METHOD_NOT_FOUND = -32601;
+    static constexpr int INVALID_REQUEST = -32600;
+    static constexpr int INTERNAL_ERROR = -32603;
+
+    // Bodies are read in a single buffer, refuse absurd lengths
+    static constexpr unsigned long MAX_CONTENT_LENGTH = 1ul << 30;
+
+    LanguageServer::LanguageServer(std::istream& in, std::ostream& out, bool framed) :
+            in(in), out(out), framed(framed),
+            shutdown_requested(false), exited(false)
+    {
+    }
+
+    bool LanguageServer::read(Json& message)
+    {
+        std::string line;
+        if (!framed)
+        {
+            while (std::getline(in, line))
+            {
+                if (line.find_first_not_of(" \t\r") != std::string::npos)
+                {
+                    message = Json::parse(line);
+                    return true;
+                }
+            }
+
+            return false;
+        }
+
+        size_t length = 0;
+        bool has_length = false;
+        std::string invalid;
+        while (std::getline(in, line))
+        {
+            if (!line.empty() && line.back() == '\r')
+            {
+                line.pop_back();
+            }
+
+            if (line.empty())
+            {
+                if (!invalid.empty())
+                {
+                    throw Exception(invalid);
+                }
+
+                if (!has_length)
+                {
+                    throw Exception("Message without Content-Length");
+                }
+
+                std::string body(length, '\0');
+                if (!in.read(&body[0], static_cast<std::streamsize>(length)))
+                {
+                    return false;
+                }
+
+                message = Json::parse(body);
+                return true;
+            }
+
+            const std::string header = "Content-Length:";
+            if (line.compare(0, header.size(), header) == 0)
+            {
+                const char* value = line.c_str() + header.size();
+                while (*value == ' ' || *value == '\t')
+                {
+                    value++;
+                }
+
+                char* end = nullptr;
+                errno = 0;
+                unsigned long parsed = isdigit(static_cast<unsigned char>(*value)) ? strtoul(value, &end, 10) : 0;
+                if (!end || errno == ERANGE || *end != '\0' || parsed > MAX_CONTENT_LENGTH)
+                {
+                    // Thrown once the headers are read, the next message starts after them
+                    invalid = "Invalid Content-Length:" + line.substr(header.size());
+                    continue;
+                }
+
+                length = parsed;
+                has_length = true;
+            }
+        }
+
+        return false;
+    }
+
+    void LanguageServer::send(const Json& message)
+    {
+        std::string body = message.dump();
+        if (framed)
+        {
+            out << "Content-Length: " << body.size() << "\r\n\r\n" << body;
+        }
+        else
+        {
+            out << body << "\n";
+        }
+        out.flush();
+    }
+
+    void LanguageServer::reply(const Json& id, Json result)
+    {
+        Json message;
+        message["jsonrpc"] = "2.0";
+        message["id"] = id;
+        message["result"] = std::move(result);
+        send(message);
+    }
+
+    void LanguageServer::reply_error(const Json& id, int code, const std::string& what)
+    {
+        Json message;
+        message["jsonrpc"] = "2.0";
+        message["id"] = id;
+        message["error"]["code"] = code;
+        message["error"]["message"] = what;
+        send(message);
+    }
+
+    static Json lsp_position(uint32_t line, uint32_t character)
+    {
+        Json out;
+        out["line"] = line;
+        out["character"] = character;
+        return out;
+    }
+
+    void LanguageServer::publish(const Document* document)
+    {
+        Json diagnostics = Json::make_array();
+        for (const Diagnostic& d : document->get_diagnostics())
+        {
+            uint32_t line = d.line > 0 ? d.line - 1 : 0;
+            uint32_t character = d.column > 0 ? d.column - 1 : 0;
+
+            Json diagnostic;
+            diagnostic["range"]["start"] = lsp_position(line, character);
+            diagnostic["range"]["end"] = lsp_position(line, character + std::max(d.length, 1u));
+            diagnostic["severity"] = d.severity == Diagnostic::ERROR ? 1 : 2;
+            diagnostic["source"] = "cc";
+            diagnostic["message"] = d.message;
+            diagnostics.push(std::move(diagnostic));
+        }
+
+        Json message;
+        message["jsonrpc"] = "2.0";
+        message["method"] = "textDocument/publishDiagnostics";
+        message["params"]["uri"] = document->get_uri();
+        message["params"]["diagnostics"] = std::move(diagnostics);
+        send(message);
+    }
+
+    void LanguageServer::did_open(const Json& params)
+    {
+        const Json& item = params["textDocument"];
+        auto* document = new Document(&parser, item["uri"].as_string(), item["text"].as_string());
+        documents[document->get_uri()].reset(document);
+
+        document->update();
+        publish(document);
+    }
+
+    void LanguageServer::did_change(const Json& params)
+    {
+        auto iter = documents.find(params["textDocument"]["uri"].as_string());
+        if (iter == documents.end())
+        {
+            return;
+        }
+
+        Document* document = iter->second.get();
+        const Json& changes = params["contentChanges"];
+        for (size_t i = 0; i < changes.size(); i++)
+        {
+            const Json& change = changes[i];
+            if (!change.has("range"))
+            {
+                document->set_text(change["text"].as_string());
+                continue;
+            }
+
+            const Json& start = change["range"]["start"];
+            const Json& end = change["range"]["end"];
+            document->edit(start["line"].as_int(), start["character"].as_int(),
+                           end["line"].as_int(), end["character"].as_int(),
+                           change["text"].as_string());
+        }
+
+        document->update();
+        publish(document);
+    }
+
+    void LanguageServer::did_close(const Json& params)
+    {
+        auto iter = documents.find(params["textDocument"]["uri"].as_string());
+        if (iter == documents.end())
+        {
+            return;
+        }
+
+        // Clear the diagnostics shown by the client
+        Json message;
+        message["jsonrpc"] = "2.0";
+        message["method"] = "textDocument/publishDiagnostics";
+        message["params"]["uri"] = iter->first;
+        message["params"]["diagnostics"] = Json::make_array();
+        send(message);
+
+        documents.erase(iter);
+    }
+
+    void LanguageServer::handle(const Json& message)
+    {
+        // A message the server fails on must not take it down
+        try
+        {
+            dispatch(message);
+        }
+        catch (std::exception& e)
+        {
+            if (message.has("id"))
+            {
+                reply_error(message["id"], INTERNAL_ERROR, e.what());
+                return;
+            }
+
+            // Notifications get no response, show the failure in the client's log
+            Json log;
+            log["jsonrpc"] = "2.0";
+            log["method"] = "window/logMessage";
+            log["params"]["type"] = 1;      // Error
+            log["params"]["message"] = message["method"].as_string() + ": " + e.what();
+            send(log);
+        }
+    }
+
+    void LanguageServer::dispatch(const Json& message)
+    {
+        const std::string& method = message["method"].as_string();
+        const Json& id = message["id"];
+        bool request = message.has("id");
+
+        if (method == "initialize")
+        {
+            Json result;
+            result["capabilities"]["textDocumentSync"]["openClose"] = true;
+            result["capabilities"]["textDocumentSync"]["change"] = 2;    // Incremental
+            result["serverInfo"]["name"] = "cc-lsp";
+            result["serverInfo"]["version"] = CC_VERSION;
+            reply(id, std::move(result));
+        }
+        else if (method == "shutdown")
+        {
+            shutdown_requested = true;
+            reply(id, Json());
+        }
+        else if (method == "exit")
+        {
+            exited = true;
+        }
+        else if (method == "textDocument/didOpen")
+        {
+            did_open(message["params"]);
+        }
+        else if (method == "textDocument/didChange")
+        {
+            did_change(message["params"]);
+        }
+        else if (method == "textDocument/didClose")
+        {
+            did_close(message["params"]);
+        }
+        else if (method.empty() && request)
+        {
+            reply_error(id, INVALID_REQUEST, "Missing method");
+        }
+        else if (request)
+        {
+            reply_error(id, METHOD_NOT_FOUND, "Unhandled method " + method);
+        }
+
+        // Notifications we do not handle are dropped
+    }
+
+    int LanguageServer::run()
+    {
+        while (!exited)
+        {
+            Json message;
+            try
+            {
+                if (!read(message))
+                {
+                    break;
+                }
+            }
+            catch (Exception& e)
+            {
+                reply_error(Json(), PARSE_ERROR, e.what());
+                continue;
+            }
+
+            handle(message);
+        }
+
+        return shutdown_requested ? 0 : 1;
+    }
+
+    int LanguageServer::replay(std::ostream& report)
+    {
+        std::vector<double> latencies;
+        while (!exited)
+        {
+            Json message;
+            if (!read(message))
+            {
+                break;
+            }
+
+            auto start = std::chrono::steady_clock::now();
+            handle(message);
+            std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+            if (message["method"].as_string() == "textDocument/didChange")
+            {
+                latencies.push_back(elapsed.count());
+            }
+        }
+
+        if (!latencies.empty())
+        {
+            std::sort(latencies.begin(), latencies.end());
+            auto percentile = [&latencies](double p)
+            {
+                return latencies[std::min(latencies.size() - 1,
+                                          static_cast<size_t>(p * latencies.size()))];
+            };
+
+            report << variadic_string("changes: %zu p50: %.2fms p99: %.2fms max: %.2fms\n",
+                                      latencies.size(), percentile(0.50),
+                                      percentile(0.99), latencies.back());
+        }
+
+        return 0;
+    }
+}
@@ -0,0 +1,76 @@
+#ifndef CC_LSP_SERVER_H
+#define CC_LSP_SERVER_H
+
+#include <iostream>
+#include <map>
+#include <memory>
+#include <vector>
+#include "document.h"
+#include <common/json.h>
+
+namespace cc
+{
+    class LanguageServer
+    {
+        /**
+         * Language Server Protocol over a pair of streams.
+         *
+         * Supports document synchronisation (full and incremental)
+         * and publishes the diagnostics of the parse and resolution
+         * passes after every change.
+         */
+
+        std::istream& in;
+        std::ostream& out;
+        bool framed;        //!< Content-Length headers, otherwise one message per line
+
+        Parser parser;
+        std::map<std::string, std::unique_ptr<Document>> documents;
+        bool shutdown_requested;
+        bool exited;
+
+        void send(const Json& message);
+        void reply(const Json& id, Json result);
+        void reply_error(const Json& id, int code, const std::string& message);
+        void publish(const Document* document);
+
+        void did_open(const Json& params);
+        void did_change(const Json& params);
+        void did_close(const Json& params);
+        void dispatch(const Json& message);
+
+    public:
+        /**
+         * @param framed false to exchange one JSON message per line,
+         *               used to replay recorded sessions
+         */
+        LanguageServer(std::istream& in, std::ostream& out, bool framed = true);
+
+        /**
+         * Read the next message
+         * @return false at the end of the input
+         * @throws Exception on malformed input
+         */
+        bool read(Json& message);
+
+        /**
+         * Serve a message, failed requests are answered with an internal
+         * error and failed notifications are logged to the client
+         */
+        void handle(const Json& message);
+
+        /**
+         * Serve until the client exits
+         * @return process exit code
+         */
+        int run();
+
+        /**
+         * Serve a recorded session and report the latency of each message
+         * @param report latency percentiles are written here
+         */
+        int replay(std::ostream& report);
+    };
+}
+
+#endif //CC_LSP_SERVER_H
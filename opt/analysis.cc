@@ -0,0 +1,575 @@
+#include "analysis.h"
+#include "utils.h"
+#include <algorithm>
+
+namespace cc
+{
+    BlockOrder::BlockOrder(Function* f, AnalysisManager&) :
+            blocks(function_blocks(f))
+    {
+        for (size_t i = 0; i < blocks.size(); i++)
+        {
+            index[blocks[i]] = i;
+        }
+    }
+
+    ControlFlow::ControlFlow(Function* f, AnalysisManager&)
+    {
+        std::vector<Block*> stack{f->get_entry_block()};
+        while (!stack.empty())
+        {
+            Block* block = stack.back();
+            stack.pop_back();
+            if (!reachable.insert(block).second)
+            {
+                continue;
+            }
+
+            for (Block* s : block->successors())
+            {
+                stack.push_back(s);
+            }
+        }
+    }
+
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+    DominatorTree::DominatorTree(Function* f, AnalysisManager&) :
+            number(f->get_block_bound(), NONE)
+    {
+
+        // Number the reachable blocks in depth first preorder, the
+        // stack keeps every block with the next successor to visit
+        std::vector<uint32_t> parent;
+        std::vector<std::pair<Block*, size_t>> stack;
+
+        nodes.reserve(f->get_block_bound());
+        parent.reserve(f->get_block_bound());
+
+        Block* entry = f->get_entry_block();
+        number[entry->get_index()] = 0;
+        nodes.push_back({entry, 0, 0, 0, 0, {}});
+        parent.push_back(NONE);
+        stack.emplace_back(entry, 0);
+
+        while (!stack.empty())
+        {
+            auto& top = stack.back();
+            const std::vector<Block*>& successors = top.first->successors();
+            if (top.second == successors.size())
+            {
+                stack.pop_back();
+                continue;
+            }
+
+            Block* s = successors[top.second++];
+            uint32_t& s_number = number[s->get_index()];
+            if (s_number == NONE)
+            {
+                s_number = nodes.size();
+                parent.push_back(number[top.first->get_index()]);
+                nodes.push_back({s, 0, 0, 0, 0, {}});
+                stack.emplace_back(s, 0);
+            }
+        }
+
+        // Semidominators, Lengauer-Tarjan with simple path compression.
+        // A vertex gets an ancestor once it is processed, the label of a
+        // vertex is the vertex of minimal semidominator on its path up
+        // the processed forest.
+        auto n = static_cast<uint32_t>(nodes.size());
+        std::vector<uint32_t> semi(n), label(n), ancestor(n, NONE);
+        std::vector<uint32_t> path;
+        for (uint32_t i = 0; i < n; i++)
+        {
+            semi[i] = i;
+            label[i] = i;
+        }
+
+        auto eval = [&](uint32_t v) -> uint32_t
+        {
+            if (ancestor[v] == NONE)
+            {
+                return v;
+            }
+
+            // Compress the path from v up to the root of its tree,
+            // starting next to the root
+            for (uint32_t u = v; ancestor[ancestor[u]] != NONE; u = ancestor[u])
+            {
+                path.push_back(u);
+            }
+
+            while (!path.empty())
+            {
+                uint32_t u = path.back();
+                path.pop_back();
+
+                uint32_t a = ancestor[u];
+                if (semi[label[a]] < semi[label[u]])
+                {
+                    label[u] = label[a];
+                }
+                ancestor[u] = ancestor[a];
+            }
+
+            return label[v];
+        };
+
+        for (uint32_t w = n - 1; w > 0; w--)
+        {
+            for (const Block* p : nodes[w].block->predecessors())
+            {
+                uint32_t v = number[p->get_index()];
+                if (v == NONE)
+                {
+                    continue;
+                }
+
+                uint32_t u = eval(v);
+                if (semi[u] < semi[w])
+                {
+                    semi[w] = semi[u];
+                }
+            }
+
+            ancestor[w] = parent[w];
+        }
+
+        // The immediate dominator is the nearest common ancestor of the
+        // parent and the semidominator, found by walking up from the
+        // parent since its ancestors already have their idom
+        nodes[0].idom = NONE;
+        nodes[0].depth = 0;
+        for (uint32_t w = 1; w < n; w++)
+        {
+            uint32_t idom = parent[w];
+            while (idom > semi[w])
+            {
+                idom = nodes[idom].idom;
+            }
+
+            nodes[w].idom = idom;
+            nodes[w].depth = nodes[idom].depth + 1;
+            nodes[idom].children.push_back(nodes[w].block);
+        }
+
+        // Pre and postorder of the dominator tree
+        uint32_t clock = 0;
+        std::vector<std::pair<uint32_t, size_t>> tree_stack{{0, 0}};
+        nodes[0].in = clock++;
+        while (!tree_stack.empty())
+        {
+            auto& top = tree_stack.back();
+            Node& current = nodes[top.first];
+            if (top.second == current.children.size())
+            {
+                current.out = clock++;
+                tree_stack.pop_back();
+                continue;
+            }
+
+            uint32_t child = number[current.children[top.second++]->get_index()];
+            nodes[child].in = clock++;
+            tree_stack.emplace_back(child, 0);
+        }
+    }
+
+    const DominatorTree::Node* DominatorTree::node(const Block* block) const
+    {
+        assert(block->get_index() < number.size());
+        uint32_t n = number[block->get_index()];
+        return n == NONE ? nullptr : &nodes[n];
+    }
+
+    Block* DominatorTree::get_idom(const Block* block) const
+    {
+        const Node* n = node(block);
+        return n && n->idom != NONE ? nodes[n->idom].block : nullptr;
+    }
+
+    const std::vector<Block*>& DominatorTree::get_children(const Block* block) const
+    {
+        static const std::vector<Block*> none;
+        const Node* n = node(block);
+        return n ? n->children : none;
+    }
+
+    bool DominatorTree::dominates(const Block* a, const Block* b) const
+    {
+        const Node* na = node(a);
+        const Node* nb = node(b);
+        return na && nb && na->in <= nb->in && nb->out <= na->out;
+    }
+
+    Block* DominatorTree::common_dominator(const Block* a, const Block* b) const
+    {
+        const Node* na = node(a);
+        const Node* nb = node(b);
+        if (!na || !nb)
+        {
+            return nullptr;
+        }
+
+        while (na->depth > nb->depth)
+        {
+            na = &nodes[na->idom];
+        }
+
+        while (nb->depth > na->depth)
+        {
+            nb = &nodes[nb->idom];
+        }
+
+        while (na != nb)
+        {
+            na = &nodes[na->idom];
+            nb = &nodes[nb->idom];
+        }
+
+        return na->block;
+    }
+
+    std::vector<Block*> DominatorTree::get_blocks() const
+    {
+        std::vector<Block*> out;
+        out.reserve(nodes.size());
+        for (const Node& n : nodes)
+        {
+            out.push_back(n.block);
+        }
+
+        return out;
+    }
+
+    DominanceFrontier::DominanceFrontier(Function* f, AnalysisManager& am) :
+            frontiers(f->get_block_bound())
+    {
+        const DominatorTree& dt = am.get<DominatorTree>(f);
+
+        // Cooper, Harvey and Kennedy: walk up from every predecessor of
+        // a join until reaching its immediate dominator, the join is in
+        // the frontier of every block on the way
+        for (Block* join : dt.get_blocks())
+        {
+            // Walks from the predecessor of a block with a single one stop
+            // right away, unless the block is the entry
+            Block* idom = dt.get_idom(join);
+            for (Block* p : join->predecessors())
+            {
+                if (!dt.is_reachable(p))
+                {
+                    continue;
+                }
+
+                for (Block* runner = p; runner != idom; runner = dt.get_idom(runner))
+                {
+                    std::vector<Block*>& frontier = frontiers[runner->get_index()];
+                    if (!frontier.empty() && frontier.back() == join)
+                    {
+                        // Reached through another predecessor already
+                        break;
+                    }
+
+                    frontier.push_back(join);
+                }
+            }
+        }
+    }
+
+    const std::vector<Block*>& DominanceFrontier::get(const Block* block) const
+    {
+        assert(block->get_index() < frontiers.size());
+        return frontiers[block->get_index()];
+    }
+
+    bool NaturalLoop::contains(const Block* block) const
+    {
+        return contains(info->get_loop(block));
+    }
+
+    bool NaturalLoop::contains(const NaturalLoop* loop) const
+    {
+        for (; loop; loop = loop->parent)
+        {
+            if (loop == this)
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    LoopInfo::LoopInfo(Function* f, AnalysisManager& am) :
+            innermost(f->get_block_bound(), nullptr), irreducible(false)
+    {
+        const DominatorTree& dt = am.get<DominatorTree>(f);
+        std::vector<Block*> preorder = dt.get_blocks();
+        std::vector<uint32_t> number(f->get_block_bound());
+        for (uint32_t i = 0; i < preorder.size(); i++)
+        {
+            number[preorder[i]->get_index()] = i;
+        }
+
+        // Headers are visited in postorder of the dominator tree so that
+        // inner loops are built before the loops containing them
+        std::vector<Block*> postorder;
+        std::vector<std::pair<Block*, size_t>> stack{{preorder[0], 0}};
+        while (!stack.empty())
+        {
+            auto& top = stack.back();
+            const std::vector<Block*>& children = dt.get_children(top.first);
+            if (top.second == children.size())
+            {
+                postorder.push_back(top.first);
+                stack.pop_back();
+                continue;
+            }
+
+            Block* child = children[top.second++];
+            stack.emplace_back(child, 0);
+        }
+
+        std::vector<Block*> work;
+        for (Block* header : postorder)
+        {
+            for (Block* p : header->predecessors())
+            {
+                if (dt.dominates(header, p))
+                {
+                    work.push_back(p);
+                }
+            }
+
+            if (work.empty())
+            {
+                continue;
+            }
+
+            loops.emplace_back(new NaturalLoop(this, header));
+            NaturalLoop* loop = loops.back().get();
+            innermost[header->get_index()] = loop;
+
+            // Walk the CFG backwards from the latches up to the header,
+            // loops found on the way become children of this one
+            while (!work.empty())
+            {
+                Block* block = work.back();
+                work.pop_back();
+
+                NaturalLoop* sub = innermost[block->get_index()];
+                if (!sub)
+                {
+                    innermost[block->get_index()] = loop;
+                    for (Block* p : block->predecessors())
+                    {
+                        if (dt.is_reachable(p))
+                        {
+                            work.push_back(p);
+                        }
+                    }
+                    continue;
+                }
+
+                while (sub->parent)
+                {
+                    sub = sub->parent;
+                }
+
+                if (sub == loop)
+                {
+                    continue;
+                }
+
+                // Continue from the entries of the inner loop
+                sub->parent = loop;
+                loop->children.push_back(sub);
+                for (Block* p : sub->header->predecessors())
+                {
+                    if (dt.is_reachable(p) && !dt.dominates(sub->header, p))
+                    {
+                        work.push_back(p);
+                    }
+                }
+            }
+        }
+
+        // Postorder puts inner loops first, the tree itself is
+        // kept in preorder of the headers
+        auto by_header = [&](const NaturalLoop* a, const NaturalLoop* b)
+        {
+            return number[a->header->get_index()] < number[b->header->get_index()];
+        };
+
+        for (auto& loop : loops)
+        {
+            std::sort(loop->children.begin(), loop->children.end(), by_header);
+            if (!loop->parent)
+            {
+                top_level.push_back(loop.get());
+            }
+        }
+        std::sort(top_level.begin(), top_level.end(), by_header);
+
+        for (auto iter = loops.rbegin(); iter != loops.rend(); ++iter)
+        {
+            NaturalLoop* loop = iter->get();
+            loop->depth = loop->parent ? loop->parent->depth + 1 : 1;
+        }
+
+        for (Block* block : preorder)
+        {
+            for (NaturalLoop* loop = innermost[block->get_index()]; loop; loop = loop->parent)
+            {
+                loop->blocks.push_back(block);
+            }
+        }
+
+        // Last loop a block was recorded as a latch or an exit of
+        std::vector<const NaturalLoop*> latch_of(f->get_block_bound(), nullptr);
+        std::vector<const NaturalLoop*> exit_of(f->get_block_bound(), nullptr);
+        for (auto& loop : loops)
+        {
+            Block* outside = nullptr;
+            unsigned outside_n = 0;
+            for (Block* p : loop->header->predecessors())
+            {
+                if (loop->contains(p))
+                {
+                    if (latch_of[p->get_index()] != loop.get())
+                    {
+                        latch_of[p->get_index()] = loop.get();
+                        loop->latches.push_back(p);
+                    }
+                }
+                else if (dt.is_reachable(p) && p != outside)
+                {
+                    outside = p;
+                    outside_n++;
+                }
+            }
+
+            if (outside_n == 1 && outside->successors().size() == 1)
+            {
+                loop->preheader = outside;
+            }
+
+            for (Block* block : loop->blocks)
+            {
+                for (Block* s : block->successors())
+                {
+                    if (exit_of[s->get_index()] != loop.get() && !loop->contains(s))
+                    {
+                        exit_of[s->get_index()] = loop.get();
+                        loop->exits.push_back(s);
+                    }
+                }
+            }
+        }
+
+        // A retreating edge of the depth first search which is not a
+        // back edge enters a cycle somewhere else than at its header
+        std::vector<char> on_stack(f->get_block_bound(), 0);
+        std::vector<char> visited(f->get_block_bound(), 0);
+        std::vector<std::pair<Block*, size_t>> dfs{{preorder[0], 0}};
+        on_stack[preorder[0]->get_index()] = visited[preorder[0]->get_index()] = 1;
+        while (!dfs.empty() && !irreducible)
+        {
+            auto& top = dfs.back();
+            const std::vector<Block*>& successors = top.first->successors();
+            if (top.second == successors.size())
+            {
+                on_stack[top.first->get_index()] = 0;
+                dfs.pop_back();
+                continue;
+            }
+
+            Block* source = top.first;
+            Block* s = successors[top.second++];
+            if (on_stack[s->get_index()])
+            {
+                irreducible = !dt.dominates(s, source);
+            }
+            else if (!visited[s->get_index()])
+            {
+                visited[s->get_index()] = on_stack[s->get_index()] = 1;
+                dfs.emplace_back(s, 0);
+            }
+        }
+    }
+
+    NaturalLoop* LoopInfo::get_loop(const Block* block) const
+    {
+        assert(block->get_index() < innermost.size());
+        return innermost[block->get_index()];
+    }
+
+    unsigned LoopInfo::get_depth(const Block* block) const
+    {
+        NaturalLoop* loop = get_loop(block);
+        return loop ? loop->get_depth() : 0;
+    }
+
+    bool LoopInfo::is_header(const Block* block) const
+    {
+        NaturalLoop* loop = get_loop(block);
+        return loop && loop->get_header() == block;
+    }
+
+    std::vector<NaturalLoop*> LoopInfo::get_loops() const
+    {
+        std::vector<NaturalLoop*> out;
+        out.reserve(loops.size());
+        for (const auto& loop : loops)
+        {
+            out.push_back(loop.get());
+        }
+
+        return out;
+    }
+
+    void AnalysisManager::invalidate(const Function* f, unsigned changed)
+    {
+        auto f_iter = cache.find(f);
+        if (f_iter == cache.end())
+        {
+            return;
+        }
+
+        for (auto& iter : f_iter->second)
+        {
+            if (iter.second.result && (iter.second.depends & changed))
+            {
+                iter.second.result.reset();
+                stats[iter.first].invalidations++;
+            }
+        }
+    }
+
+    void AnalysisManager::clear(const Function* f)
+    {
+        cache.erase(f);
+    }
+
+    void AnalysisManager::merge_statistics(const AnalysisManager& other)
+    {
+        for (const auto& iter : other.stats)
+        {
+            Statistics& s = stats[iter.first];
+            s.hits += iter.second.hits;
+            s.misses += iter.second.misses;
+            s.invalidations += iter.second.invalidations;
+        }
+    }
+
+    void AnalysisManager::print_statistics(std::ostream& os) const
+    {
+        os << variadic_string("%-16s %8s %8s %8s\n", "analysis", "hits", "misses", "dropped");
+        for (const auto& iter : stats)
+        {
+            os << variadic_string("%-16s %8lu %8lu %8lu\n", iter.first.c_str(),
+                                  iter.second.hits, iter.second.misses, iter.second.invalidations);
+        }
+    }
+}
@@ -0,0 +1,361 @@
+#ifndef CC_ANALYSIS_H
+#define CC_ANALYSIS_H
+
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <compilation/instruction.h>
+#include <compilation/module.h>
+
+namespace cc
+{
+    class AnalysisManager;
+
+    struct FunctionAnalysis
+    {
+        /**
+         * Result of an analysis over the IR of a function.
+         *
+         * Every analysis declares a NAME and the parts of the IR it is
+         * computed from (DEPENDS), it is dropped from the cache when a
+         * pass reports a change to one of them. Analyses built from other
+         * analyses must depend on everything their inputs depend on.
+         * Changes to loads, stores and calls are reported as both
+         * INSTRUCTIONS and MEMORY.
+         */
+
+        enum depends_t
+        {
+            INSTRUCTIONS = 1 << 0,  //!< Instructions added, erased or rewritten
+            CFG = 1 << 1,           //!< Blocks and terminators
+            MEMORY = 1 << 2,        //!< Loads, stores and calls added, erased or rewritten
+            ALL = INSTRUCTIONS | CFG | MEMORY
+        };
+
+        virtual ~FunctionAnalysis() = default;
+    };
+
+    struct BlockOrder : public FunctionAnalysis
+    {
+        /**
+         * Blocks of the function in layout order
+         */
+
+        static constexpr const char* NAME = "block-order";
+        static constexpr unsigned DEPENDS = CFG;
+
+        std::vector<Block*> blocks;
+        std::unordered_map<const Block*, size_t> index;
+
+        BlockOrder(Function* f, AnalysisManager& am);
+    };
+
+    struct ControlFlow : public FunctionAnalysis
+    {
+        /**
+         * Blocks reachable from the entry, the edges
+         * themselves are kept by the blocks
+         */
+
+        static constexpr const char* NAME = "control-flow";
+        static constexpr unsigned DEPENDS = CFG;
+
+        std::unordered_set<const Block*> reachable;
+
+        ControlFlow(Function* f, AnalysisManager& am);
+        bool is_reachable(const Block* block) const { return reachable.find(block) != reachable.end(); }
+    };
+
+    struct DominatorTree : public FunctionAnalysis
+    {
+        /**
+         * Immediate dominators of the blocks reachable from the entry,
+         * computed with the semi-NCA algorithm in O(n log n) over the
+         * depth first spanning tree of the CFG. Blocks are numbered in
+         * preorder and postorder of the dominator tree so that
+         * dominance is answered in constant time.
+         *
+         * Unreachable blocks are not part of the tree, they neither
+         * dominate nor are dominated by any block.
+         */
+
+        static constexpr const char* NAME = "dominators";
+        static constexpr unsigned DEPENDS = CFG;
+
+        DominatorTree(Function* f, AnalysisManager& am);
+
+        bool is_reachable(const Block* block) const { return node(block) != nullptr; }
+
+        /**
+         * @return nullptr for the entry and unreachable blocks
+         */
+        Block* get_idom(const Block* block) const;
+        const std::vector<Block*>& get_children(const Block* block) const;
+
+        /**
+         * Every path from the entry to b goes through a,
+         * a block dominates itself
+         */
+        bool dominates(const Block* a, const Block* b) const;
+        bool strictly_dominates(const Block* a, const Block* b) const { return a != b && dominates(a, b); }
+
+        /**
+         * Deepest block dominating both a and b,
+         * nullptr if one of them is unreachable
+         */
+        Block* common_dominator(const Block* a, const Block* b) const;
+
+        /**
+         * Reachable blocks in depth first preorder of the CFG,
+         * the entry comes first
+         */
+        std::vector<Block*> get_blocks() const;
+
+    private:
+        struct Node
+        {
+            Block* block;
+            uint32_t idom;      //!< CFG preorder number of the immediate dominator
+            uint32_t depth;     //!< In the dominator tree, 0 for the entry
+            uint32_t in;        //!< Dominator tree preorder
+            uint32_t out;       //!< Dominator tree postorder
+            std::vector<Block*> children;
+        };
+
+        std::vector<Node> nodes;        //!< Indexed by CFG preorder number
+        std::vector<uint32_t> number;   //!< Preorder number of each block index
+
+        const Node* node(const Block* block) const;
+    };
+
+    struct DominanceFrontier : public FunctionAnalysis
+    {
+        /**
+         * Blocks where the dominance of each block ends: the successors
+         * of the blocks it dominates that it does not strictly dominate
+         * itself. This is where phi nodes of the values defined in a
+         * block are placed.
+         */
+
+        static constexpr const char* NAME = "dominance-frontier";
+        static constexpr unsigned DEPENDS = CFG;
+
+        std::vector<std::vector<Block*>> frontiers;     //!< Indexed by block index
+
+        DominanceFrontier(Function* f, AnalysisManager& am);
+
+        /**
+         * Frontier of a block, empty for unreachable blocks
+         */
+        const std::vector<Block*>& get(const Block* block) const;
+    };
+
+    class LoopInfo;
+
+    class NaturalLoop
+    {
+        /**
+         * Natural loop: the header and every block reaching one of the
+         * latches (the sources of the back edges to the header) without
+         * going through the header. The header dominates all of them.
+         * Loops are nested in a tree, the blocks of a loop include the
+         * blocks of its children.
+         */
+
+        const LoopInfo* info;
+        Block* header;
+        Block* preheader;
+        NaturalLoop* parent;
+        unsigned depth;
+        std::vector<NaturalLoop*> children;
+        std::vector<Block*> blocks;
+        std::vector<Block*> latches;
+        std::vector<Block*> exits;
+
+        friend class LoopInfo;
+
+    public:
+        NaturalLoop(const LoopInfo* info, Block* header) :
+        info(info), header(header), preheader(nullptr), parent(nullptr), depth(0) {}
+
+        Block* get_header() const { return header; }
+
+        /**
+         * The only predecessor of the header outside the loop if it
+         * jumps to the header unconditionally, nullptr otherwise
+         */
+        Block* get_preheader() const { return preheader; }
+
+        /**
+         * @return nullptr for outermost loops
+         */
+        NaturalLoop* get_parent() const { return parent; }
+
+        /**
+         * Number of loops containing this one, itself included
+         */
+        unsigned get_depth() const { return depth; }
+        const std::vector<NaturalLoop*>& get_children() const { return children; }
+
+        /**
+         * Blocks of the loop in CFG preorder, the header first
+         */
+        const std::vector<Block*>& get_blocks() const { return blocks; }
+
+        /**
+         * Blocks of the loop branching back to the header
+         */
+        const std::vector<Block*>& get_latches() const { return latches; }
+
+        /**
+         * Blocks outside of the loop branched to from inside of it
+         */
+        const std::vector<Block*>& get_exits() const { return exits; }
+
+        bool contains(const Block* block) const;
+        bool contains(const NaturalLoop* loop) const;
+    };
+
+    class LoopInfo : public FunctionAnalysis
+    {
+        /**
+         * Loop tree of a function. Loops are found from the back edges
+         * (edges to a block dominating their source) in the CFG, whether
+         * they come from for and while statements or anything else.
+         * Cycles entered through more than one block have no header
+         * dominating them, they are irreducible and are not loops.
+         */
+
+        std::vector<std::unique_ptr<NaturalLoop>> loops;
+        std::vector<NaturalLoop*> top_level;
+        std::vector<NaturalLoop*> innermost;    //!< Indexed by block index
+        bool irreducible;
+
+    public:
+        static constexpr const char* NAME = "loops";
+        static constexpr unsigned DEPENDS = CFG;
+
+        LoopInfo(Function* f, AnalysisManager& am);
+
+        /**
+         * Innermost loop containing a block, nullptr outside of loops
+         */
+        NaturalLoop* get_loop(const Block* block) const;
+
+        /**
+         * Number of loops containing a block, 0 outside of loops
+         */
+        unsigned get_depth(const Block* block) const;
+        bool is_header(const Block* block) const;
+
+        /**
+         * Outermost loops in CFG preorder of their header
+         */
+        const std::vector<NaturalLoop*>& get_top_level() const { return top_level; }
+
+        /**
+         * Every loop, inner loops before the loops containing them
+         */
+        std::vector<NaturalLoop*> get_loops() const;
+
+        /**
+         * The CFG has a cycle without a dominating header
+         */
+        bool has_irreducible_cycles() const { return irreducible; }
+    };
+
+    class AnalysisManager
+    {
+        /**
+         * Lazily computes and caches the analyses of every function.
+         * Results stay cached until a change they depend on is reported
+         * through invalidate() or the function is forgotten with clear().
+         */
+
+    public:
+        struct Statistics
+        {
+            uint64_t hits;
+            uint64_t misses;            //!< Computations
+            uint64_t invalidations;
+        };
+
+    private:
+        struct Cached
+        {
+            std::unique_ptr<FunctionAnalysis> result;
+            unsigned depends;
+        };
+
+        std::unordered_map<const Function*, std::map<std::string, Cached>> cache;
+        std::map<std::string, Statistics> stats;
+
+    public:
+        AnalysisManager() = default;
+        AnalysisManager(const AnalysisManager&) = delete;
+        AnalysisManager& operator=(const AnalysisManager&) = delete;
+
+        /**
+         * Get an analysis of a function, computing it if needed.
+         * The reference is valid until the analysis is invalidated.
+         */
+        template<typename T>
+        T& get(Function* f)
+        {
+            Statistics& s = stats[T::NAME];
+            Cached& entry = cache[f][T::NAME];
+            if (entry.result)
+            {
+                s.hits++;
+                return static_cast<T&>(*entry.result);
+            }
+
+            s.misses++;
+            T* result = new T(f, *this);
+            entry.result.reset(result);
+            entry.depends = T::DEPENDS;
+            return *result;
+        }
+
+        /**
+         * Get an analysis only if it is already computed
+         */
+        template<typename T>
+        T* get_cached(const Function* f) const
+        {
+            auto f_iter = cache.find(f);
+            if (f_iter == cache.end())
+            {
+                return nullptr;
+            }
+
+            auto iter = f_iter->second.find(T::NAME);
+            return iter == f_iter->second.end() ? nullptr : static_cast<T*>(iter->second.result.get());
+        }
+
+        /**
+         * Drop the analyses of a function depending on what changed
+         * @param changed mask of FunctionAnalysis::depends_t
+         */
+        void invalidate(const Function* f, unsigned changed);
+
+        /**
+         * Forget every analysis of a function
+         */
+        void clear(const Function* f);
+
+        const std::map<std::string, Statistics>& get_statistics() const { return stats; }
+
+        /**
+         * Add the statistics of another manager to these
+         */
+        void merge_statistics(const AnalysisManager& other);
+        void print_statistics(std::ostream& os) const;
+    };
+}
+
+#endif //CC_ANALYSIS_H
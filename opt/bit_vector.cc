@@ -0,0 +1,239 @@
+#include "bit_vector.h"
+
+#include <algorithm>
+#include <cassert>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CC_BIT_VECTOR_AVX2
+#endif
+
+namespace cc
+{
+    // Every kernel applies an operation to the n words of a
+    // set in place and reports whether one of them changed
+    typedef bool (*kernel_t)(uint64_t* a, const uint64_t* b, size_t n);
+
+    static bool unite_words(uint64_t* a, const uint64_t* b, size_t n)
+    {
+        uint64_t changed = 0;
+        for (size_t i = 0; i < n; i++)
+        {
+            uint64_t w = a[i] | b[i];
+            changed |= w ^ a[i];
+            a[i] = w;
+        }
+
+        return changed != 0;
+    }
+
+    static bool intersect_words(uint64_t* a, const uint64_t* b, size_t n)
+    {
+        uint64_t changed = 0;
+        for (size_t i = 0; i < n; i++)
+        {
+            uint64_t w = a[i] & b[i];
+            changed |= w ^ a[i];
+            a[i] = w;
+        }
+
+        return changed != 0;
+    }
+
+    static bool subtract_words(uint64_t* a, const uint64_t* b, size_t n)
+    {
+        uint64_t changed = 0;
+        for (size_t i = 0; i < n; i++)
+        {
+            uint64_t w = a[i] & ~b[i];
+            changed |= w ^ a[i];
+            a[i] = w;
+        }
+
+        return changed != 0;
+    }
+
+#ifdef CC_BIT_VECTOR_AVX2
+    // Built for AVX2 regardless of the flags of the rest of the
+    // compiler, only called once the processor is known to have it
+
+    __attribute__((target("avx2")))
+    static bool unite_words_avx2(uint64_t* a, const uint64_t* b, size_t n)
+    {
+        __m256i changed = _mm256_setzero_si256();
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4)
+        {
+            __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+            __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+            __m256i w = _mm256_or_si256(x, y);
+            changed = _mm256_or_si256(changed, _mm256_xor_si256(w, x));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(a + i), w);
+        }
+
+        bool tail = unite_words(a + i, b + i, n - i);
+        return !_mm256_testz_si256(changed, changed) || tail;
+    }
+
+    __attribute__((target("avx2")))
+    static bool intersect_words_avx2(uint64_t* a, const uint64_t* b, size_t n)
+    {
+        __m256i changed = _mm256_setzero_si256();
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4)
+        {
+            __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+            __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+            __m256i w = _mm256_and_si256(x, y);
+            changed = _mm256_or_si256(changed, _mm256_xor_si256(w, x));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(a + i), w);
+        }
+
+        bool tail = intersect_words(a + i, b + i, n - i);
+        return !_mm256_testz_si256(changed, changed) || tail;
+    }
+
+    __attribute__((target("avx2")))
+    static bool subtract_words_avx2(uint64_t* a, const uint64_t* b, size_t n)
+    {
+        __m256i changed = _mm256_setzero_si256();
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4)
+        {
+            __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+            __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+            __m256i w = _mm256_andnot_si256(y, x);
+            changed = _mm256_or_si256(changed, _mm256_xor_si256(w, x));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(a + i), w);
+        }
+
+        bool tail = subtract_words(a + i, b + i, n - i);
+        return !_mm256_testz_si256(changed, changed) || tail;
+    }
+#endif
+
+    struct Kernels
+    {
+        kernel_t unite;
+        kernel_t intersect;
+        kernel_t subtract;
+    };
+
+    static const Kernels& kernels()
+    {
+        static const Kernels selected = []() -> Kernels
+        {
+#ifdef CC_BIT_VECTOR_AVX2
+            if (__builtin_cpu_supports("avx2"))
+            {
+                return {unite_words_avx2, intersect_words_avx2, subtract_words_avx2};
+            }
+#endif
+            return {unite_words, intersect_words, subtract_words};
+        }();
+
+        return selected;
+    }
+
+    // Sets smaller than a vector are not worth the indirect call
+    static constexpr size_t VECTOR_WORDS = 4;
+
+    BitVector::BitVector(size_t size) :
+            words((size + 63) / 64, 0), bits(size)
+    {
+    }
+
+    void BitVector::clear_tail()
+    {
+        if (bits % 64)
+        {
+            words.back() &= (uint64_t(1) << (bits % 64)) - 1;
+        }
+    }
+
+    void BitVector::clear()
+    {
+        std::fill(words.begin(), words.end(), 0);
+    }
+
+    void BitVector::fill()
+    {
+        std::fill(words.begin(), words.end(), ~uint64_t(0));
+        clear_tail();
+    }
+
+    bool BitVector::none() const
+    {
+        for (uint64_t w : words)
+        {
+            if (w)
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    size_t BitVector::count() const
+    {
+        size_t n = 0;
+        for (uint64_t w : words)
+        {
+            n += __builtin_popcountll(w);
+        }
+
+        return n;
+    }
+
+    size_t BitVector::find_next(size_t i) const
+    {
+        if (i >= bits)
+        {
+            return bits;
+        }
+
+        size_t word = i / 64;
+        uint64_t w = words[word] & (~uint64_t(0) << (i % 64));
+        while (!w)
+        {
+            if (++word == words.size())
+            {
+                return bits;
+            }
+
+            w = words[word];
+        }
+
+        return word * 64 + __builtin_ctzll(w);
+    }
+
+    bool BitVector::unite(const BitVector& other)
+    {
+        assert(bits == other.bits);
+        return words.size() < VECTOR_WORDS
+               ? unite_words(words.data(), other.words.data(), words.size())
+               : kernels().unite(words.data(), other.words.data(), words.size());
+    }
+
+    bool BitVector::intersect(const BitVector& other)
+    {
+        assert(bits == other.bits);
+        return words.size() < VECTOR_WORDS
+               ? intersect_words(words.data(), other.words.data(), words.size())
+               : kernels().intersect(words.data(), other.words.data(), words.size());
+    }
+
+    bool BitVector::subtract(const BitVector& other)
+    {
+        assert(bits == other.bits);
+        return words.size() < VECTOR_WORDS
+               ? subtract_words(words.data(), other.words.data(), words.size())
+               : kernels().subtract(words.data(), other.words.data(), words.size());
+    }
+
+    bool BitVector::operator==(const BitVector& other) const
+    {
+        return bits == other.bits && words == other.words;
+    }
+}
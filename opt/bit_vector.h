@@ -0,0 +1,60 @@
+#ifndef CC_OPT_BIT_VECTOR_H
+#define CC_OPT_BIT_VECTOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace cc
+{
+    class BitVector
+    {
+        /**
+         * Dense set of the integers below a fixed size, one bit each.
+         * Set operations work on whole words, four at a time with AVX2
+         * when the processor supports it. Bits past the size are always
+         * clear so that words compare and count directly.
+         */
+
+        std::vector<uint64_t> words;
+        size_t bits;
+
+        void clear_tail();
+
+    public:
+        explicit BitVector(size_t size = 0);
+
+        size_t size() const { return bits; }
+
+        bool test(size_t i) const { return words[i / 64] >> (i % 64) & 1; }
+        void set(size_t i) { words[i / 64] |= uint64_t(1) << (i % 64); }
+        void reset(size_t i) { words[i / 64] &= ~(uint64_t(1) << (i % 64)); }
+
+        /**
+         * Remove or add every integer below the size
+         */
+        void clear();
+        void fill();
+
+        bool none() const;
+        size_t count() const;
+
+        /**
+         * First integer of the set not below i, size() if there is none
+         */
+        size_t find_next(size_t i) const;
+
+        /**
+         * Set operations with a set of the same size
+         * @return true if this set changed
+         */
+        bool unite(const BitVector& other);
+        bool intersect(const BitVector& other);
+        bool subtract(const BitVector& other);
+
+        bool operator==(const BitVector& other) const;
+        bool operator!=(const BitVector& other) const { return !(*this == other); }
+    };
+}
+
+#endif //CC_OPT_BIT_VECTOR_H
@@ -0,0 +1,405 @@
+#include "dataflow.h"
+#include "utils.h"
+
+#include <algorithm>
+
+namespace cc
+{
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+    Dataflow::Dataflow(Function* f, direction_t direction, meet_t meet, size_t bits) :
+            direction(direction), meet(meet), bits(bits),
+            position(f->get_block_bound(), NONE),
+            gen_(f->get_block_bound(), BitVector(bits)),
+            kill_(f->get_block_bound(), BitVector(bits)),
+            in_(f->get_block_bound(), BitVector(bits)),
+            out_(f->get_block_bound(), BitVector(bits)),
+            boundary_(bits), visits(0)
+    {
+        // Depth first postorder of the reachable blocks, the stack
+        // keeps every block with the next successor to visit
+        std::vector<std::pair<Block*, size_t>> stack;
+        std::vector<bool> visited(f->get_block_bound(), false);
+
+        Block* entry = f->get_entry_block();
+        visited[entry->get_index()] = true;
+        stack.emplace_back(entry, 0);
+        while (!stack.empty())
+        {
+            auto& top = stack.back();
+            const std::vector<Block*>& successors = top.first->successors();
+            if (top.second == successors.size())
+            {
+                order.push_back(top.first);
+                stack.pop_back();
+                continue;
+            }
+
+            Block* s = successors[top.second++];
+            if (!visited[s->get_index()])
+            {
+                visited[s->get_index()] = true;
+                stack.emplace_back(s, 0);
+            }
+        }
+
+        std::reverse(order.begin(), order.end());
+        for (uint32_t i = 0; i < order.size(); i++)
+        {
+            position[order[i]->get_index()] = i;
+        }
+    }
+
+    BitVector& Dataflow::gen(const Block* block)
+    {
+        assert(block->get_index() < gen_.size());
+        return gen_[block->get_index()];
+    }
+
+    BitVector& Dataflow::kill(const Block* block)
+    {
+        assert(block->get_index() < kill_.size());
+        return kill_[block->get_index()];
+    }
+
+    const BitVector& Dataflow::get_in(const Block* block) const
+    {
+        assert(block->get_index() < in_.size());
+        return in_[block->get_index()];
+    }
+
+    const BitVector& Dataflow::get_out(const Block* block) const
+    {
+        assert(block->get_index() < out_.size());
+        return out_[block->get_index()];
+    }
+
+    void Dataflow::solve()
+    {
+        bool forward = direction == FORWARD;
+        auto n = static_cast<uint32_t>(order.size());
+
+        // Worklist positions follow the direction of the flow
+        auto block_at = [&](uint32_t k) { return order[forward ? k : n - 1 - k]; };
+        auto worklist_position = [&](const Block* block)
+        {
+            uint32_t p = position[block->get_index()];
+            return forward ? p : n - 1 - p;
+        };
+
+        BitVector top(bits);
+        if (meet == INTERSECTION)
+        {
+            top.fill();
+        }
+
+        for (Block* block : order)
+        {
+            in_[block->get_index()] = top;
+            out_[block->get_index()] = top;
+        }
+
+        BitVector pending(n);
+        pending.fill();
+
+        BitVector result(bits);
+        visits = 0;
+
+        // Sweep the pending blocks in order, changes to blocks already
+        // passed are picked up by the next sweep
+        auto next = [&](size_t from)
+        {
+            size_t k = pending.find_next(from);
+            return k < n ? k : pending.find_next(0);
+        };
+
+        for (size_t k = next(0); k < n; k = next(k + 1))
+        {
+            Block* block = block_at(k);
+            pending.reset(k);
+            visits++;
+
+            uint32_t i = block->get_index();
+            BitVector& met = forward ? in_[i] : out_[i];
+            BitVector& transferred = forward ? out_[i] : in_[i];
+
+            bool first = true;
+            auto combine = [&](const BitVector& set)
+            {
+                if (first)
+                {
+                    met = set;
+                    first = false;
+                }
+                else if (meet == UNION)
+                {
+                    met.unite(set);
+                }
+                else
+                {
+                    met.intersect(set);
+                }
+            };
+
+            if (forward)
+            {
+                if (k == 0)
+                {
+                    combine(boundary_);
+                }
+
+                for (const Block* p : block->predecessors())
+                {
+                    if (position[p->get_index()] != NONE)
+                    {
+                        combine(out_[p->get_index()]);
+                    }
+                }
+            }
+            else
+            {
+                if (block->successors().empty())
+                {
+                    combine(boundary_);
+                }
+
+                for (const Block* s : block->successors())
+                {
+                    combine(in_[s->get_index()]);
+                }
+            }
+
+            result = met;
+            result.subtract(kill_[i]);
+            result.unite(gen_[i]);
+            if (result == transferred)
+            {
+                continue;
+            }
+
+            std::swap(result, transferred);
+            for (const Block* d : forward ? block->successors() : block->predecessors())
+            {
+                if (position[d->get_index()] != NONE)
+                {
+                    pending.set(worklist_position(d));
+                }
+            }
+        }
+    }
+
+
+    // Variables are their allocation, values the instructions with a
+    // result: everything but stores, terminators and void calls
+    static bool is_value(const Instruction* instruction)
+    {
+        if (dynamic_cast<const StoreInstr*>(instruction) || is_terminator(instruction))
+        {
+            return false;
+        }
+
+        const Type* type = instruction->get_type(nullptr);
+        return !type || type->get_primitive() != Type::VOID;
+    }
+
+    static std::vector<const IR*> number_values(Function* f)
+    {
+        std::vector<const IR*> values;
+        std::vector<Block*> blocks = function_blocks(f);
+        for (Block* block : blocks)
+        {
+            for (Instruction* instruction : *block)
+            {
+                if (dynamic_cast<const AllocaInstr*>(instruction))
+                {
+                    values.push_back(as_value(instruction));
+                }
+            }
+        }
+
+        for (Block* block : blocks)
+        {
+            for (Instruction* instruction : *block)
+            {
+                if (!dynamic_cast<const AllocaInstr*>(instruction) && is_value(instruction))
+                {
+                    values.push_back(instruction);
+                }
+            }
+        }
+
+        return values;
+    }
+
+    Liveness::Liveness(Function* f, AnalysisManager&) :
+            values(number_values(f)),
+            dataflow(f, Dataflow::BACKWARD, Dataflow::UNION, values.size())
+    {
+        for (uint32_t i = 0; i < values.size(); i++)
+        {
+            number[values[i]] = i;
+        }
+
+        // Walk every block backwards: definitions end the liveness of
+        // what they define, uses start it
+        for (Block* block : dataflow.get_order())
+        {
+            BitVector& gen = dataflow.gen(block);
+            BitVector& kill = dataflow.kill(block);
+            for (auto iter = block->end(); iter != block->begin();)
+            {
+                Instruction* instruction = *--iter;
+                const auto* store = dynamic_cast<const StoreInstr*>(instruction);
+                if (store)
+                {
+                    uint32_t n = get_number(store->address);
+                    if (n != NONE)
+                    {
+                        kill.set(n);
+                        gen.reset(n);
+                    }
+                }
+                else if (!dynamic_cast<const AllocaInstr*>(instruction) && is_value(instruction))
+                {
+                    uint32_t n = get_number(instruction);
+                    kill.set(n);
+                    gen.reset(n);
+                }
+
+                for_each_operand(instruction, [&](Use& use)
+                {
+                    uint32_t n = get_number(use);
+                    if (n != NONE && !(store && &use == &store->address))
+                    {
+                        gen.set(n);
+                    }
+                });
+            }
+        }
+
+        dataflow.solve();
+    }
+
+    uint32_t Liveness::get_number(const IR* value) const
+    {
+        auto iter = number.find(value);
+        return iter == number.end() ? NONE : iter->second;
+    }
+
+    bool Liveness::is_live_in(const IR* value, const Block* block) const
+    {
+        uint32_t n = get_number(value);
+        return n != NONE && get_live_in(block).test(n);
+    }
+
+    bool Liveness::is_live_out(const IR* value, const Block* block) const
+    {
+        uint32_t n = get_number(value);
+        return n != NONE && get_live_out(block).test(n);
+    }
+
+    // Variable an allocation or a store to a local variable defines
+    static const IR* defined_variable(const Instruction* instruction)
+    {
+        if (dynamic_cast<const AllocaInstr*>(instruction))
+        {
+            return as_value(instruction);
+        }
+
+        const auto* store = dynamic_cast<const StoreInstr*>(instruction);
+        if (store && dynamic_cast<const AllocaInstr*>(store->address.get()))
+        {
+            return store->address;
+        }
+
+        return nullptr;
+    }
+
+    static std::vector<const Instruction*> number_definitions(Function* f)
+    {
+        std::vector<const Instruction*> definitions;
+        for (Block* block : function_blocks(f))
+        {
+            for (Instruction* instruction : *block)
+            {
+                if (defined_variable(instruction))
+                {
+                    definitions.push_back(instruction);
+                }
+            }
+        }
+
+        return definitions;
+    }
+
+    ReachingDefinitions::ReachingDefinitions(Function* f, AnalysisManager&) :
+            definitions(number_definitions(f)),
+            dataflow(f, Dataflow::FORWARD, Dataflow::UNION, definitions.size())
+    {
+        for (uint32_t i = 0; i < definitions.size(); i++)
+        {
+            number[definitions[i]] = i;
+
+            auto iter = of_variable.emplace(defined_variable(definitions[i]), BitVector(definitions.size())).first;
+            iter->second.set(i);
+        }
+
+        // A definition replaces the definitions of its variable
+        // made before it, in the block and everywhere else
+        for (Block* block : dataflow.get_order())
+        {
+            BitVector& gen = dataflow.gen(block);
+            BitVector& kill = dataflow.kill(block);
+            for (const Instruction* instruction : *block)
+            {
+                const IR* variable = defined_variable(instruction);
+                if (!variable)
+                {
+                    continue;
+                }
+
+                const BitVector& others = of_variable.at(variable);
+                gen.subtract(others);
+                gen.set(number.at(instruction));
+                kill.unite(others);
+            }
+        }
+
+        dataflow.solve();
+    }
+
+    std::vector<const Instruction*> ReachingDefinitions::get_reaching(const LoadInstr* load) const
+    {
+        const Block* block = load->get_block();
+        auto variable = of_variable.find(load->address);
+        if (variable == of_variable.end())
+        {
+            return {};
+        }
+
+        BitVector reaching = get_reaching_in(block);
+        for (const Instruction* instruction : *block)
+        {
+            if (instruction == load)
+            {
+                break;
+            }
+
+            if (defined_variable(instruction) == variable->first)
+            {
+                reaching.subtract(variable->second);
+                reaching.set(number.at(instruction));
+            }
+        }
+
+        reaching.intersect(variable->second);
+
+        std::vector<const Instruction*> out;
+        for (size_t i = reaching.find_next(0); i < reaching.size(); i = reaching.find_next(i + 1))
+        {
+            out.push_back(definitions[i]);
+        }
+
+        return out;
+    }
+}
@@ -0,0 +1,163 @@
+#ifndef CC_OPT_DATAFLOW_H
+#define CC_OPT_DATAFLOW_H
+
+#include <unordered_map>
+#include <vector>
+#include "analysis.h"
+#include "bit_vector.h"
+
+namespace cc
+{
+    class Dataflow
+    {
+        /**
+         * Gen/kill problem over dense bit-vectors, solved over the
+         * blocks reachable from the entry. Every block maps the set
+         * flowing into it to gen | (set & ~kill), the sets of the
+         * neighbours flowing into a block are met with a union or an
+         * intersection.
+         *
+         * Forward problems flow from the predecessors, the set entering
+         * the entry block is the boundary. Backward problems flow from
+         * the successors, the set leaving returning blocks is the
+         * boundary. The worklist visits blocks in reverse postorder of
+         * the CFG (postorder for backward problems) so that acyclic
+         * regions settle in one pass.
+         */
+
+    public:
+        enum direction_t
+        {
+            FORWARD,
+            BACKWARD
+        };
+
+        enum meet_t
+        {
+            UNION,          //!< May problems, sets start empty
+            INTERSECTION    //!< Must problems, sets start full
+        };
+
+    private:
+        direction_t direction;
+        meet_t meet;
+        size_t bits;
+        std::vector<Block*> order;              //!< Reverse postorder of the reachable blocks
+        std::vector<uint32_t> position;         //!< In order of each block index
+        std::vector<BitVector> gen_;            //!< Indexed by block index
+        std::vector<BitVector> kill_;
+        std::vector<BitVector> in_;
+        std::vector<BitVector> out_;
+        BitVector boundary_;
+        size_t visits;
+
+    public:
+        Dataflow(Function* f, direction_t direction, meet_t meet, size_t bits);
+
+        /**
+         * Transfer sets of a block, empty until they are filled in
+         */
+        BitVector& gen(const Block* block);
+        BitVector& kill(const Block* block);
+        BitVector& boundary() { return boundary_; }
+
+        void solve();
+
+        /**
+         * Sets at the start and the end of a block, empty for
+         * unreachable blocks
+         */
+        const BitVector& get_in(const Block* block) const;
+        const BitVector& get_out(const Block* block) const;
+
+        /**
+         * Reachable blocks in reverse postorder of the CFG
+         */
+        const std::vector<Block*>& get_order() const { return order; }
+
+        /**
+         * Blocks transferred by the last solve()
+         */
+        size_t get_visits() const { return visits; }
+    };
+
+    class Liveness : public FunctionAnalysis
+    {
+        /**
+         * Variables and values live at the boundaries of the blocks.
+         * A variable (an allocation) is live where a load may read it
+         * before a store overwrites it, any other use of its reference
+         * reads it. A value is live from its instruction to its last
+         * use. Every variable and every instruction with a result is
+         * numbered, variables first.
+         */
+
+        std::vector<const IR*> values;
+        std::unordered_map<const IR*, uint32_t> number;
+        Dataflow dataflow;
+
+    public:
+        static constexpr const char* NAME = "liveness";
+        static constexpr unsigned DEPENDS = ALL;
+
+        static constexpr uint32_t NONE = UINT32_MAX;
+
+        Liveness(Function* f, AnalysisManager& am);
+
+        size_t size() const { return values.size(); }
+
+        /**
+         * Variable or value numbered n, variables are their reference
+         */
+        const IR* get_value(uint32_t n) const { return values[n]; }
+
+        /**
+         * @return NONE for values defined outside of the function
+         */
+        uint32_t get_number(const IR* value) const;
+
+        const BitVector& get_live_in(const Block* block) const { return dataflow.get_in(block); }
+        const BitVector& get_live_out(const Block* block) const { return dataflow.get_out(block); }
+        bool is_live_in(const IR* value, const Block* block) const;
+        bool is_live_out(const IR* value, const Block* block) const;
+    };
+
+    class ReachingDefinitions : public FunctionAnalysis
+    {
+        /**
+         * Stores to the variables of the function that may reach each
+         * block without being overwritten. The allocation of a variable
+         * stands for the value it starts with: a parameter, or an
+         * uninitialized variable when it reaches a load.
+         */
+
+        std::vector<const Instruction*> definitions;
+        std::unordered_map<const Instruction*, uint32_t> number;
+        std::unordered_map<const IR*, BitVector> of_variable;       //!< Definitions of each variable
+        Dataflow dataflow;
+
+    public:
+        static constexpr const char* NAME = "reaching-definitions";
+        static constexpr unsigned DEPENDS = ALL;
+
+        ReachingDefinitions(Function* f, AnalysisManager& am);
+
+        size_t size() const { return definitions.size(); }
+
+        /**
+         * Allocation or store to a local variable numbered n
+         */
+        const Instruction* get_definition(uint32_t n) const { return definitions[n]; }
+
+        const BitVector& get_reaching_in(const Block* block) const { return dataflow.get_in(block); }
+        const BitVector& get_reaching_out(const Block* block) const { return dataflow.get_out(block); }
+
+        /**
+         * Definitions a load may read, in the order they are numbered.
+         * Loads of globals have none.
+         */
+        std::vector<const Instruction*> get_reaching(const LoadInstr* load) const;
+    };
+}
+
+#endif //CC_OPT_DATAFLOW_H
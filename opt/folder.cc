@@ -0,0 +1,131 @@
+#include "folder.h"
+#include "utils.h"
+
+#include <functional>
+#include <memory>
+
+namespace cc
+{
+    static bool is_commutative(const BinaryInstr* instr)
+    {
+        switch (instr->get_opcode())
+        {
+            case Instruction::ADD:
+            case Instruction::MUL:
+            case Instruction::B_AND:
+            case Instruction::B_OR:
+            case Instruction::B_XOR:
+            case Instruction::EQ:
+            case Instruction::L_AND:
+            case Instruction::L_OR:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    static bool is_integer(const NumericExpr* n, int64_t value)
+    {
+        return n && n->type != NumericExpr::FLOATING && n->value.integer == value;
+    }
+
+    size_t Folder::KeyHash::operator()(const Key& key) const
+    {
+        size_t h = key.opcode;
+        h = h * 31 + std::hash<const IR*>()(key.a);
+        return h * 31 + std::hash<const IR*>()(key.b);
+    }
+
+    Folder::Key Folder::key(const Instruction* instr)
+    {
+        const auto* binary = dynamic_cast<const BinaryInstr*>(instr);
+        if (!binary)
+        {
+            return {instr->get_opcode(), static_cast<const UnaryInstr*>(instr)->v, nullptr};
+        }
+
+        // a + b and b + a are the same value
+        const IR* a = binary->a;
+        const IR* b = binary->b;
+        if (is_commutative(binary) && std::less<const IR*>()(b, a))
+        {
+            std::swap(a, b);
+        }
+
+        return {instr->get_opcode(), a, b};
+    }
+
+    const IR* Folder::identity(Context* ctx, const BinaryInstr* instr) const
+    {
+        // Floating point identities do not hold for -0.0
+        const Type* type = instr->get_type(ctx);
+        Type::primitive_t primitive = type ? type->get_primitive() : Type::VOID;
+        if (primitive > Type::I64 && primitive != Type::CHAR && primitive != Type::PTR)
+        {
+            return nullptr;
+        }
+
+        const IR* x = instr->a;
+        const NumericExpr* c = as_numeric(instr->b);
+        if (!c && is_commutative(instr))
+        {
+            x = instr->b;
+            c = as_numeric(instr->a);
+        }
+
+        if (!c)
+        {
+            return nullptr;
+        }
+
+        Instruction::opcode_t op = instr->get_opcode();
+        if ((op == Instruction::MUL || op == Instruction::B_AND) && is_integer(c, 0))
+        {
+            return ctx->get_module()->constants().integer(0);
+        }
+
+        // Operands narrower than the result are converted by the instruction
+        if (x->get_type(ctx) != type)
+        {
+            return nullptr;
+        }
+
+        if ((op == Instruction::ADD || op == Instruction::SUB || op == Instruction::B_OR || op == Instruction::B_XOR)
+            && is_integer(c, 0))
+        {
+            return x;
+        }
+
+        if (op == Instruction::MUL && is_integer(c, 1))
+        {
+            return x;
+        }
+
+        return nullptr;
+    }
+
+    const IR* Folder::simplify(Context* ctx, Instruction* instr)
+    {
+        if (!is_pure(instr))
+        {
+            return nullptr;
+        }
+
+        std::unique_ptr<Constant> c(fold_constant(instr));
+        if (c)
+        {
+            return ctx->get_module()->constants().get(c.get());
+        }
+
+        instr->update_type(ctx);
+        const auto* binary = dynamic_cast<const BinaryInstr*>(instr);
+        const IR* value = binary ? identity(ctx, binary) : nullptr;
+        if (value)
+        {
+            return value;
+        }
+
+        auto iter = available.emplace(key(instr), instr);
+        return iter.second ? nullptr : iter.first->second;
+    }
+}
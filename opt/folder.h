@@ -0,0 +1,63 @@
+#ifndef CC_OPT_FOLDER_H
+#define CC_OPT_FOLDER_H
+
+#include <unordered_map>
+#include <compilation/instruction.h>
+#include <compilation/module.h>
+
+namespace cc
+{
+    class Folder
+    {
+        /**
+         * Simplifies the pure instructions an IRBuilder is about to add
+         * to the end of its block:
+         *  - operands that are all numeric constants give a constant
+         *  - x + 0, x - 0, x * 1, x | 0 and x ^ 0 give x, x * 0 and
+         *    x & 0 give 0, on integers and pointers
+         *  - an instruction identical to one added earlier in the
+         *    same block gives the value of the earlier one
+         *
+         * The builder forgets the instructions of a block (see clear())
+         * when it moves to another one, passes may erase them later.
+         */
+
+        struct Key
+        {
+            Instruction::opcode_t opcode;
+            const IR* a;
+            const IR* b;        //!< nullptr for unary instructions
+
+            bool operator==(const Key& other) const
+            {
+                return opcode == other.opcode && a == other.a && b == other.b;
+            }
+        };
+
+        struct KeyHash
+        {
+            size_t operator()(const Key& key) const;
+        };
+
+        std::unordered_map<Key, const Instruction*, KeyHash> available;
+
+        const IR* identity(Context* ctx, const BinaryInstr* instr) const;
+        static Key key(const Instruction* instr);
+
+    public:
+        /**
+         * Value an instruction simplifies to, a pooled constant or
+         * an existing value. nullptr if it has to be added, the
+         * instruction must then be added to the block right away.
+         * @param ctx context of the block the instruction is added to
+         */
+        const IR* simplify(Context* ctx, Instruction* instr);
+
+        /**
+         * Forget the instructions added so far
+         */
+        void clear() { available.clear(); }
+    };
+}
+
+#endif //CC_OPT_FOLDER_H
@@ -0,0 +1,1197 @@
+#include "ir_text.h"
+#include "utils.h"
+#include <compilation/type.h>
+
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <sstream>
+
+namespace cc
+{
+    /****************************************************************************
+     *                                                                          *
+     *                                 Writer                                   *
+     *                                                                          *
+     ****************************************************************************/
+
+    static std::string opcode(const Instruction* instr)
+    {
+        // AddInstr -> add, L_SLInstr -> l_sl
+        std::string name = instr->get_name();
+        name.resize(name.size() - strlen("Instr"));
+        for (char& c : name)
+        {
+            c = static_cast<char>(tolower(c));
+        }
+
+        return name;
+    }
+
+    static std::string type_string(Context* ctx, const Type* type)
+    {
+        if (dynamic_cast<const PointerType*>(type))
+        {
+            return type_string(ctx, dynamic_cast<const PointerType*>(type)->get_pointed_type()) + "*";
+        }
+
+        if (dynamic_cast<const StructType*>(type))
+        {
+            return "struct " + dynamic_cast<const StructType*>(type)->name;
+        }
+
+        std::string out;
+        if (type->is_const()) out += "const ";
+        if (type->is_volatile()) out += "volatile ";
+        if (type->is_unsigned()) out += "unsigned ";
+
+        return out + (type == ctx->type<Type::PTR>() ? "ptr" : type->as_string());
+    }
+
+    static std::string escape(const std::string& str)
+    {
+        std::string out = "\"";
+        for (char c : str)
+        {
+            switch (c)
+            {
+                case '"': out += "\\\""; break;
+                case '\\': out += "\\\\"; break;
+                case '\n': out += "\\n"; break;
+                case '\t': out += "\\t"; break;
+                default:
+                    if (isprint(static_cast<unsigned char>(c)))
+                    {
+                        out += c;
+                    }
+                    else
+                    {
+                        out += variadic_string("\\x%02x", static_cast<unsigned char>(c));
+                    }
+            }
+        }
+
+        return out + "\"";
+    }
+
+    static std::string constant_string(const Constant* c)
+    {
+        const auto* expr = dynamic_cast<const ConstantExpr*>(c);
+        if (expr)
+        {
+            return constant_string(expr->constant);
+        }
+
+        const auto* literal = dynamic_cast<const LiteralExpr*>(c);
+        if (literal)
+        {
+            return escape(literal->value);
+        }
+
+        const auto* n = dynamic_cast<const NumericExpr*>(c);
+        if (!n)
+        {
+            throw Exception("Cannot write constant " + c->as_string());
+        }
+
+        switch (n->type)
+        {
+            case NumericExpr::ASCII:
+                return "#" + std::to_string(n->value.integer);
+            case NumericExpr::INTEGER:
+                return std::to_string(n->value.integer);
+            case NumericExpr::FLOATING:
+            {
+                if (std::isnan(n->value.floating))
+                {
+                    return "nan";
+                }
+
+                std::string out = variadic_string("%.17g", n->value.floating);
+                if (out.find_first_of(".ein") == std::string::npos)
+                {
+                    out += ".0";
+                }
+                return out;
+            }
+        }
+
+        return "";
+    }
+
+    class FunctionWriter
+    {
+        std::ostream& os;
+        std::map<const Block*, std::string> labels;
+        std::unordered_map<const IR*, size_t> numbers;
+
+    public:
+        FunctionWriter(std::ostream& os, const std::vector<Block*>& blocks, bool labeled) : os(os)
+        {
+            for (const Block* block : blocks)
+            {
+                if (labeled)
+                {
+                    labels[block] = "L" + std::to_string(labels.size());
+                }
+
+                for (const Instruction* instr : *block)
+                {
+                    // Values of statements are only named when something uses them
+                    const IR* value = as_value(instr);
+                    if (is_pure(instr) || dynamic_cast<const AllocaInstr*>(instr)
+                        || dynamic_cast<const LoadInstr*>(instr)
+                        || dynamic_cast<const CallInstr*>(instr) || !value->use_empty())
+                    {
+                        numbers[value] = numbers.size();
+                    }
+                }
+            }
+        }
+
+        std::string operand(const IR* ir) const
+        {
+            auto iter = numbers.find(ir);
+            if (iter != numbers.end())
+            {
+                return "%" + std::to_string(iter->second);
+            }
+
+            if (dynamic_cast<const GlobalVariable*>(ir))
+            {
+                return "@" + dynamic_cast<const GlobalVariable*>(ir)->get_name();
+            }
+
+            if (dynamic_cast<const Constant*>(ir))
+            {
+                return constant_string(dynamic_cast<const Constant*>(ir));
+            }
+
+            throw Exception("Cannot write operand " + ir->as_string());
+        }
+
+        void instruction(Context* ctx, Instruction* instr)
+        {
+            os << "    ";
+            auto number = numbers.find(as_value(instr));
+            if (number != numbers.end())
+            {
+                os << "%" << number->second << " = ";
+            }
+
+            os << opcode(instr);
+            if (dynamic_cast<const AllocaInstr*>(instr))
+            {
+                const TypeDecl* decl = dynamic_cast<const AllocaInstr*>(instr)->variable->get_decl();
+                os << " " << type_string(ctx, decl->type) << " " << decl->name;
+            }
+            else if (dynamic_cast<const LoadInstr*>(instr))
+            {
+                const auto* load = dynamic_cast<const LoadInstr*>(instr);
+                os << " " << type_string(ctx, load->loaded) << " " << operand(load->address)
+                   << ", align " << load->alignment;
+            }
+            else if (dynamic_cast<const StoreInstr*>(instr))
+            {
+                const auto* store = dynamic_cast<const StoreInstr*>(instr);
+                os << " " << operand(store->address) << ", " << operand(store->value)
+                   << ", align " << store->alignment;
+            }
+            else if (dynamic_cast<const JumpInstr*>(instr))
+            {
+                os << " " << labels.at(dynamic_cast<const JumpInstr*>(instr)->target);
+            }
+            else if (dynamic_cast<const BranchInstr*>(instr))
+            {
+                const auto* branch = dynamic_cast<const BranchInstr*>(instr);
+                os << " " << operand(branch->condition) << ", " << labels.at(branch->target)
+                   << ", " << labels.at(branch->otherwise);
+            }
+            else if (dynamic_cast<const CallInstr*>(instr))
+            {
+                const auto* call = dynamic_cast<const CallInstr*>(instr);
+                os << " @" << call->f->get_name() << "(";
+                for (size_t i = 0; i < call->arguments.size(); i++)
+                {
+                    os << (i ? ", " : "") << operand(call->arguments[i]);
+                }
+                os << ")";
+            }
+            else
+            {
+                const char* separator = " ";
+                for_each_operand(instr, [&](Use& value)
+                {
+                    os << separator << operand(value);
+                    separator = ", ";
+                });
+            }
+
+            os << "\n";
+        }
+
+        void block(Context* ctx, Block* block)
+        {
+            if (!labels.empty())
+            {
+                os << labels.at(block) << ":\n";
+            }
+
+            for (Instruction* instr : *block)
+            {
+                instruction(ctx, instr);
+            }
+        }
+    };
+
+    static void write_signature(std::ostream& os, Context* ctx, const Function* f)
+    {
+        os << type_string(ctx, f->get_return_type()) << " @" << f->get_name() << "(";
+        const Arguments* arg = f->get_ast() ? f->get_ast()->args : nullptr;
+        for (size_t i = 0; i < f->get_signature().size(); i++)
+        {
+            os << (i ? ", " : "") << type_string(ctx, f->get_signature()[i]);
+            if (arg)
+            {
+                os << " " << arg->decl->name;
+                arg = arg->next;
+            }
+        }
+        os << ")";
+    }
+
+    void write_ir(std::ostream& os, Context* ctx)
+    {
+        Module* module = ctx->get_module();
+        bool globals = false;
+        for (const auto& iter : module->get_symbols())
+        {
+            const auto* gv = dynamic_cast<const GlobalVariable*>(iter.second);
+            if (gv)
+            {
+                os << "global " << type_string(ctx, gv->get_declared_type()) << " @" << gv->get_name() << "\n";
+                globals = true;
+            }
+        }
+
+        bool declarations = false;
+        for (const auto& iter : module->get_symbols())
+        {
+            const auto* f = dynamic_cast<const Function*>(iter.second);
+            if (f && !f->get_entry_block())
+            {
+                if (globals && !declarations)
+                {
+                    os << "\n";
+                }
+
+                os << "declare ";
+                write_signature(os, ctx, f);
+                os << "\n";
+                declarations = true;
+            }
+        }
+
+        for (const auto& iter : module->get_symbols())
+        {
+            const auto* f = dynamic_cast<const Function*>(iter.second);
+            if (!f || !f->get_entry_block())
+            {
+                continue;
+            }
+
+            os << (globals || declarations ? "\n" : "") << "define ";
+            write_signature(os, ctx, f);
+            os << " {\n";
+
+            std::vector<Block*> blocks = function_blocks(f);
+            FunctionWriter writer(os, blocks, true);
+            for (Block* block : blocks)
+            {
+                writer.block(ctx, block);
+            }
+            os << "}\n";
+            globals = true;
+        }
+
+        for (Block* block : {module->constructor(), module->destructor()})
+        {
+            if (block->size() == 0)
+            {
+                continue;
+            }
+
+            os << (globals || declarations ? "\n" : "")
+               << (block == module->constructor() ? "constructor" : "destructor") << " {\n";
+            FunctionWriter writer(os, {block}, false);
+            writer.block(ctx, block);
+            os << "}\n";
+            globals = true;
+        }
+    }
+
+    /****************************************************************************
+     *                                                                          *
+     *                                 Reader                                   *
+     *                                                                          *
+     ****************************************************************************/
+
+    struct IRToken
+    {
+        enum kind_t
+        {
+            IDENTIFIER,
+            LOCAL,      //!< %name
+            GLOBAL,     //!< @name
+            INTEGER,
+            FLOATING,
+            ASCII,      //!< #CODE
+            STRING,
+            PUNCTUATION,
+            END
+        };
+
+        kind_t kind;
+        std::string text;
+        uint32_t line;
+    };
+
+    static bool is_identifier(char c)
+    {
+        return isalnum(static_cast<unsigned char>(c)) || c == '_' || c == '.';
+    }
+
+    static std::vector<IRToken> tokenize(const std::string& text)
+    {
+        std::vector<IRToken> out;
+        uint32_t line = 1;
+        size_t i = 0;
+        auto error = [&line](const std::string& message)
+        {
+            return Exception(variadic_string("line %u: ", line) + message);
+        };
+
+        while (i < text.size())
+        {
+            char c = text[i];
+            if (c == '\n')
+            {
+                line++;
+                i++;
+                continue;
+            }
+
+            if (isspace(static_cast<unsigned char>(c)))
+            {
+                i++;
+                continue;
+            }
+
+            if (c == ';')
+            {
+                while (i < text.size() && text[i] != '\n') i++;
+                continue;
+            }
+
+            IRToken token{IRToken::PUNCTUATION, "", line};
+            size_t start = i;
+            if (c == '%' || c == '@' || c == '#')
+            {
+                i++;
+                while (i < text.size() && is_identifier(text[i])) i++;
+                if (i == start + 1)
+                {
+                    throw error(std::string("Expected a name after '") + c + "'");
+                }
+
+                token.kind = c == '%' ? IRToken::LOCAL : c == '@' ? IRToken::GLOBAL : IRToken::ASCII;
+                token.text = text.substr(start + 1, i - start - 1);
+            }
+            else if (c == '"')
+            {
+                token.kind = IRToken::STRING;
+                for (i++; i < text.size() && text[i] != '"'; i++)
+                {
+                    if (text[i] == '\n')
+                    {
+                        throw error("Unterminated string");
+                    }
+
+                    if (text[i] != '\\')
+                    {
+                        token.text += text[i];
+                        continue;
+                    }
+
+                    if (++i >= text.size())
+                    {
+                        break;
+                    }
+
+                    switch (text[i])
+                    {
+                        case 'n': token.text += '\n'; break;
+                        case 't': token.text += '\t'; break;
+                        case 'x':
+                            token.text += static_cast<char>(strtol(text.substr(i + 1, 2).c_str(), nullptr, 16));
+                            i += 2;
+                            break;
+                        default: token.text += text[i]; break;
+                    }
+                }
+
+                if (i >= text.size())
+                {
+                    throw error("Unterminated string");
+                }
+                i++;
+            }
+            else if (isdigit(static_cast<unsigned char>(c))
+                     || (c == '-' && i + 1 < text.size()
+                         && (isdigit(static_cast<unsigned char>(text[i + 1])) || text.compare(i + 1, 3, "inf") == 0
+                             || text.compare(i + 1, 3, "nan") == 0)))
+            {
+                i++;
+                while (i < text.size() && (is_identifier(text[i])
+                                           || ((text[i] == '-' || text[i] == '+')
+                                               && (text[i - 1] == 'e' || text[i - 1] == 'E'))))
+                {
+                    i++;
+                }
+
+                token.text = text.substr(start, i - start);
+                token.kind = token.text.find_first_of(".ein") == std::string::npos
+                             ? IRToken::INTEGER : IRToken::FLOATING;
+            }
+            else if (is_identifier(c))
+            {
+                while (i < text.size() && is_identifier(text[i])) i++;
+                token.text = text.substr(start, i - start);
+                token.kind = token.text == "inf" || token.text == "nan"
+                             ? IRToken::FLOATING : IRToken::IDENTIFIER;
+            }
+            else if (strchr("=,(){}:*", c))
+            {
+                token.text = std::string(1, c);
+                i++;
+            }
+            else
+            {
+                throw error(std::string("Unexpected character '") + c + "'");
+            }
+
+            out.push_back(std::move(token));
+        }
+
+        out.push_back({IRToken::END, "end of input", line});
+        return out;
+    }
+
+    typedef Instruction* (*binary_factory_t)(const IR*, const IR*);
+    typedef Instruction* (*unary_factory_t)(const IR*);
+
+#define BINARY_FACTORY(name) {#name, [](const IR* a, const IR* b) -> Instruction* { return new name##Instr(a, b); }}
+#define UNARY_FACTORY(name) {#name, [](const IR* v) -> Instruction* { return new name##Instr(v); }}
+
+    static std::map<std::string, binary_factory_t> binary_factories()
+    {
+        std::map<std::string, binary_factory_t> table = {
+                BINARY_FACTORY(Add), BINARY_FACTORY(Sub), BINARY_FACTORY(Div), BINARY_FACTORY(Mul),
+                BINARY_FACTORY(L_And), BINARY_FACTORY(L_Or),
+                BINARY_FACTORY(LT), BINARY_FACTORY(GT), BINARY_FACTORY(LE), BINARY_FACTORY(GE), BINARY_FACTORY(EQ),
+                BINARY_FACTORY(B_And), BINARY_FACTORY(B_Or), BINARY_FACTORY(B_Xor),
+                BINARY_FACTORY(L_SL), BINARY_FACTORY(L_SR), BINARY_FACTORY(A_SR),
+        };
+
+        // Opcodes are spelled in lower case
+        std::map<std::string, binary_factory_t> out;
+        for (const auto& iter : table)
+        {
+            std::unique_ptr<Instruction> sample(iter.second(nullptr, nullptr));
+            out[opcode(sample.get())] = iter.second;
+        }
+        return out;
+    }
+
+    static std::map<std::string, unary_factory_t> unary_factories()
+    {
+        std::map<std::string, unary_factory_t> table = {
+                UNARY_FACTORY(Inc), UNARY_FACTORY(Dec), UNARY_FACTORY(L_Not), UNARY_FACTORY(B_Not),
+        };
+
+        std::map<std::string, unary_factory_t> out;
+        for (const auto& iter : table)
+        {
+            std::unique_ptr<Instruction> sample(iter.second(nullptr));
+            out[opcode(sample.get())] = iter.second;
+        }
+        return out;
+    }
+
+#undef BINARY_FACTORY
+#undef UNARY_FACTORY
+
+    struct IRParser
+    {
+        IRReader& reader;
+        Context* ctx;
+        Module* module;
+        std::vector<IRToken> tokens;
+        size_t i;
+
+        std::map<std::string, binary_factory_t> binary;
+        std::map<std::string, unary_factory_t> unary;
+
+        // State of the body being read
+        struct Fixup
+        {
+            Use* slot;
+            bool reference;     //!< Address of a load or a store
+            std::string name;
+            uint32_t line;
+        };
+
+        std::map<std::string, Block*> labels;
+        std::map<std::string, const IR*> values;
+        std::vector<Fixup> fixups;
+
+        IRParser(IRReader& reader, const std::string& text) :
+                reader(reader), ctx(reader.ctx), module(reader.ctx->get_module()),
+                tokens(tokenize(text)), i(0),
+                binary(binary_factories()), unary(unary_factories())
+        {
+        }
+
+        const IRToken& peek(size_t ahead = 0) const
+        {
+            return tokens[std::min(i + ahead, tokens.size() - 1)];
+        }
+
+        const IRToken& next()
+        {
+            const IRToken& out = peek();
+            if (i < tokens.size() - 1)
+            {
+                i++;
+            }
+            return out;
+        }
+
+        Exception error(const std::string& message, const IRToken* at = nullptr) const
+        {
+            const IRToken& token = at ? *at : peek();
+            return Exception(variadic_string("line %u: ", token.line) + message
+                             + " near '" + token.text + "'");
+        }
+
+        bool is(const char* punctuation) const
+        {
+            return peek().kind == IRToken::PUNCTUATION && peek().text == punctuation;
+        }
+
+        void expect(const char* punctuation)
+        {
+            if (!is(punctuation))
+            {
+                throw error(std::string("Expected '") + punctuation + "'");
+            }
+            next();
+        }
+
+        const IRToken& expect(IRToken::kind_t kind, const char* what)
+        {
+            if (peek().kind != kind)
+            {
+                throw error(std::string("Expected ") + what);
+            }
+            return next();
+        }
+
+        ASTPosition position() const
+        {
+            return ASTPosition(peek().line, 0, 0);
+        }
+
+        const Type* primitive(const std::string& name)
+        {
+            static const std::map<std::string, Type::primitive_t> primitives = {
+                    {"void", Type::VOID}, {"char", Type::CHAR}, {"ptr", Type::PTR},
+                    {"i8", Type::I8}, {"i16", Type::I16}, {"i32", Type::I32}, {"i64", Type::I64},
+                    {"f32", Type::F32}, {"f64", Type::F64},
+            };
+
+            auto iter = primitives.find(name);
+            if (iter == primitives.end())
+            {
+                return nullptr;
+            }
+
+            switch (iter->second)
+            {
+                case Type::VOID: return ctx->type<Type::VOID>();
+                case Type::CHAR: return ctx->type<Type::CHAR>();
+                case Type::PTR: return ctx->type<Type::PTR>();
+                case Type::I8: return ctx->type<Type::I8>();
+                case Type::I16: return ctx->type<Type::I16>();
+                case Type::I32: return ctx->type<Type::I32>();
+                case Type::I64: return ctx->type<Type::I64>();
+                case Type::F32: return ctx->type<Type::F32>();
+                case Type::F64: return ctx->type<Type::F64>();
+                default: return nullptr;
+            }
+        }
+
+        const Type* type()
+        {
+            int qualifiers = QualType::NONE;
+            for (;;)
+            {
+                const std::string& word = peek().text;
+                if (peek().kind != IRToken::IDENTIFIER) break;
+                else if (word == "const") qualifiers |= QualType::CONST;
+                else if (word == "unsigned") qualifiers |= QualType::UNSIGNED;
+                else if (word == "volatile") qualifiers |= QualType::VOLATILE;
+                else break;
+                next();
+            }
+
+            if (peek().kind == IRToken::IDENTIFIER && peek().text == "struct")
+            {
+                throw error("Structures are not supported in textual IR");
+            }
+
+            const IRToken& name = expect(IRToken::IDENTIFIER, "a type");
+            const Type* out = primitive(name.text);
+            if (!out)
+            {
+                throw error("Unknown type '" + name.text + "'", &name);
+            }
+
+            if (qualifiers == QualType::UNSIGNED)
+            {
+                if (out == ctx->type<Type::I8>()) out = ctx->unsigned_type<Type::I8>();
+                else if (out == ctx->type<Type::I16>()) out = ctx->unsigned_type<Type::I16>();
+                else if (out == ctx->type<Type::I32>()) out = ctx->unsigned_type<Type::I32>();
+                else if (out == ctx->type<Type::I64>()) out = ctx->unsigned_type<Type::I64>();
+                else throw error("Only integers may be unsigned", &name);
+            }
+            else if (qualifiers)
+            {
+                // Registered with the context
+                out = new QualType(ctx, qualifiers, out);
+            }
+
+            while (is("*"))
+            {
+                next();
+                out = out->get_pointer_to();
+            }
+
+            return out;
+        }
+
+        TypeDecl* declaration(const Type* type, const std::string& name)
+        {
+            ASTPosition p = position();
+            return new TypeDecl(&p, type, strdup(name.c_str()));
+        }
+
+        void skip_body()
+        {
+            expect("{");
+            for (int depth = 1; depth > 0; next())
+            {
+                if (peek().kind == IRToken::END)
+                {
+                    throw error("Expected '}'");
+                }
+
+                depth += is("{") - is("}");
+            }
+        }
+
+        Function* function_header()
+        {
+            ASTPosition p = position();
+            const Type* return_type = type();
+            const IRToken& name_token = expect(IRToken::GLOBAL, "a function name");
+            std::string name = name_token.text;
+
+            Arguments* args = nullptr;
+            Arguments** tail = &args;
+            expect("(");
+            while (!is(")"))
+            {
+                if (args)
+                {
+                    expect(",");
+                }
+
+                const Type* arg_type = type();
+                std::string arg_name = peek().kind == IRToken::IDENTIFIER ? next().text : "";
+                *tail = new Arguments(declaration(arg_type, arg_name));
+                tail = &(*tail)->next;
+            }
+            next();
+
+            auto* ast = new ASTFunction(&p, return_type, strdup(name.c_str()), args);
+            reader.declarations.push_back(ast);
+            Function* f = module->declare_function(ast);
+            if (!f)
+            {
+                throw error("Duplicate global symbol", &name_token);
+            }
+
+            ast->symbol = f;
+            return f;
+        }
+
+        void global()
+        {
+            const Type* var_type = type();
+            const IRToken& name_token = expect(IRToken::GLOBAL, "a global name");
+            std::string name = name_token.text;
+
+            auto* ast = new ASTGlobalVariable(new Decl(declaration(var_type, name)));
+            reader.declarations.push_back(ast);
+            GlobalVariable* gv = module->declare_variable(ast);
+            if (!gv)
+            {
+                throw error("Duplicate global symbol", &name_token);
+            }
+
+            ast->symbol = gv;
+        }
+
+        const IR* operand(Use* slot)
+        {
+            const IRToken& token = next();
+            ConstantPool& constants = module->constants();
+            switch (token.kind)
+            {
+                case IRToken::LOCAL:
+                {
+                    auto iter = values.find(token.text);
+                    if (iter != values.end())
+                    {
+                        return iter->second;
+                    }
+
+                    // Defined further down
+                    fixups.push_back({slot, false, token.text, token.line});
+                    return nullptr;
+                }
+                case IRToken::GLOBAL:
+                {
+                    const auto* gv = dynamic_cast<const GlobalVariable*>(module->get_symbol(token.text));
+                    if (!gv)
+                    {
+                        throw error("Unknown global variable", &token);
+                    }
+                    return gv;
+                }
+                case IRToken::INTEGER:
+                    return constants.integer(strtoll(token.text.c_str(), nullptr, 10));
+                case IRToken::ASCII:
+                    return constants.integer(strtoll(token.text.c_str(), nullptr, 10), NumericExpr::ASCII);
+                case IRToken::FLOATING:
+                    return constants.floating(strtod(token.text.c_str(), nullptr));
+                case IRToken::STRING:
+                    return constants.string(token.text);
+                default:
+                    throw error("Expected an operand", &token);
+            }
+        }
+
+        const IR* address(Use* slot)
+        {
+            const IRToken& token = peek();
+            const IR* ir = operand(slot);
+            if (token.kind == IRToken::LOCAL && !ir)
+            {
+                fixups.back().reference = true;
+            }
+            else if (!dynamic_cast<const Reference*>(ir))
+            {
+                throw error("Address is not a reference", &token);
+            }
+
+            return ir;
+        }
+
+        uint32_t alignment()
+        {
+            expect(",");
+            if (peek().kind != IRToken::IDENTIFIER || peek().text != "align")
+            {
+                throw error("Expected 'align'");
+            }
+            next();
+
+            const IRToken& value = expect(IRToken::INTEGER, "an alignment");
+            long long n = strtoll(value.text.c_str(), nullptr, 10);
+            if (n <= 0 || (n & (n - 1)))
+            {
+                throw error("Alignment is not a power of two", &value);
+            }
+
+            return static_cast<uint32_t>(n);
+        }
+
+        Block* label()
+        {
+            const IRToken& name = expect(IRToken::IDENTIFIER, "a label");
+            auto iter = labels.find(name.text);
+            if (iter == labels.end())
+            {
+                throw error("Unknown label", &name);
+            }
+            return iter->second;
+        }
+
+        bool is_label() const
+        {
+            return peek().kind == IRToken::IDENTIFIER
+                   && peek(1).kind == IRToken::PUNCTUATION && peek(1).text == ":";
+        }
+
+        bool same_line(const IRToken& token) const
+        {
+            return peek().line == token.line && peek().kind != IRToken::END && !is("}");
+        }
+
+        Instruction* instruction(Function* f, Block* block)
+        {
+            // Owned until the instruction is complete
+            std::unique_ptr<Instruction> out;
+            const IRToken& op = expect(IRToken::IDENTIFIER, "an instruction");
+
+            auto b_iter = binary.find(op.text);
+            auto u_iter = unary.find(op.text);
+            if (b_iter != binary.end())
+            {
+                out.reset(b_iter->second(nullptr, nullptr));
+                auto* instr = dynamic_cast<BinaryInstr*>(out.get());
+                instr->a = operand(&instr->a);
+                expect(",");
+                instr->b = operand(&instr->b);
+            }
+            else if (u_iter != unary.end())
+            {
+                out.reset(u_iter->second(nullptr));
+                auto* instr = dynamic_cast<UnaryInstr*>(out.get());
+                instr->v = operand(&instr->v);
+            }
+            else if (op.text == "alloca")
+            {
+                const Type* var_type = type();
+                std::string name = expect(IRToken::IDENTIFIER, "a variable name").text;
+                reader.variable_decls.emplace_back(declaration(var_type, name));
+                reader.variables.emplace_back(new Variable(reader.variable_decls.back().get()));
+
+                auto* instr = new AllocaInstr(reader.variables.back().get());
+                out.reset(instr);
+                reader.variables.back()->set(instr);
+            }
+            else if (op.text == "load")
+            {
+                const Type* loaded = type();
+                auto* instr = new LoadInstr(nullptr, loaded, 0);
+                out.reset(instr);
+                instr->address = address(&instr->address);
+                instr->alignment = alignment();
+            }
+            else if (op.text == "store")
+            {
+                auto* instr = new StoreInstr(nullptr, nullptr, 0);
+                out.reset(instr);
+                instr->address = address(&instr->address);
+                expect(",");
+                instr->value = operand(&instr->value);
+                instr->alignment = alignment();
+            }
+            else if (op.text == "jump")
+            {
+                out.reset(new JumpInstr(label()));
+            }
+            else if (op.text == "branch")
+            {
+                auto* instr = new BranchInstr(nullptr, nullptr, nullptr);
+                out.reset(instr);
+                instr->condition = operand(&instr->condition);
+                expect(",");
+                instr->target = label();
+                expect(",");
+                instr->otherwise = label();
+            }
+            else if (op.text == "return")
+            {
+                auto* instr = new ReturnInstr(nullptr);
+                out.reset(instr);
+                if (same_line(op))
+                {
+                    instr->return_value = operand(&instr->return_value);
+                }
+
+                if (f)
+                {
+                    f->add_destructor_block(block);
+                }
+            }
+            else if (op.text == "call")
+            {
+                const IRToken& name = expect(IRToken::GLOBAL, "a function name");
+                const Function* callee = module->get_function(name.text);
+                if (!callee)
+                {
+                    throw error("Unknown function", &name);
+                }
+
+                // Every operand is a single token, the slots must not
+                // move once forward references point to them
+                size_t count = 0;
+                for (size_t ahead = 1; peek(ahead).kind != IRToken::END
+                                       && !(peek(ahead).kind == IRToken::PUNCTUATION && peek(ahead).text == ")"); ahead++)
+                {
+                    count += peek(ahead).kind != IRToken::PUNCTUATION;
+                }
+
+                if (count != callee->get_signature().size())
+                {
+                    throw error("Wrong number of arguments to @" + name.text, &name);
+                }
+
+                auto* instr = new CallInstr(callee, std::vector<const IR*>(count, nullptr));
+                out.reset(instr);
+                expect("(");
+                for (size_t a = 0; a < count; a++)
+                {
+                    if (a)
+                    {
+                        expect(",");
+                    }
+                    instr->arguments[a] = operand(&instr->arguments[a]);
+                }
+                expect(")");
+            }
+            else
+            {
+                throw error("Unknown instruction", &op);
+            }
+
+            return out.release();
+        }
+
+        void body(Function* f, const std::vector<Block*>& blocks)
+        {
+            values.clear();
+            fixups.clear();
+
+            Block* block = f ? nullptr : blocks[0];
+            expect("{");
+            while (!is("}"))
+            {
+                if (peek().kind == IRToken::END)
+                {
+                    throw error("Expected '}'");
+                }
+
+                if (f && is_label())
+                {
+                    block = labels.at(next().text);
+                    next();
+                    continue;
+                }
+
+                if (!block)
+                {
+                    throw error("Expected a label");
+                }
+
+                if (block->get_terminator())
+                {
+                    throw error("Instruction following the terminator of a block");
+                }
+
+                std::string result;
+                const IRToken* result_token = nullptr;
+                if (peek().kind == IRToken::LOCAL && peek(1).kind == IRToken::PUNCTUATION && peek(1).text == "=")
+                {
+                    result_token = &next();
+                    result = result_token->text;
+                    next();
+                }
+
+                Instruction* instr = instruction(f, block);
+                block->push(instr);
+                if (result_token && !values.emplace(result, as_value(instr)).second)
+                {
+                    throw error("Value %" + result + " is defined twice", result_token);
+                }
+            }
+            next();
+
+            std::vector<Instruction*> stale;
+            for (const Fixup& fixup : fixups)
+            {
+                auto iter = values.find(fixup.name);
+                if (iter == values.end())
+                {
+                    throw Exception(variadic_string("line %u: Undefined value %%%s",
+                                                    fixup.line, fixup.name.c_str()));
+                }
+
+                if (fixup.reference && !dynamic_cast<const Reference*>(iter->second))
+                {
+                    throw Exception(variadic_string("line %u: Address is not a reference",
+                                                    fixup.line));
+                }
+
+                fixup.slot->set(iter->second);
+                stale.push_back(fixup.slot->get_user());
+            }
+
+            // Forward references were still empty when their users got
+            // their type, so were the values computed out of them
+            while (!stale.empty())
+            {
+                Instruction* instr = stale.back();
+                stale.pop_back();
+                if (instr->update_type(ctx))
+                {
+                    for (Use* use = as_value(instr)->get_uses(); use; use = use->get_next())
+                    {
+                        stale.push_back(use->get_user());
+                    }
+                }
+            }
+        }
+
+        void function_body(Function* f)
+        {
+            // Blocks are created in the order they are labeled
+            ctx->start_scope_build();
+            ctx->enter_scope(Scope::FUNCTION, f->get_name());
+            Scope* scope = ctx->scope();
+            scope->set_function(f);
+            ctx->exit_scope();
+            ctx->end_scope_build();
+
+            labels.clear();
+            std::vector<Block*> blocks;
+            std::vector<std::string> names;
+            size_t start = i;
+            for (int depth = 0; peek().kind != IRToken::END; next())
+            {
+                depth += is("{") - is("}");
+                if (depth == 0 && i > start)
+                {
+                    break;
+                }
+
+                if (is_label())
+                {
+                    if (labels.find(peek().text) != labels.end())
+                    {
+                        throw error("Label is defined twice");
+                    }
+
+                    blocks.push_back(scope->new_block(peek().text));
+                    names.push_back(peek().text);
+                    labels[peek().text] = blocks.back();
+                }
+            }
+            i = start;
+
+            if (blocks.empty())
+            {
+                throw error("Function @" + f->get_name() + " has no blocks");
+            }
+
+            f->set_entry_block(blocks[0]);
+            body(f, blocks);
+
+            for (size_t b = 0; b < blocks.size(); b++)
+            {
+                if (!blocks[b]->get_terminator())
+                {
+                    throw Exception("Block " + names[b] + " of @" + f->get_name()
+                                    + " does not end with a terminator");
+                }
+            }
+        }
+
+        void read()
+        {
+            struct Body
+            {
+                size_t start;
+                Function* f;
+                Block* block;
+            };
+
+            // Every symbol is declared before any body refers to it
+            std::vector<Body> bodies;
+            while (peek().kind != IRToken::END)
+            {
+                const IRToken& keyword = expect(IRToken::IDENTIFIER, "a declaration");
+                if (keyword.text == "global")
+                {
+                    global();
+                }
+                else if (keyword.text == "declare")
+                {
+                    function_header();
+                }
+                else if (keyword.text == "define")
+                {
+                    Function* f = function_header();
+                    bodies.push_back({i, f, nullptr});
+                    skip_body();
+                }
+                else if (keyword.text == "constructor" || keyword.text == "destructor")
+                {
+                    Block* block = keyword.text == "constructor" ? module->constructor() : module->destructor();
+                    bodies.push_back({i, nullptr, block});
+                    skip_body();
+                }
+                else
+                {
+                    throw error("Expected a declaration", &keyword);
+                }
+            }
+
+            for (const Body& b : bodies)
+            {
+                i = b.start;
+                if (b.f)
+                {
+                    function_body(b.f);
+                }
+                else
+                {
+                    labels.clear();
+                    body(nullptr, {b.block});
+                }
+            }
+        }
+    };
+
+    void IRReader::read(const std::string& text)
+    {
+        IRParser parser(*this, text);
+        parser.read();
+    }
+
+    IRReader::~IRReader()
+    {
+        // The module refers to the declarations
+        ctx->reset();
+        for (ASTGlobal* ast : declarations)
+        {
+            delete ast;
+        }
+    }
+}
@@ -0,0 +1,82 @@
+#ifndef CC_IR_TEXT_H
+#define CC_IR_TEXT_H
+
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <compilation/instruction.h>
+#include <compilation/module.h>
+
+namespace cc
+{
+    /**
+     * Write the module of a context as textual IR:
+     *
+     *   global i32 @g
+     *   declare i32 @puts(i8* s)
+     *
+     *   define i32 @main(i32 argc) {
+     *   L0:
+     *       %0 = alloca i32 argc
+     *       %1 = load i32 %0, align 4
+     *       %2 = add %1, 1
+     *       store %0, %2, align 4
+     *       branch %2, L1, L2
+     *   L1:
+     *       return %2
+     *   L2:
+     *       %3 = call @puts("hi")
+     *       return 0
+     *   }
+     *
+     *   constructor {
+     *       store @g, 4, align 4
+     *   }
+     *
+     * Symbols are written in name order. Blocks are labeled and values are
+     * numbered per function in the order they appear, so writing the IR
+     * read back from the output gives the same text. The first allocations
+     * of the entry block hold the arguments. Allocations and globals are
+     * only read and written through loads and stores. Every block of a function ends
+     * with its only jump, branch (to the first label when the condition is
+     * non-zero, the second otherwise) or return.
+     *
+     * Constants are integers, floating point numbers (always with a '.',
+     * an exponent, inf or nan), ASCII characters as #CODE and strings.
+     */
+    void write_ir(std::ostream& os, Context* ctx);
+
+    class IRReader
+    {
+        /**
+         * Builds the module of a context out of textual IR (see write_ir()).
+         *
+         * The declarations standing behind the IR (function signatures,
+         * variables...) are owned by the reader. The context is reset when
+         * the reader is destroyed. Structures are not part of the textual
+         * IR, types naming one are rejected.
+         */
+
+        Context* ctx;
+        std::vector<ASTGlobal*> declarations;
+        std::vector<std::unique_ptr<TypeDecl>> variable_decls;
+        std::vector<std::unique_ptr<Variable>> variables;
+
+        friend struct IRParser;
+
+    public:
+        explicit IRReader(Context* ctx) : ctx(ctx) {}
+        IRReader(const IRReader&) = delete;
+        IRReader& operator=(const IRReader&) = delete;
+
+        /**
+         * @throws Exception on invalid IR, the message starts with its line
+         */
+        void read(const std::string& text);
+
+        ~IRReader();
+    };
+}
+
+#endif //CC_IR_TEXT_H
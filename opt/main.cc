@@ -0,0 +1,152 @@
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include "ir_text.h"
+#include "pass_manager.h"
+#include "passes.h"
+
+using namespace cc;
+
+static void usage(const char* program)
+{
+    std::cerr << "usage: " << program << " [OPTIONS] [INPUT].ir\n"
+              << "Read textual IR (stdin by default), optimize it and write it back\n"
+              << "  -o OUTPUT            write the IR to OUTPUT instead of stdout\n"
+              << "  --passes A,B,...     run exactly these passes in this order\n"
+              << "  --list-passes        print the builtin passes\n"
+              << "  -O0 -O1 -O2 -Os      optimization level (-O0 by default)\n"
+              << "  -fPASS -fno-PASS     enable or disable a single optimization pass\n"
+              << "  --opt-fuel N         stop optimizing after N changes to the IR\n"
+              << "  --opt-budget N       skip expensive passes on functions after N units of work\n"
+              << "  --opt-stats          print the time spent in every pass\n";
+}
+
+int main(int argc, const char* argv[])
+{
+    std::vector<std::string> args(argv + 1, argv + argc);
+    PassOptions options;
+    std::vector<std::string> pipeline;
+    std::string input;
+    std::string output;
+
+    for (size_t i = 0; i < args.size(); i++)
+    {
+        const std::string& arg = args[i];
+        bool has_value = i + 1 < args.size();
+
+        int used = options.parse_option(args, i, std::cerr);
+        if (used < 0)
+        {
+            usage(argv[0]);
+            return 1;
+        }
+        else if (used)
+        {
+            i += used - 1;
+        }
+        else if (arg == "-o" && has_value)
+        {
+            output = args[++i];
+        }
+        else if (arg == "--passes" && has_value)
+        {
+            for (const std::string& name : split_string(args[++i], ','))
+            {
+                if (!find_pass(name))
+                {
+                    std::cerr << "Unknown pass: " << name << "\n";
+                    return 1;
+                }
+                pipeline.push_back(name);
+            }
+        }
+        else if (arg == "--list-passes")
+        {
+            for (const PassInfo& info : builtin_passes())
+            {
+                std::cout << variadic_string("%-16s -O%d  %s\n", info.name, info.level, info.description);
+            }
+            return 0;
+        }
+        else if (arg.size() > 1 && arg[0] == '-')
+        {
+            std::cerr << "Unknown option: " << arg << "\n";
+            usage(argv[0]);
+            return 1;
+        }
+        else if (input.empty())
+        {
+            input = arg;
+        }
+        else
+        {
+            std::cerr << "Only one input may be given\n";
+            return 1;
+        }
+    }
+
+    if (!pipeline.empty() && (options.level != '0' || !options.passes.empty()))
+    {
+        std::cerr << "--passes may not be combined with -O or -f flags\n";
+        return 1;
+    }
+
+    std::stringstream text;
+    if (input.empty() || input == "-")
+    {
+        text << std::cin.rdbuf();
+    }
+    else
+    {
+        std::ifstream in(input, std::ios::binary);
+        if (!in)
+        {
+            std::cerr << "Failed to open " << input << "\n";
+            return 1;
+        }
+        text << in.rdbuf();
+    }
+
+    Context ctx;
+    try
+    {
+        IRReader reader(&ctx);
+        reader.read(text.str());
+
+        // An explicit pipeline runs once, in the given order
+        PassManager passes(options);
+        for (const std::string& name : pipeline)
+        {
+            passes.add(find_pass(name)->create());
+        }
+        passes.run(&ctx, ctx.get_module());
+
+        if (options.stats)
+        {
+            passes.print_statistics(std::cerr);
+        }
+
+        std::stringstream ir;
+        write_ir(ir, &ctx);
+        if (output.empty())
+        {
+            std::cout << ir.str();
+        }
+        else
+        {
+            std::ofstream out(output, std::ios::binary);
+            if (!(out << ir.str()))
+            {
+                std::cerr << "Failed to write " << output << "\n";
+                return 1;
+            }
+        }
+    }
+    catch (Exception& e)
+    {
+        std::cerr << (input.empty() ? "<stdin>" : input) << ":" << e.what() << "\n";
+        return 2;
+    }
+
+    return 0;
+}
@@ -0,0 +1,481 @@
+#include "memory_ssa.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <unordered_set>
+
+namespace cc
+{
+    static MemoryAccess::kind_t access_kind(const Instruction* instruction, bool& touches)
+    {
+        touches = true;
+        switch (instruction->get_opcode())
+        {
+            case Instruction::LOAD:
+                return MemoryAccess::USE;
+            case Instruction::STORE:
+            case Instruction::CALL:
+                return MemoryAccess::DEF;
+            default:
+                touches = false;
+                return MemoryAccess::DEF;
+        }
+    }
+
+    static const Reference* location_of(const Instruction* instruction)
+    {
+        switch (instruction->get_opcode())
+        {
+            case Instruction::LOAD:
+                return static_cast<const Reference*>(static_cast<const LoadInstr*>(instruction)->address.get());
+            case Instruction::STORE:
+                return static_cast<const Reference*>(static_cast<const StoreInstr*>(instruction)->address.get());
+            default:
+                return nullptr;
+        }
+    }
+
+    MemorySSA::MemorySSA(Function* f, AnalysisManager& am) :
+            dt(am.get<DominatorTree>(f)), df(am.get<DominanceFrontier>(f)),
+            accesses(f->get_block_bound()), live_on_entry(nullptr), generation(0)
+    {
+        live_on_entry = create(MemoryAccess::LIVE_ON_ENTRY, nullptr, nullptr);
+
+        std::vector<Block*> blocks = dt.get_blocks();
+        std::vector<Block*> work;
+        for (Block* block : blocks)
+        {
+            bool defines = false;
+            for (Instruction* instruction : *block)
+            {
+                bool touches;
+                MemoryAccess::kind_t kind = access_kind(instruction, touches);
+                if (touches)
+                {
+                    MemoryAccess* access = create(kind, block, instruction);
+                    accesses[block->get_index()].push_back(access);
+                    of_instruction[instruction] = access;
+                    defines = defines || kind == MemoryAccess::DEF;
+                }
+            }
+
+            if (defines)
+            {
+                work.push_back(block);
+            }
+        }
+
+        // Phis on the iterated dominance frontier of the defs
+        while (!work.empty())
+        {
+            Block* block = work.back();
+            work.pop_back();
+            for (Block* join : df.get(block))
+            {
+                if (!get_phi(join))
+                {
+                    add_phi(join);
+                    work.push_back(join);
+                }
+            }
+        }
+
+        rename(f->get_entry_block(), live_on_entry);
+    }
+
+    MemoryAccess* MemorySSA::create(MemoryAccess::kind_t kind, Block* block, Instruction* instruction)
+    {
+        storage.emplace_back(new MemoryAccess(kind, storage.size(), block, instruction));
+        return storage.back().get();
+    }
+
+    void MemorySSA::set_defining(MemoryAccess* access, MemoryAccess* defining)
+    {
+        if (access->defining == defining)
+        {
+            return;
+        }
+
+        if (access->defining)
+        {
+            std::vector<MemoryAccess*>& users = access->defining->users;
+            auto iter = std::find(users.begin(), users.end(), access);
+            assert(iter != users.end());
+            *iter = users.back();
+            users.pop_back();
+        }
+
+        access->defining = defining;
+        defining->users.push_back(access);
+    }
+
+    void MemorySSA::set_incoming(MemoryAccess* phi, size_t i, MemoryAccess* defining)
+    {
+        MemoryAccess*& slot = phi->incoming[i];
+        if (slot == defining)
+        {
+            return;
+        }
+
+        if (slot)
+        {
+            std::vector<MemoryAccess*>& users = slot->users;
+            auto iter = std::find(users.begin(), users.end(), phi);
+            assert(iter != users.end());
+            *iter = users.back();
+            users.pop_back();
+        }
+
+        slot = defining;
+        defining->users.push_back(phi);
+    }
+
+    MemoryAccess* MemorySSA::add_phi(Block* block)
+    {
+        MemoryAccess* phi = create(MemoryAccess::PHI, block, nullptr);
+        phi->incoming.resize(block->predecessors().size(), nullptr);
+
+        // Edges from unreachable blocks carry nothing
+        for (size_t i = 0; i < phi->incoming.size(); i++)
+        {
+            if (!dt.is_reachable(block->predecessors()[i]))
+            {
+                set_incoming(phi, i, live_on_entry);
+            }
+        }
+
+        accesses[block->get_index()].push_front(phi);
+        return phi;
+    }
+
+    void MemorySSA::rename(Block* root, MemoryAccess* state)
+    {
+        // The stack keeps every block with the state at its end and
+        // the next child in the dominator tree to visit
+        struct Frame
+        {
+            Block* block;
+            MemoryAccess* state;
+            size_t child;
+        };
+
+        std::vector<Frame> stack;
+        auto enter = [&](Block* block, MemoryAccess* in)
+        {
+            for (MemoryAccess* access : accesses[block->get_index()])
+            {
+                if (access->kind == MemoryAccess::PHI)
+                {
+                    in = access;
+                    continue;
+                }
+
+                set_defining(access, in);
+                if (access->kind == MemoryAccess::DEF)
+                {
+                    in = access;
+                }
+            }
+
+            for (Block* s : block->successors())
+            {
+                MemoryAccess* phi = get_phi(s);
+                if (!phi)
+                {
+                    continue;
+                }
+
+                const std::vector<Block*>& predecessors = s->predecessors();
+                for (size_t i = 0; i < predecessors.size(); i++)
+                {
+                    if (predecessors[i] == block)
+                    {
+                        set_incoming(phi, i, in);
+                    }
+                }
+            }
+
+            stack.push_back({block, in, 0});
+        };
+
+        enter(root, state);
+        while (!stack.empty())
+        {
+            Frame& top = stack.back();
+            const std::vector<Block*>& children = dt.get_children(top.block);
+            if (top.child == children.size())
+            {
+                stack.pop_back();
+                continue;
+            }
+
+            Block* child = children[top.child++];
+            enter(child, top.state);
+        }
+    }
+
+    MemoryAccess* MemorySSA::get_access(const Instruction* instruction) const
+    {
+        auto iter = of_instruction.find(instruction);
+        return iter == of_instruction.end() ? nullptr : iter->second;
+    }
+
+    MemoryAccess* MemorySSA::get_phi(const Block* block) const
+    {
+        const std::list<MemoryAccess*>& list = get_accesses(block);
+        return !list.empty() && list.front()->kind == MemoryAccess::PHI ? list.front() : nullptr;
+    }
+
+    const std::list<MemoryAccess*>& MemorySSA::get_accesses(const Block* block) const
+    {
+        assert(block->get_index() < accesses.size());
+        return accesses[block->get_index()];
+    }
+
+    MemoryAccess* MemorySSA::last_def(const Block* block) const
+    {
+        const std::list<MemoryAccess*>& list = get_accesses(block);
+        for (auto iter = list.rbegin(); iter != list.rend(); ++iter)
+        {
+            if ((*iter)->kind != MemoryAccess::USE)
+            {
+                return *iter;
+            }
+        }
+
+        return nullptr;
+    }
+
+    MemoryAccess* MemorySSA::get_in(const Block* block) const
+    {
+        assert(dt.is_reachable(block));
+        MemoryAccess* phi = get_phi(block);
+        if (phi)
+        {
+            return phi;
+        }
+
+        // Without a phi the state comes down the dominator tree
+        for (Block* idom = dt.get_idom(block); idom; idom = dt.get_idom(idom))
+        {
+            MemoryAccess* def = last_def(idom);
+            if (def)
+            {
+                return def;
+            }
+        }
+
+        return live_on_entry;
+    }
+
+    MemoryAccess* MemorySSA::get_out(const Block* block) const
+    {
+        MemoryAccess* def = last_def(block);
+        return def ? def : get_in(block);
+    }
+
+    bool MemorySSA::may_clobber(const MemoryAccess* def, const Reference* location) const
+    {
+        if (def->instruction->get_opcode() == Instruction::STORE)
+        {
+            return location_of(def->instruction) == location;
+        }
+
+        // Calls only reach the variables visible outside of the function
+        return !dynamic_cast<const AllocaInstr*>(location) || escapes(location);
+    }
+
+    MemoryAccess* MemorySSA::get_clobbering(MemoryAccess* access)
+    {
+        if (access->clobber && access->clobber_generation == generation)
+        {
+            return access->clobber;
+        }
+
+        const Reference* location = access->instruction ? location_of(access->instruction) : nullptr;
+        MemoryAccess* clobber = location ? get_clobbering(access->defining, location) : access->defining;
+
+        access->clobber = clobber;
+        access->clobber_generation = generation;
+        return clobber;
+    }
+
+    MemoryAccess* MemorySSA::get_clobbering(MemoryAccess* state, const Reference* location) const
+    {
+        // Follow the chain up to the first phi, past it every path has
+        // to find the same clobber or the phi itself is the answer
+        MemoryAccess* first_phi = nullptr;
+        MemoryAccess* found = nullptr;
+        std::unordered_set<const MemoryAccess*> visited;
+        std::vector<MemoryAccess*> work{state};
+        while (!work.empty())
+        {
+            MemoryAccess* access = work.back();
+            work.pop_back();
+
+            while (access->kind == MemoryAccess::DEF && !may_clobber(access, location))
+            {
+                access = access->defining;
+            }
+
+            if (access->kind == MemoryAccess::PHI)
+            {
+                if (!first_phi)
+                {
+                    first_phi = access;
+                }
+
+                // Going around a loop adds nothing new
+                if (visited.insert(access).second)
+                {
+                    work.insert(work.end(), access->incoming.begin(), access->incoming.end());
+                }
+                continue;
+            }
+
+            if (found && found != access)
+            {
+                return first_phi;
+            }
+            found = access;
+        }
+
+        return found ? found : first_phi;
+    }
+
+    MemoryAccess* MemorySSA::insert(Instruction* instruction)
+    {
+        bool touches;
+        MemoryAccess::kind_t kind = access_kind(instruction, touches);
+        Block* block = instruction->get_block();
+        if (!touches)
+        {
+            return nullptr;
+        }
+
+        assert(block && dt.is_reachable(block) && !get_access(instruction));
+        generation++;
+
+        // The access goes after the access of the last memory
+        // instruction before it, or right after the phi
+        std::list<MemoryAccess*>& list = accesses[block->get_index()];
+        auto position = list.begin();
+        if (position != list.end() && (*position)->kind == MemoryAccess::PHI)
+        {
+            ++position;
+        }
+
+        for (auto iter = InstructionIterator(block, instruction); iter != block->begin();)
+        {
+            MemoryAccess* previous = get_access(*--iter);
+            if (previous)
+            {
+                position = std::next(std::find(list.begin(), list.end(), previous));
+                break;
+            }
+        }
+
+        MemoryAccess* access = create(kind, block, instruction);
+        of_instruction[instruction] = access;
+        auto at = list.insert(position, access);
+
+        MemoryAccess* state = get_in(block);
+        for (auto iter = list.begin(); iter != at; ++iter)
+        {
+            if ((*iter)->kind == MemoryAccess::DEF)
+            {
+                state = *iter;
+            }
+        }
+
+        set_defining(access, state);
+        if (kind == MemoryAccess::USE)
+        {
+            return access;
+        }
+
+        // The accesses following up to the next def used the previous
+        // state, if there is none the state leaving the block changed
+        for (auto iter = std::next(at); iter != list.end(); ++iter)
+        {
+            set_defining(*iter, access);
+            if ((*iter)->kind == MemoryAccess::DEF)
+            {
+                return access;
+            }
+        }
+
+        std::vector<Block*> roots{block};
+        std::vector<Block*> work{block};
+        std::vector<MemoryAccess*> added;
+        while (!work.empty())
+        {
+            Block* b = work.back();
+            work.pop_back();
+            for (Block* join : df.get(b))
+            {
+                if (!get_phi(join))
+                {
+                    added.push_back(add_phi(join));
+                    roots.push_back(join);
+                    work.push_back(join);
+                }
+            }
+        }
+
+        for (Block* root : roots)
+        {
+            rename(root, get_in(root));
+        }
+
+        // Edges of new phis from blocks the new states do not reach
+        for (MemoryAccess* phi : added)
+        {
+            for (size_t i = 0; i < phi->incoming.size(); i++)
+            {
+                if (!phi->incoming[i])
+                {
+                    set_incoming(phi, i, get_out(phi->block->predecessors()[i]));
+                }
+            }
+        }
+
+        return access;
+    }
+
+    void MemorySSA::remove(const Instruction* instruction)
+    {
+        auto iter = of_instruction.find(instruction);
+        if (iter == of_instruction.end())
+        {
+            return;
+        }
+
+        MemoryAccess* access = iter->second;
+        of_instruction.erase(iter);
+        generation++;
+
+        std::vector<MemoryAccess*> users = access->users;
+        for (MemoryAccess* user : users)
+        {
+            if (user->kind != MemoryAccess::PHI)
+            {
+                set_defining(user, access->defining);
+                continue;
+            }
+
+            for (size_t i = 0; i < user->incoming.size(); i++)
+            {
+                if (user->incoming[i] == access)
+                {
+                    set_incoming(user, i, access->defining);
+                }
+            }
+        }
+
+        std::vector<MemoryAccess*>& defining_users = access->defining->users;
+        defining_users.erase(std::find(defining_users.begin(), defining_users.end(), access));
+        access->defining = nullptr;
+        accesses[access->block->get_index()].remove(access);
+    }
+}
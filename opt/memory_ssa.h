@@ -0,0 +1,156 @@
+#ifndef CC_OPT_MEMORY_SSA_H
+#define CC_OPT_MEMORY_SSA_H
+
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "analysis.h"
+
+namespace cc
+{
+    struct MemoryAccess
+    {
+        /**
+         * State of memory in the MemorySSA form of a function: loads
+         * use the state left by the last def before them, stores and
+         * calls define a new one out of it, phis merge the states
+         * reaching a join. Live on entry is the state the function
+         * starts with.
+         */
+
+        enum kind_t
+        {
+            LIVE_ON_ENTRY,
+            DEF,
+            USE,
+            PHI
+        };
+
+        kind_t kind;
+        uint32_t id;                            //!< Dense, in the order accesses are created
+        Block* block;                           //!< nullptr for live on entry
+        Instruction* instruction;               //!< Store or call for defs, load for uses
+        MemoryAccess* defining;                 //!< State a def or a use follows
+        std::vector<MemoryAccess*> incoming;    //!< Of a phi, one per edge in the order of Block::predecessors()
+        std::vector<MemoryAccess*> users;       //!< Once per operand slot holding this access
+
+        MemoryAccess(kind_t kind, uint32_t id, Block* block, Instruction* instruction) :
+        kind(kind), id(id), block(block), instruction(instruction), defining(nullptr),
+        clobber(nullptr), clobber_generation(0) {}
+
+    private:
+        MemoryAccess* clobber;                  //!< Cached answer of MemorySSA::get_clobbering()
+        uint64_t clobber_generation;
+
+        friend class MemorySSA;
+    };
+
+    class MemorySSA : public FunctionAnalysis
+    {
+        /**
+         * Memory dependences of the loads, stores and calls of a
+         * function as a single chain of memory states in SSA form.
+         * Phis are placed on the iterated dominance frontier of the
+         * blocks with defs. Unreachable blocks have no accesses.
+         *
+         * The chain is conservative: a load depends on the last def
+         * before it whatever it writes. get_clobbering() walks the
+         * chain on demand to skip the defs that cannot write the
+         * variable read. Locals are only written by the stores to
+         * them, calls write every global and the locals whose
+         * reference is used otherwise than as an address.
+         *
+         * Passes keep the form up to date through insert() and
+         * remove() instead of reporting FunctionAnalysis::MEMORY.
+         */
+
+        const DominatorTree& dt;
+        const DominanceFrontier& df;
+
+        std::vector<std::unique_ptr<MemoryAccess>> storage;
+        std::vector<std::list<MemoryAccess*>> accesses;    //!< Of each block index, phi first
+        std::unordered_map<const Instruction*, MemoryAccess*> of_instruction;
+        MemoryAccess* live_on_entry;
+        uint64_t generation;                                //!< Bumped by every update
+
+        MemoryAccess* create(MemoryAccess::kind_t kind, Block* block, Instruction* instruction);
+        static void set_defining(MemoryAccess* access, MemoryAccess* defining);
+        static void set_incoming(MemoryAccess* phi, size_t i, MemoryAccess* defining);
+        MemoryAccess* add_phi(Block* block);
+
+        /**
+         * Last def or phi of a block, nullptr if it has none
+         */
+        MemoryAccess* last_def(const Block* block) const;
+
+        /**
+         * Link the accesses of the dominator subtree of a block
+         * @param state state reaching the start of the block
+         */
+        void rename(Block* root, MemoryAccess* state);
+
+        bool may_clobber(const MemoryAccess* def, const Reference* location) const;
+
+    public:
+        static constexpr const char* NAME = "memory-ssa";
+        static constexpr unsigned DEPENDS = CFG | MEMORY;
+
+        MemorySSA(Function* f, AnalysisManager& am);
+
+        MemoryAccess* get_live_on_entry() const { return live_on_entry; }
+
+        /**
+         * @return nullptr for instructions not touching memory
+         *         and instructions of unreachable blocks
+         */
+        MemoryAccess* get_access(const Instruction* instruction) const;
+
+        /**
+         * @return nullptr for blocks without a phi
+         */
+        MemoryAccess* get_phi(const Block* block) const;
+
+        /**
+         * Accesses of a block in order, the phi first
+         */
+        const std::list<MemoryAccess*>& get_accesses(const Block* block) const;
+
+        /**
+         * State at the start and at the end of a reachable block
+         */
+        MemoryAccess* get_in(const Block* block) const;
+        MemoryAccess* get_out(const Block* block) const;
+
+        /**
+         * Nearest access before a load or a store which may have
+         * written the variable it accesses: a def, live on entry, or a
+         * phi where the paths reaching it disagree. Answers are cached
+         * until the next update.
+         */
+        MemoryAccess* get_clobbering(MemoryAccess* access);
+
+        /**
+         * Nearest access which may have written a variable, starting
+         * from a state and going up
+         */
+        MemoryAccess* get_clobbering(MemoryAccess* state, const Reference* location) const;
+
+        /**
+         * Add the access of a load, a store or a call put in a
+         * reachable block after the analysis was computed. Phis are
+         * added for a new def where its state now reaches a join, and
+         * the accesses it dominates are linked again.
+         * @return nullptr if the instruction does not touch memory
+         */
+        MemoryAccess* insert(Instruction* instruction);
+
+        /**
+         * Forget the access of an instruction about to be erased,
+         * the users of a def follow the state it followed instead
+         */
+        void remove(const Instruction* instruction);
+    };
+}
+
+#endif //CC_OPT_MEMORY_SSA_H
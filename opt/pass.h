@@ -0,0 +1,117 @@
+#ifndef CC_PASS_H
+#define CC_PASS_H
+
+#include <cstdint>
+#include <compilation/instruction.h>
+#include <compilation/module.h>
+#include "analysis.h"
+
+namespace cc
+{
+    class PassContext
+    {
+        /**
+         * State shared by the passes of a pipeline run.
+         *
+         * Every individual change made by a pass (an instruction folded or
+         * erased, a block removed...) burns one unit of optimization fuel.
+         * Once the fuel runs out passes stop changing the IR, bisecting the
+         * fuel finds the first change breaking a program.
+         *
+         * Passes report what they changed in a function through changed()
+         * before using any analysis again, the analyses depending on it are
+         * dropped right away.
+         */
+
+        Context* ctx;
+        AnalysisManager* am;
+        int64_t fuel;       //!< Negative for unlimited
+        unsigned changes;
+
+    public:
+        PassContext(Context* ctx, AnalysisManager* am, int64_t fuel) :
+                ctx(ctx), am(am), fuel(fuel), changes(0) {}
+
+        Context* context() const { return ctx; }
+        AnalysisManager& analyses() const { return *am; }
+
+        /**
+         * Report a change to a function
+         * @param what mask of FunctionAnalysis::depends_t
+         */
+        void changed(const Function* f, unsigned what)
+        {
+            am->invalidate(f, what);
+            changes |= what;
+        }
+
+        /**
+         * Changes reported since the last call
+         */
+        unsigned take_changes()
+        {
+            unsigned out = changes;
+            changes = 0;
+            return out;
+        }
+
+        /**
+         * Ask for one unit of fuel before changing the IR
+         * @return false if the change may not be made
+         */
+        bool consume()
+        {
+            if (fuel < 0)
+            {
+                return true;
+            }
+
+            if (fuel == 0)
+            {
+                return false;
+            }
+
+            fuel--;
+            return true;
+        }
+
+        int64_t remaining() const { return fuel; }
+    };
+
+    struct Pass
+    {
+        virtual const char* name() const = 0;
+
+        /**
+         * Expensive passes are skipped on functions that
+         * already went over their optimization budget
+         */
+        virtual bool is_expensive() const { return false; }
+
+        /**
+         * Work of a run per instruction of the function, in walks over
+         * the instructions, charged to the budget of the function
+         */
+        virtual uint32_t cost() const { return 1; }
+
+        virtual ~Pass() = default;
+    };
+
+    struct FunctionPass : public Pass
+    {
+        /**
+         * @return true if the function changed
+         */
+        virtual bool run(Function* f, PassContext& pc) = 0;
+    };
+
+    struct ModulePass : public Pass
+    {
+        /**
+         * @return true if the module changed
+         */
+        virtual bool run(Module* module, PassContext& pc) = 0;
+    };
+}
+
+#endif //CC_PASS_H
@@ -0,0 +1,311 @@
+#include "pass_manager.h"
+#include "passes.h"
+#include "utils.h"
+
+#include <cassert>
+#include <chrono>
+
+namespace cc
+{
+    // Rounds of function passes at -O2 and -Os
+    constexpr unsigned MAX_ROUNDS = 4;
+
+    PassOptions::PassOptions() :
+            level('0'), fuel(-1), budget(0), stats(false)
+    {
+    }
+
+    bool PassOptions::parse_flag(const std::string& arg, std::ostream& err)
+    {
+        if (arg.compare(0, 2, "-O") == 0)
+        {
+            std::string l = arg.substr(2);
+            if (l.empty())
+            {
+                level = '1';
+            }
+            else if (l == "0" || l == "1" || l == "2" || l == "s")
+            {
+                level = l[0];
+            }
+            else
+            {
+                err << "Unknown optimization level: " << arg << "\n";
+                return false;
+            }
+
+            return true;
+        }
+
+        bool enable = arg.compare(0, 5, "-fno-") != 0;
+        std::string name = arg.substr(enable ? 2 : 5);
+        if (!find_pass(name))
+        {
+            err << "Unknown pass: " << name << "\n";
+            return false;
+        }
+
+        passes[name] = enable;
+        return true;
+    }
+
+    int PassOptions::parse_option(const std::vector<std::string>& args, size_t i, std::ostream& err)
+    {
+        const std::string& arg = args[i];
+        bool has_value = i + 1 < args.size();
+
+        if (arg.compare(0, 2, "-O") == 0 || (arg.compare(0, 2, "-f") == 0 && arg.size() > 2))
+        {
+            return parse_flag(arg, err) ? 1 : -1;
+        }
+        else if (arg == "--opt-fuel" && has_value)
+        {
+            uint64_t value;
+            if (!parse_size(args[i + 1], value))
+            {
+                err << "Invalid optimization fuel: " << args[i + 1] << "\n";
+                return -1;
+            }
+            fuel = static_cast<int64_t>(value);
+            return 2;
+        }
+        else if (arg == "--opt-budget" && has_value)
+        {
+            uint64_t value;
+            if (!parse_size(args[i + 1], value))
+            {
+                err << "Invalid optimization budget: " << args[i + 1] << "\n";
+                return -1;
+            }
+            budget = value;
+            return 2;
+        }
+        else if (arg == "--opt-stats")
+        {
+            stats = true;
+            return 1;
+        }
+
+        return 0;
+    }
+
+    std::string PassOptions::flags() const
+    {
+        std::string out = std::string("O") + level + ";";
+        for (const auto& iter : passes)
+        {
+            out += (iter.second ? "f" : "fno-") + iter.first + ";";
+        }
+
+        if (fuel >= 0)
+        {
+            out += "fuel=" + std::to_string(fuel) + ";";
+        }
+
+        if (budget)
+        {
+            out += "budget=" + std::to_string(budget) + ";";
+        }
+
+        return out;
+    }
+
+    PassManager::PassManager(const PassOptions& options) :
+            options(options), rounds(options.level == '2' || options.level == 's' ? MAX_ROUNDS : 1),
+            fuel(options.fuel)
+    {
+        // Nothing in the pipeline grows the code, -Os is -O2
+        int level = options.level == 's' ? 2 : options.level - '0';
+        for (const PassInfo& info : builtin_passes())
+        {
+            auto flag = options.passes.find(info.name);
+            if (flag != options.passes.end() ? flag->second : level >= info.level)
+            {
+                add(info.create());
+            }
+        }
+
+        builtin_n = pipeline.size();
+    }
+
+    std::unique_ptr<PassManager> PassManager::clone() const
+    {
+        if (pipeline.size() != builtin_n)
+        {
+            return nullptr;
+        }
+
+        return std::unique_ptr<PassManager>(new PassManager(options));
+    }
+
+    void PassManager::merge_statistics(const PassManager& other)
+    {
+        assert(other.pipeline.size() == pipeline.size());
+        for (size_t i = 0; i < pipeline.size(); i++)
+        {
+            Statistics& s = pipeline[i].stats;
+            const Statistics& o = other.pipeline[i].stats;
+            s.runs += o.runs;
+            s.changes += o.changes;
+            s.skipped += o.skipped;
+            s.seconds += o.seconds;
+        }
+
+        analyses.merge_statistics(other.analyses);
+    }
+
+    bool PassManager::folds_on_build() const
+    {
+        if (options.fuel >= 0)
+        {
+            return false;
+        }
+
+        for (size_t i = 0; i < builtin_n; i++)
+        {
+            if (dynamic_cast<const ConstantFold*>(pipeline[i].pass.get()))
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    void PassManager::add(Pass* pass)
+    {
+        pipeline.push_back({std::unique_ptr<Pass>(pass), {0, 0, 0, 0}});
+    }
+
+    bool PassManager::run_pass(Entry& entry, Function* f, Module* module, PassContext& pc)
+    {
+        auto start = std::chrono::steady_clock::now();
+
+        bool changed;
+        pc.take_changes();
+        if (f)
+        {
+            changed = dynamic_cast<FunctionPass*>(entry.pass.get())->run(f, pc);
+            if (changed && !pc.take_changes())
+            {
+                analyses.invalidate(f, FunctionAnalysis::ALL);
+            }
+
+#ifndef NDEBUG
+            std::string broken;
+            if (!verify_cfg(f, broken))
+            {
+                throw Exception(std::string(entry.pass->name()) + " broke the CFG of "
+                                + f->get_name() + ": " + broken);
+            }
+#endif
+        }
+        else
+        {
+            changed = dynamic_cast<ModulePass*>(entry.pass.get())->run(module, pc);
+        }
+
+        entry.stats.seconds += std::chrono::duration<double>(
+                std::chrono::steady_clock::now() - start).count();
+        entry.stats.runs++;
+        entry.stats.changes += changed;
+        return changed;
+    }
+
+    bool PassManager::run(Context* ctx, Function* f)
+    {
+        if (!f->get_entry_block())
+        {
+            return false;
+        }
+
+        PassContext pc(ctx, &analyses, fuel);
+        uint64_t spent = 0;
+
+        bool changed = false;
+        bool round_changed = true;
+        for (unsigned round = 0; round < rounds && round_changed; round++)
+        {
+            round_changed = false;
+            for (Entry& entry : pipeline)
+            {
+                if (!dynamic_cast<FunctionPass*>(entry.pass.get()))
+                {
+                    continue;
+                }
+
+                if (entry.pass->is_expensive() && options.budget && spent >= options.budget)
+                {
+                    entry.stats.skipped++;
+                    continue;
+                }
+
+                if (options.budget)
+                {
+                    size_t size = 0;
+                    for (const Block* block : f->get_blocks())
+                    {
+                        size += block->size();
+                    }
+                    spent += size * entry.pass->cost();
+                }
+
+                round_changed = run_pass(entry, f, nullptr, pc) || round_changed;
+            }
+
+            changed = changed || round_changed;
+        }
+
+        analyses.clear(f);
+        fuel = pc.remaining();
+        return changed;
+    }
+
+    bool PassManager::run(Context* ctx, Module* module)
+    {
+        bool changed = false;
+        for (const auto& iter : module->get_symbols())
+        {
+            auto* f = dynamic_cast<Function*>(iter.second);
+            if (f)
+            {
+                changed = run(ctx, f) || changed;
+            }
+        }
+
+        return run_module_passes(ctx, module) || changed;
+    }
+
+    bool PassManager::run_module_passes(Context* ctx, Module* module)
+    {
+        bool changed = false;
+        PassContext pc(ctx, &analyses, fuel);
+        for (Entry& entry : pipeline)
+        {
+            if (dynamic_cast<ModulePass*>(entry.pass.get()))
+            {
+                changed = run_pass(entry, nullptr, module, pc) || changed;
+            }
+        }
+
+        fuel = pc.remaining();
+        return changed;
+    }
+
+    void PassManager::print_statistics(std::ostream& os) const
+    {
+        os << variadic_string("%-16s %8s %8s %8s %10s\n", "pass", "runs", "changed", "skipped", "time");
+        for (const Entry& entry : pipeline)
+        {
+            os << variadic_string("%-16s %8lu %8lu %8lu %8.3fms\n", entry.pass->name(),
+                                  entry.stats.runs, entry.stats.changes, entry.stats.skipped,
+                                  entry.stats.seconds * 1000);
+        }
+
+        analyses.print_statistics(os);
+        if (fuel == 0)
+        {
+            os << "optimization fuel exhausted\n";
+        }
+    }
+}
@@ -0,0 +1,146 @@
+#ifndef CC_PASS_MANAGER_H
+#define CC_PASS_MANAGER_H
+
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "pass.h"
+
+namespace cc
+{
+    struct PassOptions
+    {
+        char level;                             //!< '0', '1', '2' or 's'
+        std::map<std::string, bool> passes;     //!< -fPASS and -fno-PASS
+        int64_t fuel;                           //!< Negative for unlimited
+        uint64_t budget;                        //!< Per function (see Pass::cost()), 0 for unlimited
+        bool stats;
+
+        PassOptions();
+
+        /**
+         * Handle -O<level>, -f<pass> and -fno-<pass>
+         * @param arg command line argument
+         * @param err error messages for invalid flags
+         * @return false if the flag is invalid
+         */
+        bool parse_flag(const std::string& arg, std::ostream& err);
+
+        /**
+         * Handle the optimization options at args[i]: the flags above,
+         * --opt-fuel N, --opt-budget N and --opt-stats
+         * @param err error messages for invalid options
+         * @return number of arguments used, 0 if args[i] is not an
+         *         optimization option and -1 if it is invalid
+         */
+        int parse_option(const std::vector<std::string>& args, size_t i, std::ostream& err);
+
+        /**
+         * Canonical representation of the options changing the output
+         */
+        std::string flags() const;
+    };
+
+    class PassManager
+    {
+        /**
+         * Runs a pipeline of passes over the IR of a module.
+         *
+         * The pipeline is made of the builtin passes enabled by the
+         * optimization level (and the per-pass flags) followed by the
+         * passes added to the manager. Function passes run over every
+         * function, in rounds until no pass changes the function or the
+         * round limit of the level is reached, module passes run once
+         * all functions are optimized.
+         *
+         * With a budget, expensive passes are skipped on functions that
+         * already spent it in the pipeline. Every run of a pass spends
+         * its cost times the number of instructions of the function, so
+         * that the same input always skips the same passes.
+         *
+         * Analyses are cached for the duration of the pipeline of a function
+         * and dropped as passes report changes, a pass changing a function
+         * without reporting what it changed drops all of them.
+         */
+
+        struct Statistics
+        {
+            uint64_t runs;
+            uint64_t changes;
+            uint64_t skipped;       //!< Over the budget
+            double seconds;
+        };
+
+        struct Entry
+        {
+            std::unique_ptr<Pass> pass;
+            Statistics stats;
+        };
+
+        PassOptions options;
+        AnalysisManager analyses;
+        std::vector<Entry> pipeline;
+        size_t builtin_n;       //!< Passes of the pipeline coming from the options
+        unsigned rounds;
+        int64_t fuel;
+
+        bool run_pass(Entry& entry, Function* f, Module* module, PassContext& pc);
+
+    public:
+        explicit PassManager(const PassOptions& options);
+        PassManager(const PassManager&) = delete;
+        PassManager& operator=(const PassManager&) = delete;
+
+        /**
+         * Append a pass to the pipeline, the manager takes ownership
+         */
+        void add(Pass* pass);
+        bool empty() const { return pipeline.empty(); }
+
+        /**
+         * Whether lowering may simplify the values it builds (see Folder):
+         * constant folding is in the pipeline and no fuel limits the
+         * changes, lowering does not spend any
+         */
+        bool folds_on_build() const;
+        const AnalysisManager& get_analyses() const { return analyses; }
+        const PassOptions& get_options() const { return options; }
+
+        /**
+         * Create a manager running the same pipeline with its own analyses,
+         * statistics and fuel, to run the function passes on another thread
+         * @return nullptr if passes were added to the pipeline with add()
+         */
+        std::unique_ptr<PassManager> clone() const;
+
+        /**
+         * Add the statistics of a clone to these
+         */
+        void merge_statistics(const PassManager& other);
+
+        /**
+         * Run the function passes over a single function
+         * @return true if the function changed
+         */
+        bool run(Context* ctx, Function* f);
+
+        /**
+         * Run the function passes over every function
+         * with a body, then the module passes
+         * @return true if the module changed
+         */
+        bool run(Context* ctx, Module* module);
+
+        /**
+         * Run the module passes only
+         * @return true if the module changed
+         */
+        bool run_module_passes(Context* ctx, Module* module);
+
+        void print_statistics(std::ostream& os) const;
+    };
+}
+
+#endif //CC_PASS_MANAGER_H
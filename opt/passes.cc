@@ -0,0 +1,480 @@
+#include "passes.h"
+#include "dataflow.h"
+#include "scalar_evolution.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <cassert>
+#include <memory>
+#include <unordered_set>
+
+namespace cc
+{
+    bool ConstantFold::run(Function* f, PassContext& pc)
+    {
+        ConstantPool& constants = pc.context()->get_module()->constants();
+        bool changed = false;
+        for (Block* block : pc.analyses().get<BlockOrder>(f).blocks)
+        {
+            for (auto it = block->begin(); it != block->end();)
+            {
+                std::unique_ptr<Constant> c(fold_constant(*it));
+                if (!c || !pc.consume())
+                {
+                    ++it;
+                    continue;
+                }
+
+                as_value(*it)->replace_all_uses_with(constants.get(c.get()));
+                it = block->erase(it);
+                changed = true;
+            }
+        }
+
+        if (changed)
+        {
+            pc.changed(f, FunctionAnalysis::INSTRUCTIONS);
+        }
+
+        return changed;
+    }
+
+    static bool fold_branch(Block* block, PassContext& pc)
+    {
+        const auto* branch = dynamic_cast<const BranchInstr*>(block->get_terminator());
+        if (!branch)
+        {
+            return false;
+        }
+
+        Block* target;
+        const auto* condition = as_numeric(branch->condition);
+        if (branch->target == branch->otherwise)
+        {
+            target = branch->target;
+        }
+        else if (condition)
+        {
+            bool taken = condition->type == NumericExpr::FLOATING
+                         ? condition->value.floating != 0
+                         : condition->value.integer != 0;
+            target = taken ? branch->target : branch->otherwise;
+        }
+        else
+        {
+            return false;
+        }
+
+        if (!pc.consume())
+        {
+            return false;
+        }
+
+        block->replace(std::prev(block->end()), new JumpInstr(target));
+        return true;
+    }
+
+    static bool remove_unreachable(Function* f, PassContext& pc)
+    {
+        std::vector<Block*> blocks = function_blocks(f);
+        const ControlFlow& cfg = pc.analyses().get<ControlFlow>(f);
+        std::vector<Block*> live;
+        for (Block* block : blocks)
+        {
+            if (cfg.is_reachable(block))
+            {
+                live.push_back(block);
+            }
+        }
+
+        // Unreachable blocks whose values are used by the rest of
+        // the function are kept, so are the blocks they jump to
+        std::unordered_map<const IR*, size_t> live_uses = count_uses(live);
+        std::unordered_set<Block*> kept;
+        std::vector<Block*> stack;
+        for (Block* block : blocks)
+        {
+            if (cfg.is_reachable(block))
+            {
+                continue;
+            }
+
+            for (const Instruction* instr : *block)
+            {
+                if (live_uses.find(as_value(instr)) != live_uses.end())
+                {
+                    stack.push_back(block);
+                    break;
+                }
+            }
+        }
+
+        while (!stack.empty())
+        {
+            Block* block = stack.back();
+            stack.pop_back();
+            if (!cfg.is_reachable(block) && kept.insert(block).second)
+            {
+                stack.insert(stack.end(), block->successors().begin(), block->successors().end());
+            }
+        }
+
+        std::unordered_set<Block*> dead;
+        for (Block* block : blocks)
+        {
+            if (!cfg.is_reachable(block) && !kept.count(block) && pc.consume())
+            {
+                dead.insert(block);
+            }
+        }
+
+        // Without fuel for all of them, the blocks still jumped to stay
+        bool shrunk = true;
+        while (shrunk)
+        {
+            shrunk = false;
+            for (Block* block : blocks)
+            {
+                if (!dead.count(block))
+                {
+                    continue;
+                }
+
+                for (Block* pred : block->predecessors())
+                {
+                    if (!dead.count(pred))
+                    {
+                        dead.erase(block);
+                        shrunk = true;
+                        break;
+                    }
+                }
+            }
+        }
+
+        // Drop the edges first, dead blocks may jump to each other
+        for (Block* block : blocks)
+        {
+            if (dead.count(block))
+            {
+                block->erase(std::prev(block->end()));
+            }
+        }
+
+        for (Block* block : blocks)
+        {
+            if (dead.count(block))
+            {
+                f->remove_destructor_block(block);
+                block->get_scope()->remove_block(block);
+            }
+        }
+
+        return !dead.empty();
+    }
+
+    static bool merge_blocks(Function* f, PassContext& pc)
+    {
+        bool changed = false;
+        std::unordered_set<Block*> removed;
+        for (Block* block : function_blocks(f))
+        {
+            if (removed.count(block))
+            {
+                continue;
+            }
+
+            // Absorb chains of blocks in a single visit
+            for (;;)
+            {
+                const auto* jump = dynamic_cast<const JumpInstr*>(block->get_terminator());
+                Block* next = jump ? jump->target : nullptr;
+                if (!next || next == block || next == f->get_entry_block()
+                    || next->predecessors().size() != 1 || !pc.consume())
+                {
+                    break;
+                }
+
+                block->absorb(next);
+                if (f->get_destructor_blocks().count(next))
+                {
+                    f->remove_destructor_block(next);
+                    f->add_destructor_block(block);
+                }
+
+                next->get_scope()->remove_block(next);
+                removed.insert(next);
+                changed = true;
+            }
+        }
+
+        return changed;
+    }
+
+    bool SimplifyCFG::run(Function* f, PassContext& pc)
+    {
+        bool changed = false;
+        for (Block* block : f->get_blocks())
+        {
+            changed = fold_branch(block, pc) || changed;
+        }
+
+        if (changed)
+        {
+            pc.changed(f, FunctionAnalysis::CFG);
+        }
+
+        bool removed = remove_unreachable(f, pc);
+        removed = merge_blocks(f, pc) || removed;
+        if (removed)
+        {
+            pc.changed(f, FunctionAnalysis::ALL);
+        }
+
+        return changed || removed;
+    }
+
+    bool DeadCodeElimination::run(Function* f, PassContext& pc)
+    {
+        const std::vector<Block*>& blocks = pc.analyses().get<BlockOrder>(f).blocks;
+
+        bool changed = false;
+        bool erased = true;
+        unsigned what = FunctionAnalysis::INSTRUCTIONS;
+        while (erased)
+        {
+            // Walk backwards so that chains of dead values
+            // within a block go away in a single sweep
+            erased = false;
+            for (auto b = blocks.rbegin(); b != blocks.rend(); ++b)
+            {
+                Block* block = *b;
+                for (auto it = block->end(); it != block->begin();)
+                {
+                    --it;
+                    if (!is_removable(*it) || !as_value(*it)->use_empty() || !pc.consume())
+                    {
+                        continue;
+                    }
+
+                    if ((*it)->get_opcode() == Instruction::LOAD)
+                    {
+                        what |= FunctionAnalysis::MEMORY;
+                    }
+
+                    it = block->erase(it);
+                    erased = true;
+                }
+            }
+
+            changed = changed || erased;
+        }
+
+        if (changed)
+        {
+            pc.changed(f, what);
+        }
+
+        return changed;
+    }
+
+    // The loop and the loops nested in it end
+    static bool is_finite(const NaturalLoop* loop, const ScalarEvolution& se)
+    {
+        int64_t count;
+        if (!se.get_trip_count(loop, count))
+        {
+            return false;
+        }
+
+        for (const NaturalLoop* child : loop->get_children())
+        {
+            if (!is_finite(child, se))
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    static bool delete_loop(const NaturalLoop* loop, ScalarEvolution& se, Liveness& liveness, PassContext& pc)
+    {
+        Block* preheader = loop->get_preheader();
+        if (!preheader || loop->get_exits().size() != 1 || !is_finite(loop, se))
+        {
+            return false;
+        }
+
+        // Nothing computed in the loop may be seen past it but
+        // the variables it stores to
+        std::vector<const Reference*> stored;
+        for (Block* block : loop->get_blocks())
+        {
+            for (Instruction* instruction : *block)
+            {
+                switch (instruction->get_opcode())
+                {
+                    case Instruction::JUMP:
+                    case Instruction::BRANCH:
+                    case Instruction::ALLOCA:
+                        break;
+                    case Instruction::STORE:
+                    {
+                        const auto* variable = static_cast<const Reference*>(
+                                static_cast<const StoreInstr*>(instruction)->address.get());
+                        if (!dynamic_cast<const AllocaInstr*>(variable) || escapes(variable))
+                        {
+                            return false;
+                        }
+
+                        if (std::find(stored.begin(), stored.end(), variable) == stored.end())
+                        {
+                            stored.push_back(variable);
+                        }
+                        break;
+                    }
+                    default:
+                        if (!is_removable(instruction))
+                        {
+                            return false;
+                        }
+                        break;
+                }
+
+                for (const Use* use = as_value(instruction)->get_uses(); use; use = use->get_next())
+                {
+                    if (!loop->contains(use->get_user()->get_block()))
+                    {
+                        return false;
+                    }
+                }
+            }
+        }
+
+        // Values read after the loop, the value on entry plus a constant
+        // for variables the loop does not start from a constant
+        Block* exit = loop->get_exits()[0];
+        std::vector<std::pair<const Reference*, AddRecurrence>> exit_values;
+        for (const Reference* variable : stored)
+        {
+            if (!liveness.is_live_in(variable, exit))
+            {
+                continue;
+            }
+
+            AddRecurrence value;
+            if (!se.get_exit_value(loop, variable, value))
+            {
+                return false;
+            }
+
+            exit_values.emplace_back(variable, value);
+        }
+
+        // The stores go in the exit, it must only be reached from the loop
+        for (const Block* pred : exit->predecessors())
+        {
+            if (!exit_values.empty() && !loop->contains(pred))
+            {
+                return false;
+            }
+        }
+
+        if (!pc.consume())
+        {
+            return false;
+        }
+
+        ConstantPool& constants = pc.context()->get_module()->constants();
+        auto first = exit->begin();
+        for (const auto& exit_value : exit_values)
+        {
+            const Reference* variable = exit_value.first;
+            const Type* type = variable->get_type(pc.context());
+            const std::vector<int64_t>& c = exit_value.second.get_steps();
+            const IR* value = constants.integer(c.empty() ? 0 : c[0]);
+            if (exit_value.second.get_base())
+            {
+                assert(exit_value.second.get_base() == variable);
+                if (c.empty())
+                {
+                    continue;
+                }
+
+                auto* load = new LoadInstr(variable, type, type->get_alignment());
+                exit->insert(first, load);
+                value = *exit->insert(first, new AddInstr(load, value));
+            }
+
+            exit->insert(first, new StoreInstr(variable, value, type->get_alignment()));
+        }
+
+        preheader->replace(std::prev(preheader->end()), new JumpInstr(exit));
+        return true;
+    }
+
+    bool LoopDeletion::run(Function* f, PassContext& pc)
+    {
+        const LoopInfo& loops = pc.analyses().get<LoopInfo>(f);
+        if (loops.get_top_level().empty())
+        {
+            return false;
+        }
+
+        ScalarEvolution& se = pc.analyses().get<ScalarEvolution>(f);
+        Liveness& liveness = pc.analyses().get<Liveness>(f);
+
+        // Outer loops first, the loops nested in a deleted one go with it
+        std::vector<NaturalLoop*> order = loops.get_loops();
+        std::unordered_set<const NaturalLoop*> deleted;
+        for (auto l = order.rbegin(); l != order.rend(); ++l)
+        {
+            bool nested = false;
+            for (const NaturalLoop* parent = (*l)->get_parent(); parent; parent = parent->get_parent())
+            {
+                nested = nested || deleted.count(parent);
+            }
+
+            if (!nested && delete_loop(*l, se, liveness, pc))
+            {
+                deleted.insert(*l);
+            }
+        }
+
+        if (!deleted.empty())
+        {
+            pc.changed(f, FunctionAnalysis::ALL);
+        }
+
+        return !deleted.empty();
+    }
+
+    template<typename T>
+    static Pass* create() { return new T(); }
+
+    const std::vector<PassInfo>& builtin_passes()
+    {
+        static const std::vector<PassInfo> passes = {
+                {"constant-fold", "fold instructions on constant operands", 1, create<ConstantFold>},
+                {"loop-delete", "delete loops whose results have a closed form", 2, create<LoopDeletion>},
+                {"simplify-cfg", "remove constant branches and unreachable code", 1, create<SimplifyCFG>},
+                {"dce", "remove unused pure instructions and loads", 1, create<DeadCodeElimination>},
+        };
+
+        return passes;
+    }
+
+    const PassInfo* find_pass(const std::string& name)
+    {
+        for (const PassInfo& info : builtin_passes())
+        {
+            if (name == info.name)
+            {
+                return &info;
+            }
+        }
+
+        return nullptr;
+    }
+}
@@ -0,0 +1,78 @@
+#ifndef CC_PASSES_H
+#define CC_PASSES_H
+
+#include <string>
+#include <vector>
+#include "pass.h"
+
+namespace cc
+{
+    struct ConstantFold : public FunctionPass
+    {
+        /**
+         * Replace arithmetic, logical and bitwise instructions whose
+         * operands are all numeric constants by their value.
+         * Integer operations that would overflow or divide by zero
+         * are left for the runtime.
+         */
+
+        const char* name() const override { return "constant-fold"; }
+        bool run(Function* f, PassContext& pc) override;
+    };
+
+    struct SimplifyCFG : public FunctionPass
+    {
+        /**
+         * Turn branches on constant conditions into jumps, remove the
+         * blocks that cannot be reached from the entry block and merge
+         * blocks into their only predecessor when it jumps to them.
+         */
+
+        const char* name() const override { return "simplify-cfg"; }
+        bool run(Function* f, PassContext& pc) override;
+    };
+
+    struct DeadCodeElimination : public FunctionPass
+    {
+        /**
+         * Erase pure instructions whose value is never used,
+         * repeated until the operands they used are dead too.
+         */
+
+        const char* name() const override { return "dce"; }
+        bool is_expensive() const override { return true; }
+        uint32_t cost() const override { return 2; }
+        bool run(Function* f, PassContext& pc) override;
+    };
+
+    struct LoopDeletion : public FunctionPass
+    {
+        /**
+         * Delete the loops with a known trip count whose only effect
+         * is on local variables. The variables read after the loop
+         * get the value it leaves them with from the closed form of
+         * their recurrence, stored on the way out.
+         */
+
+        const char* name() const override { return "loop-delete"; }
+        bool is_expensive() const override { return true; }
+        uint32_t cost() const override { return 8; }       // Loop tree and scalar evolution
+        bool run(Function* f, PassContext& pc) override;
+    };
+
+    struct PassInfo
+    {
+        const char* name;
+        const char* description;
+        int level;          //!< Lowest optimization level running the pass
+        Pass* (*create)();
+    };
+
+    /**
+     * Builtin passes in the order they run in a pipeline
+     */
+    const std::vector<PassInfo>& builtin_passes();
+    const PassInfo* find_pass(const std::string& name);
+}
+
+#endif //CC_PASSES_H
@@ -0,0 +1,699 @@
+#include "scalar_evolution.h"
+#include "memory_ssa.h"
+#include "utils.h"
+
+#include <algorithm>
+
+namespace cc
+{
+    AddRecurrence::AddRecurrence(int64_t c, const Reference* base) :
+            base(base), steps{c}
+    {
+        trim();
+    }
+
+    void AddRecurrence::trim()
+    {
+        while (!steps.empty() && steps.back() == 0)
+        {
+            steps.pop_back();
+        }
+    }
+
+    bool AddRecurrence::add(const AddRecurrence& other)
+    {
+        if (other.base)
+        {
+            if (base)
+            {
+                return false;
+            }
+            base = other.base;
+        }
+
+        if (steps.size() < other.steps.size())
+        {
+            steps.resize(other.steps.size(), 0);
+        }
+
+        for (size_t i = 0; i < other.steps.size(); i++)
+        {
+            if (__builtin_add_overflow(steps[i], other.steps[i], &steps[i]))
+            {
+                return false;
+            }
+        }
+
+        trim();
+        return true;
+    }
+
+    bool AddRecurrence::subtract(const AddRecurrence& other)
+    {
+        if (other.base)
+        {
+            if (base != other.base)
+            {
+                return false;
+            }
+            base = nullptr;
+        }
+
+        if (steps.size() < other.steps.size())
+        {
+            steps.resize(other.steps.size(), 0);
+        }
+
+        for (size_t i = 0; i < other.steps.size(); i++)
+        {
+            if (__builtin_sub_overflow(steps[i], other.steps[i], &steps[i]))
+            {
+                return false;
+            }
+        }
+
+        trim();
+        return true;
+    }
+
+    bool AddRecurrence::multiply(int64_t factor)
+    {
+        if (factor == 0)
+        {
+            base = nullptr;
+            steps.clear();
+            return true;
+        }
+
+        if (base && factor != 1)
+        {
+            return false;
+        }
+
+        for (int64_t& c : steps)
+        {
+            if (__builtin_mul_overflow(c, factor, &c))
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    bool AddRecurrence::shift()
+    {
+        for (size_t i = 0; i + 1 < steps.size(); i++)
+        {
+            if (__builtin_add_overflow(steps[i], steps[i + 1], &steps[i]))
+            {
+                return false;
+            }
+        }
+
+        trim();
+        return true;
+    }
+
+    bool AddRecurrence::accumulate(int64_t c, const Reference* from)
+    {
+        if (base)
+        {
+            return false;
+        }
+
+        base = from;
+        steps.insert(steps.begin(), c);
+        trim();
+        return true;
+    }
+
+    bool AddRecurrence::evaluate(int64_t k, int64_t& offset) const
+    {
+        assert(k >= 0);
+
+        // C(k, j) follows from C(k, j - 1) * (k - j + 1) / j
+        int64_t binomial = 1;
+        offset = 0;
+        for (size_t j = 0; j < steps.size(); j++)
+        {
+            if (j > 0)
+            {
+                if (k - static_cast<int64_t>(j) + 1 <= 0)
+                {
+                    break;
+                }
+
+                if (__builtin_mul_overflow(binomial, k - static_cast<int64_t>(j) + 1, &binomial))
+                {
+                    return false;
+                }
+                binomial /= static_cast<int64_t>(j);
+            }
+
+            int64_t term;
+            if (__builtin_mul_overflow(steps[j], binomial, &term)
+                || __builtin_add_overflow(offset, term, &offset))
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    // a runs before b in an iteration of a loop running both every time
+    static bool precedes(const Instruction* a, const Instruction* b, const DominatorTree& dt)
+    {
+        if (a->get_block() != b->get_block())
+        {
+            return dt.strictly_dominates(a->get_block(), b->get_block());
+        }
+
+        for (auto iter = InstructionIterator(a->get_block(), const_cast<Instruction*>(a)); *iter; ++iter)
+        {
+            if (*iter == b)
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    // Values in a loop as recurrences of its iterations. The
+    // variable being resolved may appear in them once, as the
+    // load of its value at the start of the iteration.
+    struct ScalarEvolution::Evaluation
+    {
+        const NaturalLoop* loop;
+        const DominatorTree& dt;
+        MemorySSA& mssa;
+        const std::unordered_map<const Reference*, const StoreInstr*>& stores;
+        const std::unordered_map<const Reference*, Variable>& variables;
+        const StoreInstr* self;         //!< Store of the variable resolved, nullptr for the exit test
+
+        struct Value
+        {
+            int64_t self;               //!< Times the value of the variable resolved is added
+            AddRecurrence rest;
+        };
+
+        std::unordered_map<const IR*, std::pair<bool, Value>> memo;
+
+        bool load(const LoadInstr* instr, Value& out);
+        bool get(const IR* value, Value& out);
+    };
+
+    bool ScalarEvolution::Evaluation::load(const LoadInstr* instr, Value& out)
+    {
+        const auto* variable = static_cast<const Reference*>(instr->address.get());
+        auto store = stores.find(variable);
+        if (!loop->contains(instr->get_block()) || store == stores.end())
+        {
+            // Variables the loop does not write keep the last
+            // constant stored to them before
+            MemoryAccess* access = mssa.get_access(instr);
+            MemoryAccess* clobber = access ? mssa.get_clobbering(access) : nullptr;
+            if (!clobber || clobber->kind != MemoryAccess::DEF
+                || clobber->instruction->get_opcode() != Instruction::STORE)
+            {
+                return false;
+            }
+
+            const NumericExpr* c = as_numeric(static_cast<const StoreInstr*>(clobber->instruction)->value);
+            if (!c || c->type == NumericExpr::FLOATING)
+            {
+                return false;
+            }
+
+            out.rest = AddRecurrence(c->value.integer);
+            return true;
+        }
+
+        if (self && store->second == self)
+        {
+            out.self = 1;
+            return precedes(instr, self, dt);
+        }
+
+        auto known = variables.find(variable);
+        if (known == variables.end() || known->second.kind != Variable::RECURRENCE)
+        {
+            return false;
+        }
+
+        out.rest = known->second.value;
+        if (precedes(store->second, instr, dt))
+        {
+            return out.rest.shift();
+        }
+
+        return precedes(instr, store->second, dt);
+    }
+
+    bool ScalarEvolution::Evaluation::get(const IR* value, Value& out)
+    {
+        out = {0, AddRecurrence()};
+        const NumericExpr* c = as_numeric(value);
+        if (c)
+        {
+            out.rest = AddRecurrence(c->value.integer);
+            return c->type != NumericExpr::FLOATING;
+        }
+
+        // Unsigned arithmetic wraps around, recurrences do not
+        const auto* instr = dynamic_cast<const Instruction*>(value);
+        const Type* type = instr ? instr->get_type(nullptr) : nullptr;
+        if (!instr || !instr->get_block() || (type && type->is_unsigned()))
+        {
+            return false;
+        }
+
+        auto cached = memo.find(value);
+        if (cached != memo.end())
+        {
+            out = cached->second.second;
+            return cached->second.first;
+        }
+
+        bool ok = false;
+        Value a, b;
+        switch (instr->get_opcode())
+        {
+            case Instruction::LOAD:
+                ok = load(static_cast<const LoadInstr*>(instr), out);
+                break;
+            case Instruction::ADD:
+            case Instruction::SUB:
+            {
+                const auto* self_ = static_cast<const BinaryInstr*>(instr);
+                bool add = instr->get_opcode() == Instruction::ADD;
+                ok = get(self_->a, a) && get(self_->b, b)
+                     && (add ? a.rest.add(b.rest) : a.rest.subtract(b.rest));
+                out = {add ? a.self + b.self : a.self - b.self, a.rest};
+                break;
+            }
+            case Instruction::MUL:
+            {
+                const auto* self_ = static_cast<const BinaryInstr*>(instr);
+                ok = get(self_->a, a) && get(self_->b, b);
+                if (b.self || b.rest.degree() || b.rest.get_base())
+                {
+                    std::swap(a, b);
+                }
+
+                // Only products by constants stay recurrences
+                int64_t factor = b.rest.get_steps().empty() ? 0 : b.rest.get_steps()[0];
+                ok = ok && !b.self && !b.rest.degree() && !b.rest.get_base()
+                     && !__builtin_mul_overflow(a.self, factor, &a.self) && a.rest.multiply(factor);
+                out = a;
+                break;
+            }
+            case Instruction::INC:
+            case Instruction::DEC:
+                ok = get(static_cast<const UnaryInstr*>(instr)->v, out)
+                     && out.rest.add(AddRecurrence(instr->get_opcode() == Instruction::INC ? 1 : -1));
+                break;
+            default:
+                break;
+        }
+
+        memo[value] = {ok, out};
+        return ok;
+    }
+
+    ScalarEvolution::ScalarEvolution(Function* f, AnalysisManager& am)
+    {
+        const LoopInfo& li = am.get<LoopInfo>(f);
+        const DominatorTree& dt = am.get<DominatorTree>(f);
+        MemorySSA& mssa = am.get<MemorySSA>(f);
+        for (const NaturalLoop* loop : li.get_loops())
+        {
+            analyze(loop, dt, li, mssa);
+        }
+    }
+
+    // A signed integer variable of the type holds the value
+    static bool fits(int64_t value, const Type* type)
+    {
+        int bits = type->get_size() * 8;
+        return bits >= 64 || (value >= -(INT64_C(1) << (bits - 1)) && value < (INT64_C(1) << (bits - 1)));
+    }
+
+    // Iterations run before the exit test first leaves the loop, false
+    // if it never does. The test compares d with 0 as the opcode of a
+    // comparison does, L_NOT stands for d != 0, and the loop goes on
+    // while the result is continues.
+    static bool solve_exit(Instruction::opcode_t relation, bool continues, const AddRecurrence& d, int64_t& exit)
+    {
+        int64_t d0 = d.get_steps().empty() ? 0 : d.get_steps()[0];
+        int64_t d1 = d.get_steps().size() < 2 ? 0 : d.get_steps()[1];
+        if (d.get_base() || d.degree() > 1 || d0 == INT64_MIN || d1 == INT64_MIN)
+        {
+            return false;
+        }
+
+        static const Instruction::opcode_t negated[] = {Instruction::GE, Instruction::LE,
+                                                        Instruction::GT, Instruction::LT};
+        if (!continues)
+        {
+            relation = relation == Instruction::EQ ? Instruction::L_NOT
+                     : relation == Instruction::L_NOT ? Instruction::EQ
+                     : negated[relation - Instruction::LT];
+        }
+
+        // Only d < 0, d <= 0, d == 0 and d != 0 are left
+        if (relation == Instruction::GT || relation == Instruction::GE)
+        {
+            relation = relation == Instruction::GT ? Instruction::LT : Instruction::LE;
+            d0 = -d0;
+            d1 = -d1;
+        }
+
+        switch (relation)
+        {
+            case Instruction::LT:
+                exit = d0 >= 0 ? 0 : d1 <= 0 ? -1 : (-d0 - 1) / d1 + 1;
+                break;
+            case Instruction::LE:
+                exit = d0 > 0 ? 0 : d1 <= 0 || -d0 / d1 == INT64_MAX ? -1 : -d0 / d1 + 1;
+                break;
+            case Instruction::EQ:
+                exit = d0 != 0 ? 0 : d1 == 0 ? -1 : 1;
+                break;
+            default:
+                exit = d0 == 0 ? 0 : d1 == 0 || -d0 % d1 != 0 || -d0 / d1 < 0 ? -1 : -d0 / d1;
+                break;
+        }
+
+        return exit >= 0 && exit < INT64_MAX;
+    }
+
+    void ScalarEvolution::analyze(const NaturalLoop* loop, const DominatorTree& dt, const LoopInfo& li,
+                                  MemorySSA& mssa)
+    {
+        Loop& info = loops[loop];
+        info.counted = false;
+        info.trip_count = 0;
+
+        Block* preheader = loop->get_preheader();
+        if (!preheader)
+        {
+            return;
+        }
+
+        // Only store of every variable the loop writes, nullptr when
+        // it has several
+        std::unordered_map<const Reference*, const StoreInstr*> stores;
+        std::vector<const Reference*> pending;
+        for (Block* block : loop->get_blocks())
+        {
+            for (const Instruction* instruction : *block)
+            {
+                if (instruction->get_opcode() != Instruction::STORE)
+                {
+                    continue;
+                }
+
+                const auto* store = static_cast<const StoreInstr*>(instruction);
+                const auto* variable = static_cast<const Reference*>(store->address.get());
+                auto iter = stores.emplace(variable, store);
+                if (iter.second)
+                {
+                    pending.push_back(variable);
+                }
+                else
+                {
+                    iter.first->second = nullptr;
+                }
+            }
+        }
+
+        // Stores run once on every iteration
+        auto every_iteration = [&](const Block* block)
+        {
+            if (li.get_loop(block) != loop)
+            {
+                return false;
+            }
+
+            for (const Block* latch : loop->get_latches())
+            {
+                if (!dt.dominates(block, latch))
+                {
+                    return false;
+                }
+            }
+
+            return true;
+        };
+
+        pending.erase(std::remove_if(pending.begin(), pending.end(), [&](const Reference* variable)
+        {
+            const StoreInstr* store = stores.at(variable);
+            const Type* type = variable->get_type(nullptr);
+            return !store || !dynamic_cast<const AllocaInstr*>(variable) || escapes(variable)
+                   || !type || type->get_primitive() > Type::I64 || type->is_unsigned()
+                   || !every_iteration(store->get_block());
+        }), pending.end());
+
+        // Starting from the constant stored before the loop if there
+        // is one, from the value on entry otherwise
+        for (const Reference* variable : pending)
+        {
+            MemoryAccess* init = mssa.get_clobbering(mssa.get_out(preheader), variable);
+            const NumericExpr* c = init->kind == MemoryAccess::DEF
+                                   && init->instruction->get_opcode() == Instruction::STORE
+                                   ? as_numeric(static_cast<const StoreInstr*>(init->instruction)->value)
+                                   : nullptr;
+            bool constant = c && c->type != NumericExpr::FLOATING;
+            info.variables[variable] = {Variable::UNKNOWN, stores.at(variable),
+                                        constant ? AddRecurrence(c->value.integer) : AddRecurrence(0, variable),
+                                        AddRecurrence(), false};
+        }
+
+        // Variables increment by other induction variables, resolve
+        // them until none is left or none of the rest resolves
+        bool resolved = true;
+        while (resolved)
+        {
+            resolved = false;
+            for (auto iter = pending.begin(); iter != pending.end();)
+            {
+                Variable& variable = info.variables.at(*iter);
+                Evaluation evaluation{loop, dt, mssa, stores, info.variables, variable.store, {}};
+                Evaluation::Value step;
+                if (!evaluation.get(variable.store->value, step) || (step.self != 0 && step.self != 1))
+                {
+                    ++iter;
+                    continue;
+                }
+
+                if (step.self == 0 && (step.rest.degree() || step.rest.get_base()))
+                {
+                    ++iter;
+                    continue;
+                }
+
+                // {start,+,step} for increments
+                AddRecurrence value = step.rest;
+                const std::vector<int64_t>& start = variable.start.get_steps();
+                if (step.self == 1 && !value.accumulate(start.empty() ? 0 : start[0], variable.start.get_base()))
+                {
+                    ++iter;
+                    continue;
+                }
+
+                variable.kind = step.self == 1 ? Variable::RECURRENCE : Variable::INVARIANT;
+                variable.value = value;
+                iter = pending.erase(iter);
+                resolved = true;
+            }
+        }
+
+        // The exit test, the only branch out of the loop
+        const Block* exiting = nullptr;
+        for (const Block* block : loop->get_blocks())
+        {
+            for (const Block* s : block->successors())
+            {
+                if (!loop->contains(s))
+                {
+                    if (exiting && exiting != block)
+                    {
+                        return;
+                    }
+                    exiting = block;
+                }
+            }
+        }
+
+        const auto* branch = exiting ? dynamic_cast<const BranchInstr*>(exiting->get_terminator()) : nullptr;
+        if (!branch || !every_iteration(exiting) || loop->contains(branch->target) == loop->contains(branch->otherwise))
+        {
+            return;
+        }
+
+        bool continues = loop->contains(branch->target);
+        const IR* condition = branch->condition;
+        const auto* test = dynamic_cast<const Instruction*>(condition);
+        while (test && test->get_opcode() == Instruction::L_NOT)
+        {
+            condition = static_cast<const UnaryInstr*>(test)->v;
+            test = dynamic_cast<const Instruction*>(condition);
+            continues = !continues;
+        }
+
+        Evaluation evaluation{loop, dt, mssa, stores, info.variables, nullptr, {}};
+        Evaluation::Value a, b;
+        Instruction::opcode_t relation = Instruction::L_NOT;
+        if (test && test->get_opcode() >= Instruction::LT && test->get_opcode() <= Instruction::EQ)
+        {
+            const auto* compare = static_cast<const BinaryInstr*>(test);
+            relation = test->get_opcode();
+            if (!evaluation.get(compare->a, a) || !evaluation.get(compare->b, b) || !a.rest.subtract(b.rest))
+            {
+                return;
+            }
+        }
+        else if (!evaluation.get(condition, a))
+        {
+            return;
+        }
+
+        int64_t exit = 0;
+        if (!solve_exit(relation, continues, a.rest, exit))
+        {
+            return;
+        }
+
+        // The values the variables take until the loop is left must fit
+        // their type, the stores would wrap them and the exit test with
+        // them otherwise. Relative to the value on entry, wrapping is
+        // only ruled out by arithmetic on signed ints being undefined
+        // once it overflows.
+        auto in_range = [&](const Reference* reference, const Variable& variable)
+        {
+            const Type* type = reference->get_type(nullptr);
+            if (variable.value.get_base())
+            {
+                const auto* value = dynamic_cast<const Instruction*>(variable.store->value.get());
+                const Type* stored = value ? value->get_type(nullptr) : nullptr;
+                return type->get_size() >= Type::promote(type)->get_size()
+                       && stored && stored->get_size() <= type->get_size();
+            }
+
+            const std::vector<int64_t>& start = variable.start.get_steps();
+            if (!variable.start.get_base() && !fits(start.empty() ? 0 : start[0], type))
+            {
+                return false;
+            }
+
+            const std::vector<int64_t>& steps = variable.value.get_steps();
+            if (variable.kind == Variable::INVARIANT)
+            {
+                return fits(steps.empty() ? 0 : steps[0], type);
+            }
+            else if (variable.kind != Variable::RECURRENCE)
+            {
+                return true;
+            }
+
+            // Steps of a single sign go one way, the last value is the farthest
+            bool up = false, down = false;
+            for (size_t j = 1; j < steps.size(); j++)
+            {
+                up = up || steps[j] > 0;
+                down = down || steps[j] < 0;
+            }
+
+            int64_t last;
+            int64_t stores = variable.before_exit ? exit + 1 : exit;
+            return !(up && down) && variable.value.evaluate(stores, last) && fits(last, type);
+        };
+
+        for (auto& iter : info.variables)
+        {
+            iter.second.before_exit = dt.dominates(iter.second.store->get_block(), exiting);
+        }
+
+        for (const auto& iter : info.variables)
+        {
+            if (!in_range(iter.first, iter.second))
+            {
+                return;
+            }
+        }
+
+        info.counted = true;
+        info.trip_count = exit + 1;
+    }
+
+    const AddRecurrence* ScalarEvolution::get_recurrence(const NaturalLoop* loop, const Reference* variable) const
+    {
+        auto info = loops.find(loop);
+        if (info == loops.end())
+        {
+            return nullptr;
+        }
+
+        auto iter = info->second.variables.find(variable);
+        return iter == info->second.variables.end() || iter->second.kind != Variable::RECURRENCE
+               ? nullptr : &iter->second.value;
+    }
+
+    bool ScalarEvolution::get_trip_count(const NaturalLoop* loop, int64_t& count) const
+    {
+        auto info = loops.find(loop);
+        if (info == loops.end() || !info->second.counted)
+        {
+            return false;
+        }
+
+        count = info->second.trip_count;
+        return true;
+    }
+
+    bool ScalarEvolution::get_exit_value(const NaturalLoop* loop, const Reference* variable, AddRecurrence& value) const
+    {
+        auto info = loops.find(loop);
+        if (info == loops.end() || !info->second.counted)
+        {
+            return false;
+        }
+
+        auto iter = info->second.variables.find(variable);
+        if (iter == info->second.variables.end())
+        {
+            return false;
+        }
+
+        // The last iteration stops at the exit test
+        const Variable& v = iter->second;
+        int64_t stores = v.before_exit ? info->second.trip_count : info->second.trip_count - 1;
+        if (stores == 0)
+        {
+            value = v.start;
+            return true;
+        }
+
+        int64_t offset;
+        switch (v.kind)
+        {
+            case Variable::RECURRENCE:
+                if (!v.value.evaluate(stores, offset))
+                {
+                    return false;
+                }
+
+                value = AddRecurrence(offset, v.value.get_base());
+                return true;
+            case Variable::INVARIANT:
+                value = v.value;
+                return true;
+            default:
+                return false;
+        }
+    }
+}
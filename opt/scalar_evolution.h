@@ -0,0 +1,150 @@
+#ifndef CC_OPT_SCALAR_EVOLUTION_H
+#define CC_OPT_SCALAR_EVOLUTION_H
+
+#include <unordered_map>
+#include <vector>
+#include "analysis.h"
+
+namespace cc
+{
+    class MemorySSA;
+
+    class AddRecurrence
+    {
+        /**
+         * Value of a variable over the iterations of a loop written as
+         * a chain of recurrences {c0,+,c1,+,...,+,cn}: it starts at c0
+         * and every iteration adds the value the chain {c1,+,...,+,cn}
+         * has at that iteration. At iteration k it is the sum of
+         * cj * C(k, j). A recurrence may start from the value a variable
+         * has when the loop is entered (the base) plus c0.
+         */
+
+        const Reference* base;          //!< nullptr when the recurrence starts at c0
+        std::vector<int64_t> steps;     //!< c0 to cn, empty for 0
+
+        void trim();
+
+    public:
+        AddRecurrence() : base(nullptr) {}
+        explicit AddRecurrence(int64_t c, const Reference* base = nullptr);
+
+        const Reference* get_base() const { return base; }
+
+        /**
+         * c0 to cn, an empty list is a recurrence of 0
+         */
+        const std::vector<int64_t>& get_steps() const { return steps; }
+
+        /**
+         * 0 for invariants, 1 for affine recurrences
+         */
+        size_t degree() const { return steps.size() > 1 ? steps.size() - 1 : 0; }
+
+        /**
+         * The operations return false if a coefficient overflows
+         * or the bases do not cancel out
+         */
+        bool add(const AddRecurrence& other);
+        bool subtract(const AddRecurrence& other);
+        bool multiply(int64_t factor);
+
+        /**
+         * Recurrence starting one iteration later
+         */
+        bool shift();
+
+        /**
+         * {c0,+,c1,+,...} becomes {base + c,+,c0,+,c1,+,...}
+         */
+        bool accumulate(int64_t c, const Reference* from);
+
+        /**
+         * @param offset value at iteration k, added to the base if there is one
+         * @return false if it overflows
+         */
+        bool evaluate(int64_t k, int64_t& offset) const;
+    };
+
+    class ScalarEvolution : public FunctionAnalysis
+    {
+        /**
+         * Induction variables and trip counts of the loops of a function.
+         *
+         * A local whose reference does not escape is an induction
+         * variable of a loop when the loop stores to it exactly once,
+         * on every iteration and outside of the loops nested in it,
+         * the value of a load of the variable plus a recurrence of the
+         * loop. Loads of an induction variable are recurrences shifted
+         * by one iteration when they come after its store, the other
+         * operands of the increments are integer constants, loads of
+         * variables the loop does not write, sums, differences and
+         * products by constants. Variables the loop stores the same
+         * value to on every iteration are invariant. Recurrences are
+         * computed on int64, unsigned variables and arithmetic, which
+         * wrap around, are left out.
+         *
+         * The trip count is known for loops left from a single block,
+         * run on every iteration, on a comparison of affine recurrences
+         * (or of a recurrence with 0) which ends after a finite number
+         * of iterations, as long as the variables of the loop keep to
+         * the range of their type until then.
+         */
+
+        struct Variable
+        {
+            enum kind_t
+            {
+                UNKNOWN,
+                RECURRENCE,     //!< Induction variable
+                INVARIANT       //!< Every iteration stores the same value
+            };
+
+            kind_t kind;
+            const StoreInstr* store;
+            AddRecurrence start;        //!< Value on entry to the loop
+            AddRecurrence value;        //!< Value on the entry of each iteration, or the value stored
+            bool before_exit;           //!< The store runs before the exit test
+        };
+
+        struct Loop
+        {
+            std::unordered_map<const Reference*, Variable> variables;   //!< Stored once on every iteration
+            bool counted;
+            int64_t trip_count;
+        };
+
+        std::unordered_map<const NaturalLoop*, Loop> loops;
+
+        struct Evaluation;
+
+        void analyze(const NaturalLoop* loop, const DominatorTree& dt, const LoopInfo& li, MemorySSA& mssa);
+
+    public:
+        static constexpr const char* NAME = "scalar-evolution";
+        static constexpr unsigned DEPENDS = ALL;
+
+        ScalarEvolution(Function* f, AnalysisManager& am);
+
+        /**
+         * Value of an induction variable on the entry of each
+         * iteration, nullptr if the variable is not one
+         */
+        const AddRecurrence* get_recurrence(const NaturalLoop* loop, const Reference* variable) const;
+
+        /**
+         * Iterations a loop starts, the last one leaves it
+         * @return false if it is not known
+         */
+        bool get_trip_count(const NaturalLoop* loop, int64_t& count) const;
+
+        /**
+         * Value a variable the loop stores to once on every iteration
+         * has once the loop is left, an invariant recurrence
+         * @return false without a trip count or if the value is not known
+         */
+        bool get_exit_value(const NaturalLoop* loop, const Reference* variable, AddRecurrence& value) const;
+    };
+}
+
+#endif //CC_OPT_SCALAR_EVOLUTION_H
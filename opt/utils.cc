@@ -0,0 +1,285 @@
+#include "utils.h"
+
+#include <climits>
+
+namespace cc
+{
+    std::vector<Block*> function_blocks(const Function* f)
+    {
+        return {f->get_blocks().begin(), f->get_blocks().end()};
+    }
+
+    bool is_terminator(const Instruction* instruction)
+    {
+        return instruction->get_opcode() >= Instruction::JUMP;
+    }
+
+    bool verify_cfg(const Function* f, std::string& error)
+    {
+        std::unordered_map<const Block*, size_t> edges;
+        for (const Block* block : f->get_blocks())
+        {
+            const TerminatorInstr* terminator = block->get_terminator();
+            if (!terminator)
+            {
+                error = block->get_name() + " does not end with a terminator";
+                return false;
+            }
+
+            for (const Instruction* instr : *block)
+            {
+                if (instr != terminator && is_terminator(instr))
+                {
+                    error = block->get_name() + " has a terminator before its end";
+                    return false;
+                }
+            }
+
+            if (block->successors().size() != terminator->successor_count())
+            {
+                error = block->get_name() + " has stale successors";
+                return false;
+            }
+
+            for (size_t i = 0; i < terminator->successor_count(); i++)
+            {
+                if (block->successors()[i] != terminator->successor(i)
+                    || block->successors()[i]->get_function() != f)
+                {
+                    error = block->get_name() + " has stale successors";
+                    return false;
+                }
+                edges[terminator->successor(i)]++;
+            }
+        }
+
+        for (const Block* block : f->get_blocks())
+        {
+            if (block->predecessors().size() != edges[block])
+            {
+                error = block->get_name() + " has stale predecessors";
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    bool is_pure(const Instruction* instruction)
+    {
+        return instruction->get_opcode() <= Instruction::A_SR;
+    }
+
+    bool is_removable(const Instruction* instruction)
+    {
+        // Reading a volatile object is an access of its own
+        const auto* load = dynamic_cast<const LoadInstr*>(instruction);
+        if (load)
+        {
+            return !load->loaded->is_volatile();
+        }
+
+        return is_pure(instruction);
+    }
+
+    const IR* as_value(const Instruction* instruction)
+    {
+        const auto* alloca = dynamic_cast<const AllocaInstr*>(instruction);
+        if (alloca)
+        {
+            return static_cast<const Reference*>(alloca);
+        }
+
+        return instruction;
+    }
+
+    bool escapes(const Reference* variable)
+    {
+        for (const Use* use = variable->get_uses(); use; use = use->get_next())
+        {
+            const Instruction* user = use->get_user();
+            bool address = (user->get_opcode() == Instruction::LOAD
+                            && &static_cast<const LoadInstr*>(user)->address == use)
+                           || (user->get_opcode() == Instruction::STORE
+                               && &static_cast<const StoreInstr*>(user)->address == use);
+            if (!address)
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    const NumericExpr* as_numeric(const IR* value)
+    {
+        // Constant expressions reduced by the parser wrap their value
+        const auto* expr = dynamic_cast<const ConstantExpr*>(value);
+        if (expr)
+        {
+            return dynamic_cast<const NumericExpr*>(expr->constant);
+        }
+
+        return dynamic_cast<const NumericExpr*>(value);
+    }
+
+    static Constant* fold_binary(const BinaryInstr* instr, const NumericExpr* a, const NumericExpr* b)
+    {
+        bool integral = a->type != NumericExpr::FLOATING && b->type != NumericExpr::FLOATING;
+        int64_t x = a->value.integer;
+        int64_t y = b->value.integer;
+        int64_t r;
+
+        if (dynamic_cast<const AddInstr*>(instr))
+        {
+            return integral && __builtin_add_overflow(x, y, &r) ? nullptr : *a + b;
+        }
+        else if (dynamic_cast<const SubInstr*>(instr))
+        {
+            return integral && __builtin_sub_overflow(x, y, &r) ? nullptr : *a - b;
+        }
+        else if (dynamic_cast<const MulInstr*>(instr))
+        {
+            return integral && __builtin_mul_overflow(x, y, &r) ? nullptr : *a * b;
+        }
+        else if (dynamic_cast<const DivInstr*>(instr))
+        {
+            return integral && (y == 0 || (x == INT64_MIN && y == -1)) ? nullptr : *a / b;
+        }
+        else if (dynamic_cast<const LTInstr*>(instr)) return *a < b;
+        else if (dynamic_cast<const GTInstr*>(instr)) return *a > b;
+        else if (dynamic_cast<const LEInstr*>(instr)) return *a <= b;
+        else if (dynamic_cast<const GEInstr*>(instr)) return *a >= b;
+        else if (dynamic_cast<const EQInstr*>(instr)) return *a == b;
+        else if (dynamic_cast<const L_AndInstr*>(instr)) return *a && b;
+        else if (dynamic_cast<const L_OrInstr*>(instr)) return *a || b;
+
+        if (!integral)
+        {
+            return nullptr;
+        }
+
+        if (dynamic_cast<const B_AndInstr*>(instr)) return *a & b;
+        else if (dynamic_cast<const B_OrInstr*>(instr)) return *a | b;
+        else if (dynamic_cast<const B_XorInstr*>(instr)) return *a ^ b;
+
+        // The width of the operands is not known here, only
+        // fold shifts that agree with every integer width
+        if (y < 0 || y > 63)
+        {
+            return nullptr;
+        }
+
+        if (dynamic_cast<const L_SLInstr*>(instr))
+        {
+            return x < 0 || x > (INT64_MAX >> y) ? nullptr : *a << b;
+        }
+        else if (dynamic_cast<const L_SRInstr*>(instr))
+        {
+            return x < 0 ? nullptr : *a >> b;
+        }
+        else if (dynamic_cast<const A_SRInstr*>(instr))
+        {
+            return *a >> b;
+        }
+
+        return nullptr;
+    }
+
+    Constant* fold_constant(const Instruction* instr)
+    {
+        if (!is_pure(instr))
+        {
+            return nullptr;
+        }
+
+        if (dynamic_cast<const BinaryInstr*>(instr))
+        {
+            const auto* self = dynamic_cast<const BinaryInstr*>(instr);
+            const auto* a = as_numeric(self->a);
+            const auto* b = as_numeric(self->b);
+            return a && b ? fold_binary(self, a, b) : nullptr;
+        }
+
+        const auto* v = as_numeric(dynamic_cast<const UnaryInstr*>(instr)->v);
+        if (!v || v->type == NumericExpr::FLOATING)
+        {
+            return nullptr;
+        }
+
+        if (dynamic_cast<const L_NotInstr*>(instr)) return !*v;
+        else if (dynamic_cast<const B_NotInstr*>(instr)) return ~*v;
+
+        NumericExpr one(v, NumericExpr::INTEGER, 1);
+        if (dynamic_cast<const IncInstr*>(instr))
+        {
+            return v->value.integer == INT64_MAX ? nullptr : *v + &one;
+        }
+        else if (dynamic_cast<const DecInstr*>(instr))
+        {
+            return v->value.integer == INT64_MIN ? nullptr : *v - &one;
+        }
+
+        return nullptr;
+    }
+
+    void for_each_operand(Instruction* instruction, const std::function<void(Use&)>& cb)
+    {
+        if (dynamic_cast<BinaryInstr*>(instruction))
+        {
+            auto* self = dynamic_cast<BinaryInstr*>(instruction);
+            cb(self->a);
+            cb(self->b);
+        }
+        else if (dynamic_cast<UnaryInstr*>(instruction))
+        {
+            cb(dynamic_cast<UnaryInstr*>(instruction)->v);
+        }
+        else if (dynamic_cast<BranchInstr*>(instruction))
+        {
+            cb(dynamic_cast<BranchInstr*>(instruction)->condition);
+        }
+        else if (dynamic_cast<LoadInstr*>(instruction))
+        {
+            auto* self = dynamic_cast<LoadInstr*>(instruction);
+            cb(self->address);
+            assert(dynamic_cast<const Reference*>(self->address.get()) && "Load addresses must stay references");
+        }
+        else if (dynamic_cast<StoreInstr*>(instruction))
+        {
+            auto* self = dynamic_cast<StoreInstr*>(instruction);
+            cb(self->address);
+            assert(dynamic_cast<const Reference*>(self->address.get()) && "Store addresses must stay references");
+            cb(self->value);
+        }
+        else if (dynamic_cast<ReturnInstr*>(instruction))
+        {
+            auto* self = dynamic_cast<ReturnInstr*>(instruction);
+            if (self->return_value)
+            {
+                cb(self->return_value);
+            }
+        }
+        else if (dynamic_cast<CallInstr*>(instruction))
+        {
+            for (Use& arg : dynamic_cast<CallInstr*>(instruction)->arguments)
+            {
+                cb(arg);
+            }
+        }
+    }
+
+    std::unordered_map<const IR*, size_t> count_uses(const std::vector<Block*>& blocks)
+    {
+        std::unordered_map<const IR*, size_t> uses;
+        for (Block* block : blocks)
+        {
+            for (Instruction* instr : *block)
+            {
+                for_each_operand(instr, [&uses](Use& operand) { uses[operand]++; });
+            }
+        }
+
+        return uses;
+    }
+}
@@ -0,0 +1,81 @@
+#ifndef CC_OPT_UTILS_H
+#define CC_OPT_UTILS_H
+
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <compilation/instruction.h>
+#include <compilation/module.h>
+
+namespace cc
+{
+    /**
+     * Every block of a function in layout order (see Function::get_blocks()),
+     * the entry block comes first
+     */
+    std::vector<Block*> function_blocks(const Function* f);
+
+    /**
+     * Jumps, branches and returns, they end every block of a function
+     */
+    bool is_terminator(const Instruction* instruction);
+
+    /**
+     * Check the control flow graph of a function: every block ends with
+     * exactly one terminator and the edge lists match the terminators
+     * @param error description of the first problem found
+     * @return false if the graph is broken
+     */
+    bool verify_cfg(const Function* f, std::string& error);
+
+    /**
+     * Instructions computing a value out of their operands only,
+     * without reading memory
+     */
+    bool is_pure(const Instruction* instruction);
+
+    /**
+     * Instructions without an effect besides their value: the pure
+     * ones and the loads of objects that are not volatile
+     */
+    bool is_removable(const Instruction* instruction);
+
+    /**
+     * The value an instruction defines as seen by its users,
+     * allocations are used through their Reference
+     */
+    const IR* as_value(const Instruction* instruction);
+
+    /**
+     * The reference to a variable is used otherwise than as the
+     * address of a load or a store, calls may reach the variable
+     */
+    bool escapes(const Reference* variable);
+
+    /**
+     * Numeric constant operand, nullptr if the value is not one
+     */
+    const NumericExpr* as_numeric(const IR* value);
+
+    /**
+     * Value of a pure instruction whose operands are numeric constants,
+     * owned by the caller. nullptr if it cannot be folded: integer
+     * operations that would overflow or divide by zero are left for
+     * the runtime.
+     */
+    Constant* fold_constant(const Instruction* instruction);
+
+    /**
+     * Visit every operand of an instruction, the callback may
+     * replace the operand by assigning to it
+     */
+    void for_each_operand(Instruction* instruction, const std::function<void(Use&)>& cb);
+
+    /**
+     * Number of times the value of each instruction is used in the blocks
+     */
+    std::unordered_map<const IR*, size_t> count_uses(const std::vector<Block*>& blocks);
+}
+
+#endif //CC_OPT_UTILS_H
@@ -0,0 +1,168 @@
+#include "corpus.h"
+#include <common/json.h>
+
+#include <cctype>
+#include <fstream>
+#include <set>
+#include <sstream>
+
+namespace cc
+{
+    std::vector<Program> read_corpus(const std::string& manifest)
+    {
+        std::ifstream in(manifest, std::ios::binary);
+        if (!in)
+        {
+            throw Exception("Failed to open corpus " + manifest);
+        }
+
+        std::stringstream ss;
+        ss << in.rdbuf();
+        Json json = Json::parse(ss.str());
+        if (json.type() != Json::ARRAY)
+        {
+            throw Exception(manifest + ": expected an array of programs");
+        }
+
+        size_t slash = manifest.rfind('/');
+        std::string dir = slash == std::string::npos ? "" : manifest.substr(0, slash + 1);
+
+        std::vector<Program> out;
+        std::set<std::string> names;
+        for (size_t i = 0; i < json.size(); i++)
+        {
+            const Json& entry = json[i];
+            if (entry["name"].type() != Json::STRING || entry["source"].type() != Json::STRING)
+            {
+                throw Exception(variadic_string("%s: program %zu needs a name and a source",
+                                                manifest.c_str(), i));
+            }
+
+            Program program{entry["name"].as_string(), entry["source"].as_string(), 1};
+            if (!names.insert(program.name).second)
+            {
+                throw Exception(manifest + ": duplicate program " + program.name);
+            }
+
+            if (program.path[0] != '/')
+            {
+                program.path = dir + program.path;
+            }
+
+            if (entry.has("scale"))
+            {
+                if (entry["scale"].type() != Json::NUMBER || entry["scale"].as_int() < 1)
+                {
+                    throw Exception(manifest + ": invalid scale of " + program.name);
+                }
+                program.scale = static_cast<unsigned>(entry["scale"].as_int());
+            }
+
+            out.push_back(program);
+        }
+
+        return out;
+    }
+
+    static std::set<std::string> global_names(Context* ctx, const Parser& parser, const std::string& source)
+    {
+        std::set<std::string> out;
+        ASTGlobal* ast = parser.parse(ctx, source.c_str());
+        for (ASTGlobal* iter = ast; iter; iter = iter->next)
+        {
+            if (dynamic_cast<ASTFunction*>(iter))
+            {
+                out.insert(dynamic_cast<ASTFunction*>(iter)->name);
+            }
+            else if (dynamic_cast<ASTGlobalVariable*>(iter))
+            {
+                out.insert(dynamic_cast<ASTGlobalVariable*>(iter)->decl->name);
+            }
+            else if (dynamic_cast<StructDecl*>(iter))
+            {
+                // Anonymous structures are named after their position
+                const std::string& name = dynamic_cast<StructDecl*>(iter)->name;
+                if (name[0] != '.')
+                {
+                    out.insert(name);
+                }
+            }
+        }
+
+        ctx->reset();
+        delete ast;
+        return out;
+    }
+
+    /**
+     * Append identifiers with a suffix when they are one of the names,
+     * literals and comments are copied as they are
+     */
+    static void rename(std::string& out, const std::string& source,
+                       const std::set<std::string>& names, const std::string& suffix)
+    {
+        size_t i = 0;
+        while (i < source.size())
+        {
+            char c = source[i];
+            size_t start = i;
+            if (c == '"' || c == '\'')
+            {
+                for (i++; i < source.size() && source[i] != c && source[i] != '\n'; i++)
+                {
+                    i += source[i] == '\\';
+                }
+                i = std::min(i + 1, source.size());
+            }
+            else if (source.compare(i, 2, "//") == 0)
+            {
+                i = source.find('\n', i);
+                i = i == std::string::npos ? source.size() : i;
+            }
+            else if (source.compare(i, 2, "/*") == 0)
+            {
+                i = source.find("*/", i + 2);
+                i = i == std::string::npos ? source.size() : i + 2;
+            }
+            else if (isalpha(static_cast<unsigned char>(c)) || c == '_')
+            {
+                while (i < source.size() && (isalnum(static_cast<unsigned char>(source[i])) || source[i] == '_'))
+                {
+                    i++;
+                }
+
+                out.append(source, start, i - start);
+                if (names.count(source.substr(start, i - start)))
+                {
+                    out += suffix;
+                }
+                continue;
+            }
+            else
+            {
+                i++;
+            }
+
+            out.append(source, start, i - start);
+        }
+    }
+
+    std::string scale_source(Context* ctx, const Parser& parser,
+                             const std::string& source, unsigned scale)
+    {
+        if (scale <= 1)
+        {
+            return source;
+        }
+
+        std::set<std::string> names = global_names(ctx, parser, source);
+        std::string out = source;
+        for (unsigned k = 1; k < scale; k++)
+        {
+            out += "\n";
+            rename(out, source, names, "_" + std::to_string(k));
+        }
+
+        return out;
+    }
+}
@@ -0,0 +1,34 @@
+#ifndef CC_PERF_CORPUS_H
+#define CC_PERF_CORPUS_H
+
+#include <string>
+#include <vector>
+#include <compilation/compile.h>
+
+namespace cc
+{
+    struct Program
+    {
+        std::string name;
+        std::string path;       //!< Resolved against the directory of the manifest
+        unsigned scale;         //!< Copies of the source compiled as one input
+    };
+
+    /**
+     * Read a corpus manifest, a JSON array of
+     * {"name": ..., "source": ..., "scale": N} where the scale is optional
+     * @throws Exception on a malformed manifest
+     */
+    std::vector<Program> read_corpus(const std::string& manifest);
+
+    /**
+     * Concatenate copies of a translation unit. Every global declared by
+     * the source (functions, variables, structures) is renamed in the
+     * copies so that they do not clash, copy k uses NAME_k.
+     * @param ctx context used to parse the source, it is reset afterwards
+     */
+    std::string scale_source(Context* ctx, const Parser& parser,
+                             const std::string& source, unsigned scale);
+}
+
+#endif //CC_PERF_CORPUS_H
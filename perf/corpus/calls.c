@@ -0,0 +1,45 @@
+void print(char* fmt, i32 value);
+
+i32 square(i32 x)
+{
+    return x * x;
+}
+
+i32 cube(i32 x)
+{
+    return square(x) * x;
+}
+
+i32 sum3(i32 a, i32 b, i32 c)
+{
+    return a + b + c;
+}
+
+i32 poly(i32 x)
+{
+    return sum3(cube(x), square(x) * 3, x * 5) + 7;
+}
+
+i32 chain(i32 x)
+{
+    return poly(poly(poly(x)));
+}
+
+i32 fib(i32 n)
+{
+    if (n < 2)
+    {
+        return n;
+    }
+    return fib(n - 1) + fib(n - 2);
+}
+
+i32 main()
+{
+    print("%d", square(3));
+    print("%d", cube(4));
+    print("%d", chain(2));
+    print("%d", fib(10));
+    print("%d", sum3(poly(1), poly(2), poly(3)));
+    return 0;
+}
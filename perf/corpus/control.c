@@ -0,0 +1,89 @@
+i32 limit = 100;
+
+i32 collatz(i32 n)
+{
+    i32 steps = 0;
+    while (n > 1)
+    {
+        if ((n & 1) == 0)
+        {
+            n = n >> 1;
+        }
+        else
+        {
+            n = n * 3 + 1;
+        }
+        steps++;
+        if (steps > 1000)
+        {
+            break;
+        }
+    }
+    return steps;
+}
+
+i32 grid(i32 w, i32 h)
+{
+    i32 sum = 0;
+    for (i32 y = 0; y < h; y++)
+    {
+        for (i32 x = 0; x < w; x++)
+        {
+            if (x == y)
+            {
+                continue;
+            }
+            else if (x < y)
+            {
+                sum = sum + x * y;
+            }
+            else if (x > y + 4)
+            {
+                sum = sum - x;
+            }
+            else
+            {
+                for (i32 k = 0; k < 3; k++)
+                {
+                    sum = sum + k;
+                }
+            }
+        }
+    }
+    return sum;
+}
+
+i32 classify(i32 v)
+{
+    if (v < 0)
+    {
+        return 0;
+    }
+    else if (v < 10)
+    {
+        if (v < 5)
+        {
+            return 1;
+        }
+        return 2;
+    }
+    else if (v < 100)
+    {
+        while (v > 10)
+        {
+            v = v - 10;
+        }
+        return 3 + v;
+    }
+    return 4;
+}
+
+i32 main()
+{
+    i32 total = 0;
+    for (i32 i = 0; i < limit; i++)
+    {
+        total = total + collatz(i) + classify(i - 50);
+    }
+    return total + grid(16, 16);
+}
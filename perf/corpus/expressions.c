@@ -0,0 +1,44 @@
+i32 seed = 17;
+
+i32 mix(i32 a, i32 b, i32 c)
+{
+    i32 x = a * 3 + b * 5 - c / 7;
+    i32 y = (x << 2) ^ (a & 255) | (b >> 3);
+    i32 z = ~(x + y) & (c | 1);
+    x = x + y * z - (a - b) * (b - c) + (c - a) / 3;
+    y = (x ^ y) + (y ^ z) + (z ^ x);
+    z = x * x + y * y + z * z - x * y - y * z - z * x;
+    return x + y + z;
+}
+
+i64 widen(i64 a, i32 b)
+{
+    i64 w = a * 1000003 + b;
+    w = (w << 7) + (w >> 11) + w * 31 + 4 * 8 * 16 - 2048;
+    w = w ^ (w >> 13) ^ (w << 17);
+    return w + mix(b, b + 1, b + 2);
+}
+
+f64 scale(f64 v, f64 k)
+{
+    f64 r = v * k + 0.5 * v - k / 3.0;
+    r = r * r - 2.0 * r * k + k * k;
+    return r / (1.0 + k * k);
+}
+
+i32 fold()
+{
+    i32 a = 1 + 2 * 3 - 4 / 2 + (5 << 2) - (64 >> 3);
+    i32 b = (1 | 2 | 4 | 8) & ~3 ^ 12;
+    i32 c = a * b + a - b + 100 * 100 - 9999;
+    return a + b + c + seed;
+}
+
+i32 main()
+{
+    i32 total = 0;
+    total = total + mix(1, 2, 3) + mix(4, 5, 6) + mix(7, 8, 9);
+    total = total + widen(10, 11) + widen(12, 13);
+    total = total + fold() + fold() * 2;
+    return total;
+}
@@ -0,0 +1,268 @@
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <unistd.h>
+#include <common/json.h>
+#include "corpus.h"
+#include "measure.h"
+
+using namespace cc;
+
+static void usage(const char* program)
+{
+    std::cerr << "usage: " << program << " --cc PATH --corpus MANIFEST [OPTIONS] [-- CC_FLAGS...]\n"
+              << "Compile every program of a corpus and compare against a baseline\n"
+              << "  --cc PATH            compiler to measure\n"
+              << "  --corpus MANIFEST    JSON list of programs (see perf/corpus.json)\n"
+              << "  --baseline FILE      JSON results to compare against\n"
+              << "  --update-baseline    write the results to the baseline instead\n"
+              << "  --runs N             compilations per program, the median is kept (5)\n"
+              << "  --threshold PCT      slowdown reported as a regression (5)\n"
+              << "  --work-dir DIR       where scaled sources are written ($TMPDIR)\n"
+              << "Exits with 1 when a program regressed or its exit status changed\n";
+}
+
+static Json to_json(const Measurement& m)
+{
+    Json out = Json::make_object();
+    out["wall_ms"] = m.wall_ms;
+    out["instructions"] = m.instructions >= 0 ? Json(m.instructions) : Json();
+    out["peak_rss_kb"] = static_cast<int64_t>(m.peak_rss_kb);
+    out["status"] = m.status;
+    return out;
+}
+
+static std::string change(double current, double baseline)
+{
+    return baseline > 0 ? variadic_string("%+.1f%%", 100.0 * (current - baseline) / baseline) : "";
+}
+
+static bool write_baseline(const std::string& path, const std::string& flags, unsigned runs,
+                           const std::vector<std::pair<std::string, Measurement>>& results)
+{
+    // One program per line so that updates diff well
+    std::string out = "{\n  \"flags\": " + Json(flags).dump()
+                      + ",\n  \"runs\": " + std::to_string(runs) + ",\n  \"programs\": {";
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        out += (i ? ",\n    " : "\n    ") + Json(results[i].first).dump() + ": " + to_json(results[i].second).dump();
+    }
+    out += "\n  }\n}\n";
+
+    std::ofstream os(path, std::ios::binary);
+    return static_cast<bool>(os << out);
+}
+
+int main(int argc, const char* argv[])
+{
+    std::vector<std::string> args(argv + 1, argv + argc);
+    std::string compiler;
+    std::string manifest;
+    std::string baseline_path;
+    std::string work_dir = getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp";
+    std::vector<std::string> cc_flags;
+    bool update = false;
+    uint64_t runs = 5;
+    double threshold = 5;
+
+    for (size_t i = 0; i < args.size(); i++)
+    {
+        const std::string& arg = args[i];
+        bool has_value = i + 1 < args.size();
+
+        if (arg == "--cc" && has_value)
+        {
+            compiler = args[++i];
+        }
+        else if (arg == "--corpus" && has_value)
+        {
+            manifest = args[++i];
+        }
+        else if (arg == "--baseline" && has_value)
+        {
+            baseline_path = args[++i];
+        }
+        else if (arg == "--update-baseline")
+        {
+            update = true;
+        }
+        else if (arg == "--runs" && has_value)
+        {
+            if (!parse_size(args[++i], runs) || runs == 0)
+            {
+                std::cerr << "Invalid number of runs: " << args[i] << "\n";
+                return 2;
+            }
+        }
+        else if (arg == "--threshold" && has_value)
+        {
+            char* end;
+            threshold = strtod(args[++i].c_str(), &end);
+            if (*end || threshold < 0)
+            {
+                std::cerr << "Invalid threshold: " << args[i] << "\n";
+                return 2;
+            }
+        }
+        else if (arg == "--work-dir" && has_value)
+        {
+            work_dir = args[++i];
+        }
+        else if (arg == "--")
+        {
+            cc_flags.assign(args.begin() + static_cast<long>(i) + 1, args.end());
+            break;
+        }
+        else
+        {
+            std::cerr << "Unknown option: " << arg << "\n";
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    if (compiler.empty() || manifest.empty() || (update && baseline_path.empty()))
+    {
+        usage(argv[0]);
+        return 2;
+    }
+
+    std::string flags;
+    for (const std::string& flag : cc_flags)
+    {
+        flags += (flags.empty() ? "" : " ") + flag;
+    }
+
+    try
+    {
+        std::vector<Program> corpus = read_corpus(manifest);
+
+        Json baseline;
+        const Json& recorded = baseline;
+        if (!baseline_path.empty() && !update)
+        {
+            std::ifstream in(baseline_path, std::ios::binary);
+            if (in)
+            {
+                std::stringstream ss;
+                ss << in.rdbuf();
+                baseline = Json::parse(ss.str());
+                if (recorded["flags"].as_string() != flags)
+                {
+                    std::cerr << "warning: the baseline was recorded with flags '"
+                              << recorded["flags"].as_string() << "'\n";
+                }
+            }
+            else
+            {
+                std::cerr << "error: no baseline at " << baseline_path
+                          << ", record one with --update-baseline (the cc_perf_baseline target)\n";
+                return 2;
+            }
+        }
+
+        Context ctx;
+        Parser parser;
+        std::vector<std::pair<std::string, Measurement>> results;
+        bool regressed = false;
+
+        std::cout << variadic_string("%-24s %10s %8s %14s %8s %10s %8s\n", "program",
+                                     "wall ms", "", "instructions", "", "rss kB", "");
+        for (const Program& program : corpus)
+        {
+            std::ifstream in(program.path, std::ios::binary);
+            if (!in)
+            {
+                throw Exception("Failed to open " + program.path);
+            }
+            std::stringstream ss;
+            ss << in.rdbuf();
+
+            // Scaled sources are written out, the compiler reads them like any input
+            std::string input = program.path;
+            if (program.scale > 1)
+            {
+                input = work_dir + "/cc-perf-" + std::to_string(getpid()) + "-" + program.name + ".c";
+                std::ofstream out(input, std::ios::binary);
+                if (!(out << scale_source(&ctx, parser, ss.str(), program.scale)))
+                {
+                    throw Exception("Failed to write " + input);
+                }
+            }
+
+            std::vector<std::string> command{compiler, "--no-cache"};
+            command.insert(command.end(), cc_flags.begin(), cc_flags.end());
+            command.push_back(input);
+
+            std::vector<Measurement> measurements;
+            for (uint64_t run = 0; run < runs; run++)
+            {
+                measurements.push_back(measure(command));
+            }
+
+            if (program.scale > 1)
+            {
+                unlink(input.c_str());
+            }
+
+            Measurement m = summarize(measurements);
+            results.emplace_back(program.name, m);
+
+            const Json& base = recorded["programs"][program.name];
+            std::string verdict;
+            if (base.is_null())
+            {
+                verdict = baseline.is_null() ? "" : "new";
+            }
+            else
+            {
+                auto over = [threshold](double current, const Json& value)
+                {
+                    return value.type() == Json::NUMBER && current > value.as_number() * (1 + threshold / 100);
+                };
+
+                // Measures missing from the baseline were never recorded
+                if (base["status"].type() == Json::NUMBER && base["status"].as_int() != m.status)
+                {
+                    verdict = variadic_string("status %d -> %d", static_cast<int>(base["status"].as_int()), m.status);
+                }
+                else if (over(m.wall_ms, base["wall_ms"])
+                         || (m.instructions >= 0 && over(static_cast<double>(m.instructions), base["instructions"]))
+                         || over(static_cast<double>(m.peak_rss_kb), base["peak_rss_kb"]))
+                {
+                    verdict = "REGRESSED";
+                }
+                regressed = regressed || !verdict.empty();
+            }
+
+            std::cout << variadic_string("%-24s %10.2f %8s %14s %8s %10lu %8s %s\n", program.name.c_str(),
+                                         m.wall_ms, change(m.wall_ms, base["wall_ms"].as_number()).c_str(),
+                                         m.instructions >= 0 ? std::to_string(m.instructions).c_str() : "-",
+                                         m.instructions >= 0 ? change(static_cast<double>(m.instructions),
+                                                                      base["instructions"].as_number()).c_str() : "",
+                                         m.peak_rss_kb,
+                                         change(static_cast<double>(m.peak_rss_kb),
+                                                base["peak_rss_kb"].as_number()).c_str(),
+                                         verdict.c_str());
+        }
+
+        if (update)
+        {
+            if (!write_baseline(baseline_path, flags, static_cast<unsigned>(runs), results))
+            {
+                std::cerr << "Failed to write " << baseline_path << "\n";
+                return 2;
+            }
+            std::cout << "baseline written to " << baseline_path << "\n";
+        }
+
+        return regressed ? 1 : 0;
+    }
+    catch (Exception& e)
+    {
+        std::cerr << "error: " << e.what() << "\n";
+        return 2;
+    }
+}
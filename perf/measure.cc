@@ -0,0 +1,155 @@
+#include "measure.h"
+#include <common/common.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif
+
+namespace cc
+{
+    /**
+     * Count the user space instructions of a process once it calls exec
+     * @return file descriptor of the counter, -1 if perf counters are unavailable
+     */
+    static int open_instruction_counter(pid_t pid)
+    {
+#ifdef __linux__
+        perf_event_attr attr{};
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+        attr.disabled = 1;
+        attr.enable_on_exec = 1;
+        attr.inherit = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+
+        return (int) syscall(__NR_perf_event_open, &attr, pid, -1, -1, 0);
+#else
+        (void) pid;
+        return -1;
+#endif
+    }
+
+    Measurement measure(const std::vector<std::string>& argv)
+    {
+        std::vector<char*> args;
+        for (const std::string& arg : argv)
+        {
+            args.push_back(const_cast<char*>(arg.c_str()));
+        }
+        args.push_back(nullptr);
+
+        // The child waits for the counter to be attached before exec
+        int sync[2];
+        if (pipe(sync) != 0)
+        {
+            throw Exception(std::string("pipe: ") + strerror(errno));
+        }
+
+        pid_t pid = fork();
+        if (pid < 0)
+        {
+            close(sync[0]);
+            close(sync[1]);
+            throw Exception(std::string("fork: ") + strerror(errno));
+        }
+
+        if (pid == 0)
+        {
+            close(sync[1]);
+            char c;
+            while (read(sync[0], &c, 1) < 0 && errno == EINTR);
+            close(sync[0]);
+
+            int null = open("/dev/null", O_RDWR);
+            dup2(null, STDIN_FILENO);
+            dup2(null, STDOUT_FILENO);
+            dup2(null, STDERR_FILENO);
+            execv(args[0], args.data());
+            _exit(127);
+        }
+
+        close(sync[0]);
+        int counter = open_instruction_counter(pid);
+
+        auto start = std::chrono::steady_clock::now();
+        close(sync[1]);
+
+        int status = 0;
+        rusage usage{};
+        while (wait4(pid, &status, 0, &usage) < 0 && errno == EINTR);
+        auto end = std::chrono::steady_clock::now();
+
+        Measurement out{};
+        out.wall_ms = std::chrono::duration<double, std::milli>(end - start).count();
+        out.peak_rss_kb = static_cast<uint64_t>(usage.ru_maxrss);
+        out.status = WIFSIGNALED(status) ? 128 + WTERMSIG(status) : WEXITSTATUS(status);
+        out.instructions = -1;
+
+        if (counter >= 0)
+        {
+            uint64_t count;
+            if (read(counter, &count, sizeof(count)) == sizeof(count))
+            {
+                out.instructions = static_cast<int64_t>(count);
+            }
+            close(counter);
+        }
+
+        if (out.status == 127)
+        {
+            throw Exception("Failed to run " + argv[0]);
+        }
+
+        return out;
+    }
+
+    template<typename T>
+    static T median(std::vector<T> values)
+    {
+        std::sort(values.begin(), values.end());
+        size_t n = values.size();
+        return n % 2 ? values[n / 2] : (values[n / 2 - 1] + values[n / 2]) / 2;
+    }
+
+    Measurement summarize(const std::vector<Measurement>& runs)
+    {
+        std::vector<double> wall;
+        std::vector<int64_t> instructions;
+        Measurement out{0, -1, 0, runs.empty() ? 0 : runs.back().status};
+
+        for (const Measurement& run : runs)
+        {
+            wall.push_back(run.wall_ms);
+            if (run.instructions >= 0)
+            {
+                instructions.push_back(run.instructions);
+            }
+            out.peak_rss_kb = std::max(out.peak_rss_kb, run.peak_rss_kb);
+        }
+
+        if (!wall.empty())
+        {
+            out.wall_ms = median(wall);
+        }
+
+        // Counters may fail on single runs (multiplexing), only report complete series
+        if (!instructions.empty() && instructions.size() == runs.size())
+        {
+            out.instructions = median(instructions);
+        }
+
+        return out;
+    }
+}
@@ -0,0 +1,32 @@
+#ifndef CC_PERF_MEASURE_H
+#define CC_PERF_MEASURE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace cc
+{
+    struct Measurement
+    {
+        double wall_ms;
+        int64_t instructions;       //!< User space instructions retired, -1 without perf counters
+        uint64_t peak_rss_kb;
+        int status;                 //!< Exit code, 128 + signal when killed
+    };
+
+    /**
+     * Run a command to completion with its output discarded
+     * @param argv program path followed by its arguments
+     * @throws Exception when the process cannot be started
+     */
+    Measurement measure(const std::vector<std::string>& argv);
+
+    /**
+     * Median wall time and instructions, highest peak RSS
+     * and the status of the last run
+     */
+    Measurement summarize(const std::vector<Measurement>& runs);
+}
+
+#endif //CC_PERF_MEASURE_H
@@ -0,0 +1,98 @@
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <iostream>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <common/common.h>
+#include "protocol.h"
+
+/*
+ * Thin drop-in replacement for `cc` that forwards the
+ * invocation to a running compile server. If no server
+ * is listening, the `cc` binary next to this executable
+ * is run directly instead.
+ */
+
+static int connect_server(const std::string& path)
+{
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path))
+    {
+        return -1;
+    }
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+    {
+        return -1;
+    }
+
+    if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0)
+    {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+static int run_local(const char* argv[])
+{
+    char self[PATH_MAX];
+    ssize_t n = readlink("/proc/self/exe", self, sizeof(self) - 1);
+    if (n < 0)
+    {
+        std::cerr << "No compile server running and failed to locate cc\n";
+        return 1;
+    }
+    self[n] = 0;
+
+    std::string compiler(self);
+    compiler = compiler.substr(0, compiler.rfind('/') + 1) + "cc";
+
+    execv(compiler.c_str(), const_cast<char* const*>(argv));
+    std::cerr << "Failed to run " << compiler << ": " << strerror(errno) << "\n";
+    return 1;
+}
+
+int main(int argc, const char* argv[])
+{
+    int fd = connect_server(cc::default_socket_path());
+    if (fd < 0)
+    {
+        return run_local(argv);
+    }
+
+    char cwd[PATH_MAX];
+    if (!getcwd(cwd, sizeof(cwd)))
+    {
+        std::cerr << "Failed to get working directory: " << strerror(errno) << "\n";
+        return 1;
+    }
+
+    cc::Request request;
+    request.cwd = cwd;
+    request.argv.assign(argv, argv + argc);
+
+    try
+    {
+        cc::write_request(fd, request);
+        cc::Response response = cc::read_response(fd);
+        close(fd);
+
+        std::cout << response.out << std::flush;
+        std::cerr << response.err << std::flush;
+        return (int) response.exit_code;
+    }
+    catch (cc::Exception& e)
+    {
+        close(fd);
+        std::cerr << "Compile server error: " << e.what() << "\n";
+        return 1;
+    }
+}
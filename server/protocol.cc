@@ -0,0 +1,143 @@
+#include "protocol.h"
+#include <common/common.h>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+
+namespace cc
+{
+    // Upper bound of a single field, protects the server from garbage
+    constexpr uint32_t MAX_FIELD_SIZE = 1u << 30;
+
+    std::string default_socket_path()
+    {
+        const char* env = getenv("CC_SERVER_SOCKET");
+        if (env && *env)
+        {
+            return env;
+        }
+
+        return variadic_string("/tmp/cc-server.%d.sock", (int) getuid());
+    }
+
+    static void write_all(int fd, const void* buf, size_t n)
+    {
+        const char* iter = static_cast<const char*>(buf);
+        while (n)
+        {
+            ssize_t w = write(fd, iter, n);
+            if (w < 0)
+            {
+                if (errno == EINTR) continue;
+                throw Exception("Failed to write to socket: " + std::string(strerror(errno)));
+            }
+
+            iter += w;
+            n -= w;
+        }
+    }
+
+    static void read_all(int fd, void* buf, size_t n)
+    {
+        char* iter = static_cast<char*>(buf);
+        while (n)
+        {
+            ssize_t r = read(fd, iter, n);
+            if (r < 0)
+            {
+                if (errno == EINTR) continue;
+                throw Exception("Failed to read from socket: " + std::string(strerror(errno)));
+            }
+            else if (r == 0)
+            {
+                throw Exception("Connection closed unexpectedly");
+            }
+
+            iter += r;
+            n -= r;
+        }
+    }
+
+    void write_u32(int fd, uint32_t value)
+    {
+        uint8_t buf[4] = {
+                static_cast<uint8_t>(value),
+                static_cast<uint8_t>(value >> 8),
+                static_cast<uint8_t>(value >> 16),
+                static_cast<uint8_t>(value >> 24)
+        };
+        write_all(fd, buf, sizeof(buf));
+    }
+
+    uint32_t read_u32(int fd)
+    {
+        uint8_t buf[4];
+        read_all(fd, buf, sizeof(buf));
+        return buf[0] | (buf[1] << 8) | (buf[2] << 16) | ((uint32_t) buf[3] << 24);
+    }
+
+    void write_string(int fd, const std::string& value)
+    {
+        write_u32(fd, value.size());
+        write_all(fd, value.data(), value.size());
+    }
+
+    std::string read_string(int fd)
+    {
+        uint32_t n = read_u32(fd);
+        if (n > MAX_FIELD_SIZE)
+        {
+            throw Exception("Message field is too large");
+        }
+
+        std::string out(n, '\0');
+        read_all(fd, &out[0], n);
+        return out;
+    }
+
+    void write_request(int fd, const Request& request)
+    {
+        write_string(fd, request.cwd);
+        write_u32(fd, request.argv.size());
+        for (const auto& arg : request.argv)
+        {
+            write_string(fd, arg);
+        }
+    }
+
+    Request read_request(int fd)
+    {
+        Request out;
+        out.cwd = read_string(fd);
+
+        uint32_t argc = read_u32(fd);
+        if (argc > 4096)
+        {
+            throw Exception("Too many arguments in request");
+        }
+
+        for (uint32_t i = 0; i < argc; i++)
+        {
+            out.argv.push_back(read_string(fd));
+        }
+
+        return out;
+    }
+
+    void write_response(int fd, const Response& response)
+    {
+        write_u32(fd, response.exit_code);
+        write_string(fd, response.out);
+        write_string(fd, response.err);
+    }
+
+    Response read_response(int fd)
+    {
+        Response out;
+        out.exit_code = read_u32(fd);
+        out.out = read_string(fd);
+        out.err = read_string(fd);
+        return out;
+    }
+}
@@ -0,0 +1,45 @@
+#ifndef CC_PROTOCOL_H
+#define CC_PROTOCOL_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace cc
+{
+    /**
+     * Wire format used between the compile server and its clients.
+     * Every field is framed as a little endian u32 length
+     * followed by the raw bytes.
+     *
+     * Request:  cwd, argc, argv[0..argc)
+     * Response: exit code, stdout, stderr
+     */
+
+    struct Request
+    {
+        std::string cwd;
+        std::vector<std::string> argv;
+    };
+
+    struct Response
+    {
+        uint32_t exit_code;
+        std::string out;
+        std::string err;
+    };
+
+    std::string default_socket_path();
+
+    void write_u32(int fd, uint32_t value);
+    uint32_t read_u32(int fd);
+    void write_string(int fd, const std::string& value);
+    std::string read_string(int fd);
+
+    void write_request(int fd, const Request& request);
+    Request read_request(int fd);
+    void write_response(int fd, const Response& response);
+    Response read_response(int fd);
+}
+
+#endif //CC_PROTOCOL_H
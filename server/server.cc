@@ -0,0 +1,138 @@
+#include "server.h"
+#include "protocol.h"
+
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <sstream>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+
+namespace cc
+{
+    Server::Server(std::string socket_path) :
+            socket_path(std::move(socket_path)), listen_fd(-1)
+    {
+    }
+
+    std::unique_ptr<Driver> Server::acquire()
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (idle.empty())
+        {
+            return std::make_unique<Driver>();
+        }
+
+        std::unique_ptr<Driver> driver = std::move(idle.back());
+        idle.pop_back();
+        return driver;
+    }
+
+    void Server::release(std::unique_ptr<Driver> driver)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        idle.push_back(std::move(driver));
+    }
+
+    void Server::handle(int client_fd)
+    {
+        Request request = read_request(client_fd);
+
+        Response response;
+        std::stringstream out;
+        std::stringstream err;
+
+        if (request.argv.empty())
+        {
+            throw Exception("Empty request");
+        }
+
+        // Paths are resolved against the directory of the client, the
+        // directory of the server is shared by every request
+        std::unique_ptr<Driver> driver = acquire();
+        try
+        {
+            std::vector<std::string> args(request.argv.begin() + 1, request.argv.end());
+            response.exit_code = driver->run(request.argv[0], args, out, err, request.cwd);
+            release(std::move(driver));
+        }
+        catch (std::exception& e)
+        {
+            // The state of the driver is unknown, it is not reused
+            err << "error: " << e.what() << "\n";
+            response.exit_code = 2;
+        }
+
+        response.out = out.str();
+        response.err = err.str();
+        write_response(client_fd, response);
+    }
+
+    int Server::serve()
+    {
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        if (socket_path.size() >= sizeof(addr.sun_path))
+        {
+            std::cerr << "Socket path is too long: " << socket_path << "\n";
+            return 1;
+        }
+        strncpy(addr.sun_path, socket_path.c_str(), sizeof(addr.sun_path) - 1);
+
+        listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listen_fd < 0)
+        {
+            std::cerr << "Failed to create socket: " << strerror(errno) << "\n";
+            return 1;
+        }
+
+        // Remove the socket from a previous server that did not clean up
+        unlink(socket_path.c_str());
+        if (bind(listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0
+            || listen(listen_fd, SOMAXCONN) < 0)
+        {
+            std::cerr << "Failed to listen on " << socket_path
+                      << ": " << strerror(errno) << "\n";
+            return 1;
+        }
+
+        // A client that goes away should not kill the server
+        signal(SIGPIPE, SIG_IGN);
+
+        while (true)
+        {
+            int client_fd = accept(listen_fd, nullptr, nullptr);
+            if (client_fd < 0)
+            {
+                if (errno == EINTR) continue;
+                std::cerr << "Failed to accept connection: " << strerror(errno) << "\n";
+                return 1;
+            }
+
+            std::thread([this, client_fd]()
+            {
+                try
+                {
+                    handle(client_fd);
+                }
+                catch (std::exception& e)
+                {
+                    std::cerr << "Dropped request: " << e.what() << "\n";
+                }
+
+                close(client_fd);
+            }).detach();
+        }
+    }
+
+    Server::~Server()
+    {
+        if (listen_fd >= 0)
+        {
+            close(listen_fd);
+            unlink(socket_path.c_str());
+        }
+    }
+}
@@ -0,0 +1,48 @@
+#ifndef CC_SERVER_H
+#define CC_SERVER_H
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <compilation/driver.h>
+
+namespace cc
+{
+    class Server
+    {
+        /**
+         * Persistent compile server.
+         * Accepts compile requests over a unix domain socket and serves
+         * every connection on its own thread, so that parallel builds
+         * compile in parallel. Each request borrows a warm Driver that
+         * no other request uses at the same time. Requests carry the
+         * working directory and arguments of the client so that the
+         * server behaves exactly like a `cc` invocation.
+         */
+
+        std::string socket_path;
+        int listen_fd;
+
+        std::mutex lock;
+        std::vector<std::unique_ptr<Driver>> idle;      //!< Drivers not serving a request
+
+        std::unique_ptr<Driver> acquire();
+        void release(std::unique_ptr<Driver> driver);
+
+        void handle(int client_fd);
+
+    public:
+        explicit Server(std::string socket_path);
+
+        /**
+         * Listen and serve requests forever
+         * @return exit code on failure to set up the socket
+         */
+        int serve();
+
+        ~Server();
+    };
+}
+
+#endif //CC_SERVER_H
@@ -0,0 +1,76 @@
+#include <libcc/libcc.h>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <thread>
+
+/*
+ * Compiles the same translation unit in two sessions at once, every
+ * compilation must print what a lone session prints: values are
+ * numbered by their own function and no counter is shared.
+ */
+
+static const char* SOURCE =
+        "int square(int x)\n"
+        "{\n"
+        "    return x * x;\n"
+        "}\n"
+        "\n"
+        "int sum(int n)\n"
+        "{\n"
+        "    int total = 0;\n"
+        "    int i = 0;\n"
+        "    while (i < n)\n"
+        "    {\n"
+        "        total = total + square(i) + 42;\n"
+        "        i = i + 1;\n"
+        "    }\n"
+        "    return total;\n"
+        "}\n"
+        "\n"
+        "int main()\n"
+        "{\n"
+        "    return sum(10) - 7;\n"
+        "}\n";
+
+static constexpr int COMPILATIONS = 200;
+
+static bool compile_all(const std::string& expected, int* failures)
+{
+    cc::Session session;
+    for (int i = 0; i < COMPILATIONS; i++)
+    {
+        cc::Result result = session.compile(SOURCE, "sessions.c");
+        if (!result.success || result.output != expected)
+        {
+            (*failures)++;
+        }
+    }
+
+    return *failures == 0;
+}
+
+int main()
+{
+    cc::Session reference;
+    cc::Result expected = reference.compile(SOURCE, "sessions.c");
+    if (!expected.success)
+    {
+        fprintf(stderr, "Reference compilation failed\n");
+        return 1;
+    }
+
+    int failures[2] = {0, 0};
+    std::thread other(compile_all, std::cref(expected.output), &failures[1]);
+    compile_all(expected.output, &failures[0]);
+    other.join();
+
+    if (failures[0] || failures[1])
+    {
+        fprintf(stderr, "%d and %d of %d compilations differ from a lone session\n",
+                failures[0], failures[1], COMPILATIONS);
+        return 1;
+    }
+
+    return 0;
+}
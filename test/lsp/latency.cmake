@@ -0,0 +1,58 @@
+# Open a 50k-line document in cc-lsp, edit it in places spread over the
+# whole file and check the 99th percentile of the didChange latencies.
+#
+#   cmake -DLSP=cc-lsp -DSESSION=latency.jsonl -DLIMIT=20 -P latency.cmake
+
+set(functions 5000)     # 10 lines each
+set(edits 200)
+
+set(text "")
+foreach (i RANGE 1 ${functions})
+    string(APPEND text "i32 f${i}(i32 x)\\n{\\n    i32 y = x + ${i};\\n    while (y > 0)\\n    {\\n"
+                       "        y = y - 1;\\n    }\\n    return y;\\n}\\n\\n")
+endforeach()
+
+set(uri "file:///latency.c")
+set(session "{\"jsonrpc\": \"2.0\", \"id\": 1, \"method\": \"initialize\", \"params\": {}}\n")
+string(APPEND session "{\"jsonrpc\": \"2.0\", \"method\": \"textDocument/didOpen\", \"params\": "
+                      "{\"textDocument\": {\"uri\": \"${uri}\", \"text\": \"${text}\"}}}\n")
+
+# Type a character in the declaration of `y` of some function, then remove it
+foreach (i RANGE 1 ${edits})
+    math(EXPR line "(((${i} + 1) / 2) * 7919 % ${functions}) * 10 + 2")
+    math(EXPR insert "${i} % 2")
+    math(EXPR end "5 - ${insert}")
+    if (insert)
+        set(new_text "x")
+    else()
+        set(new_text "")
+    endif()
+
+    string(APPEND session "{\"jsonrpc\": \"2.0\", \"method\": \"textDocument/didChange\", \"params\": "
+                          "{\"textDocument\": {\"uri\": \"${uri}\"}, \"contentChanges\": [{\"range\": "
+                          "{\"start\": {\"line\": ${line}, \"character\": 4}, "
+                          "\"end\": {\"line\": ${line}, \"character\": ${end}}}, \"text\": \"${new_text}\"}]}}\n")
+endforeach()
+
+string(APPEND session "{\"jsonrpc\": \"2.0\", \"id\": 2, \"method\": \"shutdown\"}\n")
+string(APPEND session "{\"jsonrpc\": \"2.0\", \"method\": \"exit\"}\n")
+file(WRITE ${SESSION} "${session}")
+
+execute_process(COMMAND ${LSP} --replay ${SESSION}
+        OUTPUT_QUIET
+        ERROR_VARIABLE report
+        RESULT_VARIABLE result)
+
+if (NOT result EQUAL 0)
+    message(FATAL_ERROR "${LSP} --replay ${SESSION} exited with ${result}\n${report}")
+endif()
+
+if (NOT report MATCHES "p99: ([0-9.]+)ms")
+    message(FATAL_ERROR "No latencies reported by ${LSP}\n${report}")
+endif()
+
+string(STRIP "${report}" report)
+message(STATUS "${report}")
+if (CMAKE_MATCH_1 GREATER LIMIT)
+    message(FATAL_ERROR "p99 latency of didChange is ${CMAKE_MATCH_1}ms, above ${LIMIT}ms")
+endif()
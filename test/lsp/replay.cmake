@@ -0,0 +1,25 @@
+# Replay a recorded session through cc-lsp and check that every line
+# of the expected file shows up in the messages it sends, in order.
+#
+#   cmake -DLSP=cc-lsp -DSESSION=session.jsonl -DEXPECTED=session.expected -P replay.cmake
+
+execute_process(COMMAND ${LSP} --replay ${SESSION}
+        OUTPUT_VARIABLE output
+        RESULT_VARIABLE result)
+
+if (NOT result EQUAL 0)
+    message(FATAL_ERROR "${LSP} --replay ${SESSION} exited with ${result}\n${output}")
+endif()
+
+file(STRINGS ${EXPECTED} expected)
+set(rest "${output}")
+foreach (line IN LISTS expected)
+    string(FIND "${rest}" "${line}" position)
+    if (position EQUAL -1)
+        message(FATAL_ERROR "Expected in order in the output of ${SESSION}:\n${line}\n\nOutput:\n${output}")
+    endif()
+
+    string(LENGTH "${line}" length)
+    math(EXPR position "${position} + ${length}")
+    string(SUBSTRING "${rest}" ${position} -1 rest)
+endforeach()
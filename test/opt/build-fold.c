@@ -0,0 +1,12 @@
+// RUN: -fconstant-fold --emit-ir
+// Lowering folds constant operands, identities and repeated pure
+// instructions of a block as it builds the IR
+
+i32 fold(i32 a, i32 b)
+{
+    i32 x = a * b + a * b;
+    i32 y = (a + 0) * 1 + (b & 0) + 3 * 4;
+    i64 z = 5;
+    i64 w = z * 1;
+    return x + y;
+}
@@ -0,0 +1,42 @@
+# Run cc or cc-opt over a test input, compare what it writes with the
+# expected output and read that output back: printing the IR parsed from
+# printed IR must give the same text.
+#
+# The first line of the input holds the arguments after "RUN:".
+#
+#   cmake -DTOOL=cc-opt -DOPT=cc-opt -DINPUT=test.ir -DEXPECTED=test.expected
+#         -DOUTPUT=test.out -P check.cmake
+
+file(STRINGS ${INPUT} run LIMIT_COUNT 1)
+if (NOT run MATCHES "RUN:(.*)$")
+    message(FATAL_ERROR "${INPUT} does not start with a RUN: line")
+endif()
+separate_arguments(args UNIX_COMMAND "${CMAKE_MATCH_1}")
+
+execute_process(COMMAND ${TOOL} ${args} ${INPUT}
+        OUTPUT_FILE ${OUTPUT}
+        ERROR_VARIABLE error
+        RESULT_VARIABLE result)
+
+if (NOT result EQUAL 0)
+    message(FATAL_ERROR "${TOOL} ${args} ${INPUT} exited with ${result}\n${error}")
+endif()
+
+file(READ ${OUTPUT} output)
+file(READ ${EXPECTED} expected)
+if (NOT output STREQUAL expected)
+    message(FATAL_ERROR "Output of ${TOOL} ${args} ${INPUT} differs from ${EXPECTED}:\n${output}")
+endif()
+
+execute_process(COMMAND ${OPT} ${OUTPUT}
+        OUTPUT_VARIABLE reprinted
+        ERROR_VARIABLE error
+        RESULT_VARIABLE result)
+
+if (NOT result EQUAL 0)
+    message(FATAL_ERROR "${OPT} could not read back ${OUTPUT} (${result})\n${error}")
+endif()
+
+if (NOT reprinted STREQUAL output)
+    message(FATAL_ERROR "IR read back from ${OUTPUT} prints differently:\n${reprinted}")
+endif()